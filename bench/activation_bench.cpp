@@ -0,0 +1,56 @@
+// activation_bench - cost of PlugProcessor::setActive(true).
+//
+//   activation_bench [channels] [cycles]
+//
+// Activates once (which allocates), then toggles activation `cycles` times at
+// the same configuration, the way hosts do on transport restarts and bounces,
+// and finally changes the sample rate. Prints the processor's own
+// ActivationStats for each phase. Runs through bench::MockHost.
+
+#include "mockhost.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace Steinberg;
+using namespace Steinberg::MyModulation;
+
+int main(int argc, char* argv[])
+{
+    const int32 numChannels = argc > 1 ? std::atoi(argv[1]) : 2;
+    const int cycles = argc > 2 ? std::atoi(argv[2]) : 1000;
+    if (numChannels <= 0 || numChannels > 32 || cycles <= 0) {
+        fprintf(stderr, "usage: activation_bench [channels 1-32] [cycles]\n");
+        return 1;
+    }
+
+    // constructing the host sets up at 48 kHz and activates
+    bench::MockHost::Config config;
+    config.numChannels = numChannels;
+    config.maxBlockSize = 512;
+    config.inPlace = true;
+    bench::MockHost host(config);
+    PlugProcessor& processor = host.processor();
+    for (int32 ch = 0; ch < numChannels; ++ch)
+        std::fill(host.input32(ch), host.input32(ch) + 512, 0.25f);
+    const PlugProcessor::ActivationStats first = processor.activationStats();
+    printf("first activation:   %8.3f ms\n", first.lastMs);
+
+    double total = 0.0, worst = 0.0;
+    for (int i = 0; i < cycles; ++i) {
+        host.process(512);
+        host.setActive(false);
+        host.setActive(true);
+        const double ms = processor.activationStats().lastMs;
+        total += ms;
+        worst = ms > worst ? ms : worst;
+    }
+    printf("reactivation:       %8.3f ms mean, %8.3f ms max over %d cycles\n", total / cycles, worst, cycles);
+
+    host.setup(96000.0, Vst::kSample32);
+    printf("sample rate change: %8.3f ms\n", processor.activationStats().lastMs);
+
+    const PlugProcessor::ActivationStats& stats = processor.activationStats();
+    printf("%u activations, %u reallocated\n", stats.count, stats.reallocations);
+    return 0;
+}
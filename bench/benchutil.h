@@ -0,0 +1,124 @@
+#ifndef BENCHUTIL_H
+#define BENCHUTIL_H
+
+// Small helpers shared by the benchmarks: a cycle counter and, on Linux,
+// hardware counters through perf_event_open. Counters that the kernel or the
+// VM refuses read as -1 and the benches print "n/a".
+
+#include "../include/cyclecounter.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench
+{
+
+// TSC where there is one, nanoseconds otherwise
+inline uint64_t cycles() noexcept
+{
+    return readCycleCounter();
+}
+
+// keeps the optimizer from dropping a result
+template <typename T>
+inline void doNotOptimize(const T& value) noexcept
+{
+#if defined(__GNUC__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const T* sink;
+    sink = &value;
+#endif
+}
+
+enum Counter {CPU_CYCLES, INSTRUCTIONS, L1D_MISSES, LLC_MISSES, NUM_COUNTERS};
+
+class PerfCounters
+{
+    int m_fd[NUM_COUNTERS];
+public:
+    PerfCounters() noexcept;
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    void start() noexcept;
+    void stop() noexcept;
+    int64_t read(Counter) const noexcept;
+};
+
+#if defined(__linux__)
+
+inline PerfCounters::PerfCounters() noexcept
+{
+    static const uint32_t types[NUM_COUNTERS] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+                                                 PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE};
+    static const uint64_t configs[NUM_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES,
+        PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+        PERF_COUNT_HW_CACHE_MISSES
+    };
+    for (int i = 0; i < NUM_COUNTERS; ++i) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[i];
+        attr.config = configs[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        m_fd[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+}
+
+inline PerfCounters::~PerfCounters()
+{
+    for (int i = 0; i < NUM_COUNTERS; ++i)
+        if (m_fd[i] >= 0) close(m_fd[i]);
+}
+
+inline void PerfCounters::start() noexcept
+{
+    for (int i = 0; i < NUM_COUNTERS; ++i) {
+        if (m_fd[i] < 0) continue;
+        ioctl(m_fd[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(m_fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+inline void PerfCounters::stop() noexcept
+{
+    for (int i = 0; i < NUM_COUNTERS; ++i)
+        if (m_fd[i] >= 0) ioctl(m_fd[i], PERF_EVENT_IOC_DISABLE, 0);
+}
+
+inline int64_t PerfCounters::read(Counter c) const noexcept
+{
+    int64_t value = 0;
+    if (m_fd[c] < 0 || ::read(m_fd[c], &value, sizeof(value)) != sizeof(value))
+        return -1;
+    return value;
+}
+
+#else
+
+inline PerfCounters::PerfCounters() noexcept
+{
+    for (int i = 0; i < NUM_COUNTERS; ++i) m_fd[i] = -1;
+}
+inline PerfCounters::~PerfCounters() {}
+inline void PerfCounters::start() noexcept {}
+inline void PerfCounters::stop() noexcept {}
+inline int64_t PerfCounters::read(Counter) const noexcept { return -1; }
+
+#endif
+
+} // namespace bench
+
+#endif // BENCHUTIL_H
@@ -0,0 +1,86 @@
+// blocksize_bench - fixed versus per-sample cost of PlugProcessor::process.
+//
+//   blocksize_bench [channels] [samples per size]
+//
+// Processes the same amount of audio at block sizes 1..4096 and prints the
+// time per block and per sample. The per-sample cost is the slope between
+// the two largest sizes, the fixed per-call cost is what's left of a 1-sample
+// block; the last column is the share of each block spent on that fixed cost.
+// Runs through bench::MockHost, in place.
+
+#include "mockhost.h"
+#include "../include/cyclecounter.h"
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace Steinberg;
+using namespace Steinberg::MyModulation;
+
+namespace
+{
+
+constexpr double sample_rate = 48000.0;
+constexpr int32 max_block = 4096;
+
+// nanoseconds per block, PlugProcessor::process alone
+double measure(bench::MockHost& host, int32 blockSize, long long totalSamples)
+{
+    const long long numBlocks = totalSamples / blockSize;
+    const int32 blocksPerBuffer = max_block / blockSize;
+    uint64_t ticks = 0;
+    for (long long b = 0; b < numBlocks; ++b) {
+        host.process(blockSize, static_cast<int32>(b % blocksPerBuffer) * blockSize);
+        ticks += host.lastProcessTicks();
+    }
+    return static_cast<double>(ticks) / cycleCounterFrequency() * 1e9 / static_cast<double>(numBlocks);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const int32 numChannels = argc > 1 ? std::atoi(argv[1]) : 2;
+    const long long totalSamples = argc > 2 ? std::atoll(argv[2]) : (1 << 20);
+    if (numChannels <= 0 || numChannels > 32 || totalSamples < max_block) {
+        fprintf(stderr, "usage: blocksize_bench [channels 1-32] [samples per size >= %d]\n", max_block);
+        return 1;
+    }
+
+    bench::MockHost::Config config;
+    config.numChannels = numChannels;
+    config.maxBlockSize = max_block;
+    config.sampleRate = sample_rate;
+    config.inPlace = true;
+    bench::MockHost host(config);
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+    for (int32 ch = 0; ch < numChannels; ++ch)
+        for (int32 s = 0; s < max_block; ++s)
+            host.input32(ch)[s] = noise(rng);
+
+    std::vector<int32> sizes;
+    for (int32 n = 1; n <= max_block; n *= 2) {
+        sizes.push_back(n);
+        if (n == 16)
+            sizes.push_back(24);
+    }
+    std::vector<double> perBlock;
+    measure(host, 64, totalSamples / 4);      // warm up
+    for (int32 n : sizes)
+        perBlock.push_back(measure(host, n, totalSamples));
+
+    const size_t last = sizes.size() - 1;
+    const double perSample = (perBlock[last] - perBlock[last - 1]) / (sizes[last] - sizes[last - 1]);
+    const double fixed = perBlock[0] - perSample;
+
+    printf("%d channels, %lld samples per size\n", numChannels, totalSamples);
+    printf("%6s %12s %12s %10s\n", "block", "ns/block", "ns/sample", "fixed %");
+    for (size_t i = 0; i < sizes.size(); ++i)
+        printf("%6d %12.1f %12.2f %10.1f\n", sizes[i], perBlock[i], perBlock[i] / sizes[i],
+               100.0 * fixed / perBlock[i]);
+    printf("fixed cost %.1f ns per call, %.2f ns per sample (all channels)\n", fixed, perSample);
+    return 0;
+}
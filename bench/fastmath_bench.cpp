@@ -0,0 +1,143 @@
+// fastmath_bench - accuracy and speed of the audio_tools fast-math layer.
+//
+//   fastmath_bench [points]
+//
+// Sweeps every function over the range its bound in fastmath.h is stated for,
+// through the scalar and the block (SSE2) path, and reports the largest error
+// against libm in double precision next to the documented bound. Then times
+// both paths against the libm call they replace, in cycles per value.
+// Exits with 1 if any bound is exceeded, so it doubles as the accuracy check.
+
+#include "../include/fastmath.h"
+#include "benchutil.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+
+enum ErrorKind {ABSOLUTE, RELATIVE};
+
+struct Case
+{
+    const char* name;
+    float lo, hi;
+    ErrorKind kind;
+    double bound;
+    float (*scalar)(float);
+    void (*block)(const float*, float*, int);
+    double (*reference)(double);
+    float (*libm)(float);
+};
+
+float expScalar(float x) { return audio_tools::fastExp(x); }
+float pow10Scalar(float x) { return audio_tools::fastPow10(x); }
+float sinScalar(float x) { return audio_tools::fastSin(x); }
+float tanhScalar(float x) { return audio_tools::fastTanh(x); }
+float floorScalar(float x) { return audio_tools::fastFloor(x); }
+void expBlock(const float* in, float* out, int n) { audio_tools::fastExp(in, out, n); }
+void pow10Block(const float* in, float* out, int n) { audio_tools::fastPow10(in, out, n); }
+void sinBlock(const float* in, float* out, int n) { audio_tools::fastSin(in, out, n); }
+void tanhBlock(const float* in, float* out, int n) { audio_tools::fastTanh(in, out, n); }
+void floorBlock(const float* in, float* out, int n) { audio_tools::fastFloor(in, out, n); }
+double pow10Ref(double x) { return std::pow(10.0, x); }
+double expRef(double x) { return std::exp(x); }
+double sinRef(double x) { return std::sin(x); }
+double tanhRef(double x) { return std::tanh(x); }
+double floorRef(double x) { return std::floor(x); }
+float expLibm(float x) { return std::exp(x); }
+float pow10Libm(float x) { return std::pow(10.0f, x); }
+float sinLibm(float x) { return std::sin(x); }
+float tanhLibm(float x) { return std::tanh(x); }
+float floorLibm(float x) { return std::floor(x); }
+
+const Case cases[] = {
+    {"exp",   -87.0f,  87.0f,  RELATIVE, 2e-7, expScalar,   expBlock,   expRef,   expLibm},
+    {"pow10", -37.0f,  37.0f,  RELATIVE, 2e-7, pow10Scalar, pow10Block, pow10Ref, pow10Libm},
+    {"sin",   -1e4f,   1e4f,   ABSOLUTE, 2e-7, sinScalar,   sinBlock,   sinRef,   sinLibm},
+    {"tanh",  -20.0f,  20.0f,  ABSOLUTE, 2e-7, tanhScalar,  tanhBlock,  tanhRef,  tanhLibm},
+    {"floor", -1e6f,   1e6f,   ABSOLUTE, 0.0,  floorScalar, floorBlock, floorRef, floorLibm},
+};
+
+double error(const Case& c, float x, float y)
+{
+    // the reference sees the float input, so argument rounding isn't counted
+    const double ref = c.reference(static_cast<double>(x));
+    const double diff = std::fabs(static_cast<double>(y) - ref);
+    return c.kind == RELATIVE ? diff / std::fabs(ref) : diff;
+}
+
+template <typename F>
+double cyclesPerValue(F f, std::vector<float>& out, int repeats)
+{
+    const uint64_t t0 = bench::cycles();
+    for (int r = 0; r < repeats; ++r) {
+        f();
+        bench::doNotOptimize(out[0]);
+    }
+    return static_cast<double>(bench::cycles() - t0) / (static_cast<double>(repeats) * out.size());
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const int points = argc > 1 ? std::atoi(argv[1]) : 1 << 22;
+    if (points <= 0) {
+        fprintf(stderr, "usage: fastmath_bench [points]\n");
+        return 1;
+    }
+
+    bool ok = true;
+    printf("%-6s %-18s %12s %12s %10s   %8s %8s %8s  (cycles/value)\n",
+           "func", "range", "scalar err", "block err", "bound", "libm", "scalar", "block");
+    for (const Case& c : cases) {
+        std::vector<float> in(static_cast<size_t>(points)), out(in.size());
+        for (int i = 0; i < points; ++i)
+            in[i] = c.lo + (c.hi - c.lo) * (static_cast<float>(i) / static_cast<float>(points - 1));
+
+        double scalarErr = 0.0, blockErr = 0.0;
+        for (int i = 0; i < points; ++i)
+            scalarErr = std::fmax(scalarErr, error(c, in[i], c.scalar(in[i])));
+        c.block(in.data(), out.data(), points);
+        for (int i = 0; i < points; ++i)
+            blockErr = std::fmax(blockErr, error(c, in[i], out[i]));
+
+        const int repeats = std::max(1, (1 << 24) / points);
+        const double tLibm = cyclesPerValue([&] { for (int i = 0; i < points; ++i) out[i] = c.libm(in[i]); },
+                                            out, repeats);
+        const double tScalar = cyclesPerValue([&] { for (int i = 0; i < points; ++i) out[i] = c.scalar(in[i]); },
+                                              out, repeats);
+        const double tBlock = cyclesPerValue([&] { c.block(in.data(), out.data(), points); }, out, repeats);
+
+        const bool pass = scalarErr <= c.bound && blockErr <= c.bound;
+        ok = ok && pass;
+        char range[32];
+        snprintf(range, sizeof(range), "[%g, %g]", c.lo, c.hi);
+        printf("%-6s %-18s %12.3g %12.3g %10.3g%s %8.2f %8.2f %8.2f\n", c.name, range, scalarErr, blockErr,
+               c.bound, pass ? "  " : " !", tLibm, tScalar, tBlock);
+    }
+    // double precision versions, scalar only; the setup paths use them
+    struct DoubleCase { const char* name; double lo, hi, bound; double (*fast)(double); double (*ref)(double); };
+    const DoubleCase doubleCases[] = {
+        {"exp d", -708.0, 708.0, 1e-15, [](double x) { return audio_tools::fastExp(x); }, expRef},
+        {"pow10 d", -307.0, 307.0, 1e-15, [](double x) { return audio_tools::fastPow10(x); }, pow10Ref},
+    };
+    for (const DoubleCase& c : doubleCases) {
+        double err = 0.0;
+        for (int i = 0; i < points; ++i) {
+            const double x = c.lo + (c.hi - c.lo) * (static_cast<double>(i) / (points - 1));
+            err = std::fmax(err, std::fabs(c.fast(x) - c.ref(x)) / c.ref(x));
+        }
+        const bool pass = err <= c.bound;
+        ok = ok && pass;
+        char range[32];
+        snprintf(range, sizeof(range), "[%g, %g]", c.lo, c.hi);
+        printf("%-6s %-18s %12.3g %12s %10.3g%s\n", c.name, range, err, "-", c.bound, pass ? "" : " !");
+    }
+    printf("%s\n", ok ? "all within bounds" : "BOUND EXCEEDED");
+    return ok ? 0 : 1;
+}
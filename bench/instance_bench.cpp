@@ -0,0 +1,192 @@
+// instance_bench - how Modulation scales with the number of instances.
+//
+//   instance_bench [block] [frames per point] [memory limit MB]
+//
+// Creates 1, 8, 64, 256 and 1024 stereo instances at 44.1, 96 and 192 kHz
+// and processes them round robin, one block each in turn, the way a host runs
+// a session's plug-ins. Every instance has its own input and output buffers.
+// The same number of instance-frames is processed at every point, so the
+// columns compare directly.
+//
+// The memory part lists what an instance costs: the object, its arena (the
+// two delay lines, sized for 2 s at the rate), its share of the wavetables
+// (shared by all instances; none with the analytic LFO) and its I/O buffers.
+// "hot KB" is what a block actually touches: object, buffers, tables and
+// the stretch of delay line behind the write heads. Where the kernel lets
+// /proc tell, the measured resident growth per instance is shown next to it.
+//
+// Throughput is given per instance-frame, as the number of instances that
+// would fit in real time on this core, and as the slowdown against the
+// single instance. The first count where the slowdown passes 1.5x is marked
+// as the cliff. Points whose arenas would exceed the memory limit (default
+// 2048 MB) are skipped.
+
+#include "../include/modulation.h"
+#include "benchutil.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+constexpr double cliff_ratio = 1.5;
+
+// bytes resident, -1 where /proc isn't there
+long long residentBytes()
+{
+#if defined(__linux__)
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (!f)
+        return -1;
+    long long pages = 0, resident = 0;
+    const int n = fscanf(f, "%lld %lld", &pages, &resident);
+    fclose(f);
+    return n == 2 ? resident * sysconf(_SC_PAGESIZE) : -1;
+#else
+    return -1;
+#endif
+}
+
+size_t sharedTableBytes()
+{
+#ifdef MYMODULATION_ANALYTIC_LFO
+    return 0;
+#else
+    return sizeof(WTables<1024>);
+#endif
+}
+
+struct Instance
+{
+    std::unique_ptr<Modulation> mod;
+    std::vector<float> in[2], out[2];
+};
+
+struct Result
+{
+    double nsPerFrame, l1dPerFrame, llcPerFrame;
+};
+
+Result run(std::vector<Instance>& instances, int block, long long framesPerPoint)
+{
+    const long long rounds = std::max<long long>(1, framesPerPoint / (block * static_cast<long long>(instances.size())));
+    auto round = [&] {
+        for (Instance& inst : instances)
+            inst.mod->processStereo(inst.in[0].data(), inst.in[1].data(),
+                                    inst.out[0].data(), inst.out[1].data(), block);
+    };
+    round();    // every instance once, so the first touches aren't timed
+
+    bench::PerfCounters perf;
+    perf.start();
+    const uint64_t t0 = bench::cycles();
+    for (long long r = 0; r < rounds; ++r)
+        round();
+    const uint64_t t1 = bench::cycles();
+    perf.stop();
+    bench::doNotOptimize(instances[0].out[0][0]);
+
+    const double frames = static_cast<double>(rounds) * block * static_cast<double>(instances.size());
+    auto perFrame = [&](bench::Counter c) {
+        const int64_t v = perf.read(c);
+        return v < 0 ? -1.0 : static_cast<double>(v) / frames;
+    };
+    Result r;
+    r.nsPerFrame = static_cast<double>(t1 - t0) / cycleCounterFrequency() * 1e9 / frames;
+    r.l1dPerFrame = perFrame(bench::L1D_MISSES);
+    r.llcPerFrame = perFrame(bench::LLC_MISSES);
+    return r;
+}
+
+void printCounter(const char* fmt, double value)
+{
+    if (value < 0.0) printf("%9s", "n/a");
+    else printf(fmt, value);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const int block = argc > 1 ? std::atoi(argv[1]) : 256;
+    const long long framesPerPoint = argc > 2 ? std::atoll(argv[2]) : (1 << 22);
+    const double limitMb = argc > 3 ? std::atof(argv[3]) : 2048.0;
+    if (block <= 0 || framesPerPoint < block || limitMb <= 0.0) {
+        fprintf(stderr, "usage: instance_bench [block] [frames per point] [memory limit MB]\n");
+        return 1;
+    }
+
+    static const double rates[] = {44100.0, 96000.0, 192000.0};
+    static const int counts[] = {1, 8, 64, 256, 1024};
+    // a chorus with feedback, the longest delays and so the most delay line touched
+    ModulationParams params;
+    params.effectType = CHORUS;
+    params.feedback = 0.5;
+    params.modDepth = 1.0;
+
+    printf("stereo chorus, block %d, %lld instance-frames per point, %s LFO\n", block, framesPerPoint,
+           sharedTableBytes() ? "wavetable" : "analytic");
+    for (double rate : rates) {
+        // the footprint of one instance at this rate
+        Modulation probe(rate, params.modRate);
+        probe.setParams(params);
+        const size_t object = sizeof(Modulation);
+        const size_t arena = probe.arenaCapacity();
+        const size_t buffers = 4 * block * sizeof(float);
+        const double maxDelaySamples = probe.maxDelayMs() * rate / 1000.0;
+        const double hotDelay = 2.0 * (maxDelaySamples + block + 4) * sizeof(float);
+        printf("\n%.1f kHz: object %zu B, arena %.2f MB, buffers %zu B, tables %zu B shared\n",
+               rate / 1000.0, object, arena / 1048576.0, buffers, sharedTableBytes());
+        printf("%9s %10s %10s %10s %9s %11s %9s %9s %9s\n", "instances", "MB total", "hot KB",
+               "rss KB/i", "ns/frame", "rt inst", "slowdown", "L1D/fr", "LLC/fr");
+
+        double baseline = 0.0;
+        bool cliffMarked = false;
+        for (int count : counts) {
+            const double totalMb = count * (object + arena + buffers) / 1048576.0 + sharedTableBytes() / 1048576.0;
+            const double hotKb = (count * (object + buffers + hotDelay) + sharedTableBytes()) / 1024.0;
+            if (totalMb > limitMb) {
+                printf("%9d %10.1f %10.1f   skipped, over the %.0f MB limit\n", count, totalMb, hotKb, limitMb);
+                continue;
+            }
+            const long long rssBefore = residentBytes();
+            std::vector<Instance> instances(static_cast<size_t>(count));
+            for (int i = 0; i < count; ++i) {
+                Instance& inst = instances[static_cast<size_t>(i)];
+                inst.mod.reset(new Modulation(rate, params.modRate));
+                inst.mod->setParams(params);
+                inst.mod->seekLfo(static_cast<uint64_t>(i) * 997);     // not all in phase
+                for (int ch = 0; ch < 2; ++ch) {
+                    inst.in[ch].resize(static_cast<size_t>(block));
+                    inst.out[ch].resize(static_cast<size_t>(block));
+                    for (int s = 0; s < block; ++s)
+                        inst.in[ch][s] = 0.5f * std::sin(0.01f * static_cast<float>(s + 37 * i + ch));
+                }
+            }
+            const long long rssAfter = residentBytes();
+            const Result r = run(instances, block, framesPerPoint);
+
+            if (count == counts[0])
+                baseline = r.nsPerFrame;
+            const double slowdown = r.nsPerFrame / baseline;
+            const bool cliff = !cliffMarked && slowdown > cliff_ratio;
+            cliffMarked = cliffMarked || cliff;
+            const double budgetNs = 1e9 / rate;
+            printf("%9d %10.1f %10.1f ", count, totalMb, hotKb);
+            printCounter("%10.0f ", rssBefore < 0 || rssAfter < 0 ? -1.0
+                         : static_cast<double>(rssAfter - rssBefore) / count / 1024.0);
+            printf("%9.2f %11.0f %9.2f ", r.nsPerFrame, budgetNs / r.nsPerFrame, slowdown);
+            printCounter("%9.3f", r.l1dPerFrame);
+            printCounter(" %9.4f", r.llcPerFrame);
+            printf("%s\n", cliff ? "  <- cliff" : "");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,204 @@
+#ifndef MOCKHOST_H
+#define MOCKHOST_H
+
+// A minimal in-process host for PlugProcessor: it makes the calls a DAW makes
+// (initialize, setBusArrangements, setupProcessing, setActive, process, and
+// terminate/release at the end) with the buffers and parameter queues of a
+// real ProcessData, so benchmarks measure the plug-in the way a host runs it,
+// parameter parsing and 32/64 bit dispatch included.
+//
+//   bench::MockHost host(config);
+//   host.addPoint(kParamFeedbackID, 0, 0.8);   // queued for the next block
+//   host.process(512);                          // block of the host buffers
+//
+// A script, if set, is asked for every block's parameter changes before the
+// block runs; points added by hand go in the same queues. Both are cleared
+// after each process() call, like a host's per-block queues. Each block's
+// PlugProcessor::process call is timed on its own, in cycle counter ticks.
+
+#include "../include/plugprocessor.h"
+#include "../include/plugids.h"
+#include "../include/cyclecounter.h"
+#include "public.sdk/source/vst/hosting/parameterchanges.h"
+#include <vector>
+
+namespace bench
+{
+
+using namespace Steinberg;
+
+class MockHost
+{
+public:
+    struct Config
+    {
+        int32 numChannels = 2;
+        int32 maxBlockSize = 4096;
+        double sampleRate = 48000.0;
+        int32 sampleSize = Vst::kSample32;
+        int32 processMode = Vst::kRealtime;
+        bool inPlace = false;       // outputs are the input buffers, as many hosts do
+    };
+    // fills the parameter changes of block number `block`
+    using Script = void (*)(Vst::ParameterChanges& changes, long long block, int32 numSamples);
+
+    explicit MockHost(const Config& config);
+    ~MockHost();
+    MockHost(const MockHost&) = delete;
+    MockHost& operator=(const MockHost&) = delete;
+
+    MyModulation::PlugProcessor& processor() noexcept { return *m_processor; }
+    const Config& config() const noexcept { return m_config; }
+
+    // the constructor sets up and activates; this deactivates if needed, sets
+    // up again and reactivates, as hosts do on a sample rate or size change
+    void setup(double sampleRate, int32 sampleSize);
+    void setActive(bool active);
+    bool active() const noexcept { return m_active; }
+
+    void setScript(Script script) noexcept { m_script = script; }
+    void addPoint(Vst::ParamID id, int32 sampleOffset, Vst::ParamValue value);
+
+    // host buffers, maxBlockSize samples per channel; in place they're the same
+    float* input32(int32 ch) noexcept { return m_in32[ch].data(); }
+    float* output32(int32 ch) noexcept { return m_config.inPlace ? m_in32[ch].data() : m_out32[ch].data(); }
+    double* input64(int32 ch) noexcept { return m_in64[ch].data(); }
+    double* output64(int32 ch) noexcept { return m_config.inPlace ? m_in64[ch].data() : m_out64[ch].data(); }
+    // what the processor wrote to its output queues in the last block
+    Vst::ParameterChanges& outputChanges() noexcept { return m_outputChanges; }
+    long long blocksProcessed() const noexcept { return m_block; }
+    // PlugProcessor::process alone in the last block, see readCycleCounter()
+    uint64_t lastProcessTicks() const noexcept { return m_lastTicks; }
+
+    // one block of numSamples, starting at sample `offset` of the host buffers
+    tresult process(int32 numSamples, int32 offset = 0);
+
+private:
+    template <typename FloatType>
+    static void point(std::vector<std::vector<FloatType>>& in, std::vector<std::vector<FloatType>>& out,
+                      std::vector<FloatType*>& inPtrs, std::vector<FloatType*>& outPtrs, bool inPlace,
+                      int32 offset) noexcept;
+
+    Config m_config;
+    MyModulation::PlugProcessor* m_processor;
+    std::vector<std::vector<float>> m_in32, m_out32;
+    std::vector<std::vector<double>> m_in64, m_out64;
+    std::vector<float*> m_inPtrs32, m_outPtrs32;
+    std::vector<double*> m_inPtrs64, m_outPtrs64;
+    Vst::AudioBusBuffers m_inBus, m_outBus;
+    Vst::ParameterChanges m_inputChanges, m_outputChanges;
+    Vst::ProcessData m_data;
+    Script m_script = nullptr;
+    long long m_block = 0;
+    uint64_t m_lastTicks = 0;
+    bool m_active = false;
+};
+
+inline MockHost::MockHost(const Config& config) :
+    m_config(config),
+    m_processor(static_cast<MyModulation::PlugProcessor*>(
+                    static_cast<Vst::IAudioProcessor*>(MyModulation::PlugProcessor::createInstance(nullptr)))),
+    m_in32(config.numChannels, std::vector<float>(config.maxBlockSize)),
+    m_out32(config.inPlace ? 0 : config.numChannels, std::vector<float>(config.maxBlockSize)),
+    m_in64(config.numChannels, std::vector<double>(config.maxBlockSize)),
+    m_out64(config.inPlace ? 0 : config.numChannels, std::vector<double>(config.maxBlockSize)),
+    m_inPtrs32(config.numChannels), m_outPtrs32(config.numChannels),
+    m_inPtrs64(config.numChannels), m_outPtrs64(config.numChannels),
+    m_inputChanges(16), m_outputChanges(16)
+{
+    m_processor->initialize(nullptr);
+    Vst::SpeakerArrangement arr = (static_cast<Vst::SpeakerArrangement>(1) << config.numChannels) - 1;
+    m_processor->setBusArrangements(&arr, 1, &arr, 1);
+
+    m_inBus.numChannels = m_outBus.numChannels = config.numChannels;
+    m_inBus.silenceFlags = m_outBus.silenceFlags = 0;
+    m_data.numInputs = m_data.numOutputs = 1;
+    m_data.inputs = &m_inBus;
+    m_data.outputs = &m_outBus;
+    m_data.inputParameterChanges = &m_inputChanges;
+    m_data.outputParameterChanges = &m_outputChanges;
+    setup(config.sampleRate, config.sampleSize);
+    setActive(true);
+}
+
+inline MockHost::~MockHost()
+{
+    setActive(false);
+    m_processor->terminate();
+    m_processor->release();
+}
+
+inline void MockHost::setup(double sampleRate, int32 sampleSize)
+{
+    const bool wasActive = m_active;
+    setActive(false);
+    m_config.sampleRate = sampleRate;
+    m_config.sampleSize = sampleSize;
+    Vst::ProcessSetup setup;
+    setup.processMode = m_config.processMode;
+    setup.symbolicSampleSize = sampleSize;
+    setup.maxSamplesPerBlock = m_config.maxBlockSize;
+    setup.sampleRate = sampleRate;
+    m_processor->setupProcessing(setup);
+    m_data.processMode = m_config.processMode;
+    m_data.symbolicSampleSize = sampleSize;
+    // the two pointers share a union in the SDK
+    if (sampleSize == Vst::kSample64) {
+        m_inBus.channelBuffers64 = m_inPtrs64.data();
+        m_outBus.channelBuffers64 = m_outPtrs64.data();
+    }
+    else {
+        m_inBus.channelBuffers32 = m_inPtrs32.data();
+        m_outBus.channelBuffers32 = m_outPtrs32.data();
+    }
+    setActive(wasActive);
+}
+
+inline void MockHost::setActive(bool active)
+{
+    if (active == m_active)
+        return;
+    m_processor->setActive(active);
+    m_active = active;
+}
+
+inline void MockHost::addPoint(Vst::ParamID id, int32 sampleOffset, Vst::ParamValue value)
+{
+    int32 index = 0;
+    Vst::IParamValueQueue* queue = m_inputChanges.addParameterData(id, index);
+    if (queue)
+        queue->addPoint(sampleOffset, value, index);
+}
+
+template <typename FloatType>
+inline void MockHost::point(std::vector<std::vector<FloatType>>& in, std::vector<std::vector<FloatType>>& out,
+                            std::vector<FloatType*>& inPtrs, std::vector<FloatType*>& outPtrs, bool inPlace,
+                            int32 offset) noexcept
+{
+    for (size_t ch = 0; ch < in.size(); ++ch) {
+        inPtrs[ch] = in[ch].data() + offset;
+        outPtrs[ch] = (inPlace ? in[ch].data() : out[ch].data()) + offset;
+    }
+}
+
+inline tresult MockHost::process(int32 numSamples, int32 offset)
+{
+    if (m_config.sampleSize == Vst::kSample64)
+        point(m_in64, m_out64, m_inPtrs64, m_outPtrs64, m_config.inPlace, offset);
+    else
+        point(m_in32, m_out32, m_inPtrs32, m_outPtrs32, m_config.inPlace, offset);
+    if (m_script)
+        m_script(m_inputChanges, m_block, numSamples);
+    m_outputChanges.clearQueue();
+    m_data.numSamples = numSamples;
+    const uint64_t t0 = readCycleCounter();
+    const tresult result = m_processor->process(m_data);
+    m_lastTicks = readCycleCounter() - t0;
+    m_inputChanges.clearQueue();
+    ++m_block;
+    return result;
+}
+
+} // namespace bench
+
+#endif // MOCKHOST_H
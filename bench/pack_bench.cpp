@@ -0,0 +1,213 @@
+// pack_bench - ModulationPack lanes against one Modulation per lane.
+//
+//   pack_bench [seconds]
+//
+// Runs packs of 4, 8 and 16 lanes next to one Modulation per lane with the
+// same settings, every lane a different effect, waveform, feedback, rate,
+// depth and stereo phase, the custom shape among them. Input is noise and a
+// sine sweep, per lane and channel, in 64 sample blocks, stereo (linked LFO,
+// processStereo) and mono (one channel, process). Halfway through every lane
+// gets a new rate and waveform and its LFO is moved with seekLfo.
+//
+// A lane promises the output of its Modulation, so the largest difference
+// has to be 0. Only multiply-adds the compiler contracts into FMAs (with
+// -march on FMA hardware) may move the last bits, then the bound is a few
+// ulp of the peak. Reports the difference and both costs in cycles per lane
+// sample, and exits with 1 on a mismatch, so it doubles as the check for it.
+// The pack reads the wavetables, so with MYMODULATION_ANALYTIC_LFO there is
+// nothing to compare against and only the cost is reported.
+
+#include "../include/modulation_pack.h"
+#include "benchutil.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace
+{
+
+constexpr double sample_rate = 48000.0;
+constexpr int block_size = 64;
+constexpr double two_pi = 6.283185307179586477;
+
+#ifdef MYMODULATION_ANALYTIC_LFO
+constexpr bool comparable = false;
+#else
+constexpr bool comparable = true;
+#endif
+#ifdef __FMA__
+constexpr double bound = 4e-7;      // relative to the peak
+#else
+constexpr double bound = 0.0;
+#endif
+
+ModulationParams laneParams(size_t lane)
+{
+    ModulationParams p;
+    p.effectType = static_cast<int>(lane % 3);
+    p.waveform = static_cast<int>(lane % 5);
+    p.feedback = lane % 4 == 1 ? 0.0 : 0.9 - 0.35 * static_cast<double>(lane % 6);
+    p.modRate = 0.2 + 0.77 * static_cast<double>(lane);
+    p.modDepth = 0.3 + 0.05 * static_cast<double>(lane % 12);
+    p.chorusOffset = 3.0 + 2.5 * static_cast<double>(lane % 7);
+    p.dryWet = 0.25 + 0.05 * static_cast<double>(lane % 10);
+    p.stereoPhase = 23.0 * static_cast<double>(lane);
+    return p;
+}
+
+// a second of noise, then a sweep, different per lane and channel
+void generate(std::vector<float>& signal, size_t lane, int ch)
+{
+    uint32_t seed = static_cast<uint32_t>(lane * 2 + static_cast<size_t>(ch)) * 2654435761u + 1u;
+    double phase = 0.0;
+    const size_t second = static_cast<size_t>(sample_rate);
+    for (size_t i = 0; i < signal.size(); ++i) {
+        if (i % (2 * second) < second) {
+            seed = seed * 1664525u + 1013904223u;
+            signal[i] = static_cast<float>(static_cast<int32_t>(seed) * (0.7 / 2147483648.0));
+        } else {
+            const double hz = 40.0 * std::pow(400.0, static_cast<double>(i % second) / second);
+            phase += two_pi * hz / sample_rate;
+            signal[i] = static_cast<float>(0.7 * std::sin(phase + static_cast<double>(lane)));
+        }
+    }
+}
+
+struct Result
+{
+    double diff = 0.0;
+    double peak = 0.0;
+    double packCycles = 0.0;
+    double modCycles = 0.0;
+};
+
+template <size_t LANES>
+Result run(size_t numSamples, int numChannels, const UserLfoTable& custom)
+{
+    std::unique_ptr<ModulationPack<LANES>> pack(new ModulationPack<LANES>(sample_rate));
+    std::vector<std::unique_ptr<Modulation>> mods;
+    pack->setUserTable(custom);
+    for (size_t l = 0; l < LANES; ++l) {
+        const ModulationParams p = laneParams(l);
+        mods.emplace_back(new Modulation(sample_rate, p.modRate));
+        mods.back()->setUserTable(&custom);
+        mods.back()->setParams(p);
+        pack->setParams(l, p);
+    }
+
+    // [lane][ch]: the pack's in place, Modulation's a copy
+    std::vector<std::vector<std::vector<float>>> packOut(LANES), modOut(LANES);
+    for (size_t l = 0; l < LANES; ++l) {
+        for (int ch = 0; ch < numChannels; ++ch) {
+            std::vector<float> signal(numSamples);
+            generate(signal, l, ch);
+            packOut[l].push_back(signal);
+            modOut[l].push_back(signal);
+        }
+    }
+
+    Result r;
+    uint64_t packCycles = 0, modCycles = 0;
+    std::vector<float*> channels(LANES * 2);
+    std::vector<float* const*> lanes(LANES);
+    for (size_t offset = 0; offset < numSamples; offset += block_size) {
+        if (offset == numSamples / 2 / block_size * block_size) {
+            for (size_t l = 0; l < LANES; ++l) {
+                const double rate = 0.5 + 0.31 * static_cast<double>(LANES - l);
+                const int waveform = static_cast<int>((l + 2) % 5);
+                const uint64_t position = 1000u * l;
+                mods[l]->setLfoFreq(rate);
+                mods[l]->setWaveform(waveform);
+                mods[l]->seekLfo(position);
+                pack->setLfoFreq(l, rate);
+                pack->setWaveform(l, waveform);
+                pack->seekLfo(l, position);
+            }
+        }
+        const int n = static_cast<int>(std::min<size_t>(block_size, numSamples - offset));
+        for (size_t l = 0; l < LANES; ++l) {
+            for (int ch = 0; ch < numChannels; ++ch)
+                channels[l * 2 + ch] = packOut[l][ch].data() + offset;
+            lanes[l] = &channels[l * 2];
+        }
+        const uint64_t t0 = bench::cycles();
+        pack->process(lanes.data(), numChannels, n);
+        const uint64_t t1 = bench::cycles();
+        for (size_t l = 0; l < LANES; ++l) {
+            float* left = modOut[l][0].data() + offset;
+            if (numChannels == 2) {
+                float* right = modOut[l][1].data() + offset;
+                mods[l]->processStereo(left, right, left, right, n);
+            } else {
+                mods[l]->process(left, left, n, 0);
+            }
+        }
+        const uint64_t t2 = bench::cycles();
+        packCycles += t1 - t0;
+        modCycles += t2 - t1;
+    }
+
+    for (size_t l = 0; l < LANES; ++l) {
+        for (int ch = 0; ch < numChannels; ++ch) {
+            for (size_t i = 0; i < numSamples; ++i) {
+                const double a = packOut[l][ch][i], b = modOut[l][ch][i];
+                r.diff = std::max(r.diff, std::fabs(a - b));
+                r.peak = std::max(r.peak, std::fabs(b));
+            }
+        }
+    }
+    const double laneSamples = static_cast<double>(numSamples) * LANES * numChannels;
+    r.packCycles = static_cast<double>(packCycles) / laneSamples;
+    r.modCycles = static_cast<double>(modCycles) / laneSamples;
+    return r;
+}
+
+template <size_t LANES>
+int report(size_t numSamples, const UserLfoTable& custom)
+{
+    int failures = 0;
+    for (int numChannels = 2; numChannels >= 1; --numChannels) {
+        const Result r = run<LANES>(numSamples, numChannels, custom);
+        const bool ok = !comparable || r.diff <= bound * r.peak;
+        failures += ok ? 0 : 1;
+        char limit[16] = "n/a";
+        if (comparable)
+            snprintf(limit, sizeof(limit), "%.3g", bound * r.peak);
+        printf("%5zu %-7s %12.3g %12s %10.2f %10.2f %8.2fx  %s\n", LANES, numChannels == 2 ? "stereo" : "mono",
+               r.diff, limit, r.packCycles, r.modCycles, r.modCycles / std::max(r.packCycles, 1e-9),
+               ok ? "" : "FAIL");
+    }
+    return failures;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const double seconds = argc > 1 ? std::atof(argv[1]) : 4.0;
+    if (!(seconds > 0.0)) {
+        fprintf(stderr, "usage: pack_bench [seconds]\n");
+        return 1;
+    }
+    const size_t numSamples = static_cast<size_t>(seconds * sample_rate);
+
+    // a shape no built-in waveform has, so the lanes on it show
+    UserLfoTable custom;
+    for (size_t i = 0; i < custom.size(); ++i) {
+        const double x = static_cast<double>(i) / custom.size();
+        custom[i] = static_cast<float>(std::sin(two_pi * x) * 0.6 + std::sin(3.0 * two_pi * x) * 0.4);
+    }
+
+    printf("%.1f s at %.0f Hz, %d sample blocks%s\n", seconds, sample_rate, block_size,
+           comparable ? "" : ", analytic LFO: cost only");
+    printf("%5s %-7s %12s %12s %10s %10s %9s\n", "lanes", "", "max diff", "bound", "pack cyc", "mod cyc", "speedup");
+    int failures = 0;
+    failures += report<4>(numSamples, custom);
+    failures += report<8>(numSamples, custom);
+    failures += report<16>(numSamples, custom);
+    printf("%s, %d mismatches\n", failures ? "FAIL" : "ok", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,468 @@
+// quality_bench - quality against cost of the interpolators, LFOs and quality tiers.
+//
+//   quality_bench [seconds]
+//
+// Delay configurations: every combination of interpolation (linear, Hermite),
+// oversampling (1x, 2x) and LFO control rate (every sample, every 16) runs
+// through Modulation as a chorus, all wet and without feedback, swept by a
+// 1 Hz sine over the full depth from the shortest offset (5 to 30 ms), so the
+// read position passes through every fraction many times. For a test
+// tone the exact output is known: the input delayed by the delay the engine
+// itself reports for each sample. The output is fitted to that reference in
+// gain and phase, oversampled also in a lag of a few samples (the half-band
+// filters' group delay), and
+//   THD+N     residual power against the fitted tone at 1 kHz, in dB
+//   mod noise the same at 10 kHz, where the fraction errors are largest
+//   droop     fitted gain at 10 kHz, the sweep's average frequency response
+//   path err  largest deviation of the delay from an ideal sine sweep, in
+//             samples: LFO shape and control rate ramp together
+// Cost is cycles per stereo frame of the chorus with feedback in 64 sample
+// blocks, the workload of the other benchmarks, best of many short runs.
+//
+// LFOs: the wavetable at three sizes and the table-free engine, every sample
+// and ramped every 16 samples as ECO does. Harmonic error is the error power
+// of the sine against the exact sine at the oscillator's own phase, relative
+// to the sine; max error is the largest deviation on the sine and on the
+// triangle. Cost is cycles per stereo sample of the linked generation
+// Modulation uses, table bytes are shared by all instances.
+//
+// Each table marks its Pareto front with '*': no other row is at least as good
+// on every ranked column and better on one. Ranked are cost and the audible
+// figures, at the precision printed; the path error is shown, not ranked (it
+// stays far below a sample), and LFO errors under float resolution (-120 dB,
+// 1e-6) count as equal. The tiers and the default build are labelled where
+// they appear.
+
+#include "../include/modulation.h"
+#include "../include/analytic_osc.h"
+#include "benchutil.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using namespace Steinberg::MyModulation;
+
+constexpr double sample_rate = 48000.0;
+constexpr double two_pi = 6.283185307179586477;
+constexpr double sweep_hz = 1.0;
+constexpr int cost_block = 64;
+constexpr long long cost_chunk = 256;          // blocks per timed run, short enough to miss interrupts
+
+double dB(double powerRatio)
+{
+    return 10.0 * std::log10(std::max(powerRatio, 1e-30));
+}
+
+// the same total work as three passes over the measurement
+long long costRepeats(long long frames)
+{
+    return std::max(3LL, 3 * frames / (cost_chunk * cost_block));
+}
+
+double rounded(double value, double precision)
+{
+    return std::round(value / precision) * precision;
+}
+
+// rows on the front: nobody else is at least as good everywhere and better somewhere.
+// Every column is lower is better
+std::vector<bool> paretoFront(const std::vector<std::vector<double>>& rows)
+{
+    std::vector<bool> front(rows.size(), true);
+    for (size_t i = 0; i < rows.size(); ++i)
+        for (size_t j = 0; j < rows.size() && front[i]; ++j) {
+            if (i == j)
+                continue;
+            bool noWorse = true, better = false;
+            for (size_t c = 0; c < rows[i].size(); ++c) {
+                noWorse = noWorse && rows[j][c] <= rows[i][c];
+                better = better || rows[j][c] < rows[i][c];
+            }
+            front[i] = !(noWorse && better);
+        }
+    return front;
+}
+
+//--- delay configurations ---------------------------------------------------
+
+struct Config
+{
+    const char* interpolation;
+    int order;
+    int oversampling;
+    int controlRate;
+};
+
+struct ToneResult
+{
+    double noiseDb;     // residual against the fitted reference
+    double gainDb;      // fitted against the input
+    double pathErr;     // samples
+};
+
+// a pure delay; not the vibrato, whose sweep ends below one sample where the
+// delay line passes its input and would hide the interpolator
+ModulationParams sweep()
+{
+    ModulationParams p;
+    p.dryWet = 1.0;
+    p.feedback = 0.0;
+    p.modDepth = 1.0;
+    p.modRate = sweep_hz;
+    p.chorusOffset = ModulationConst::CHRS_OFST_MIN;
+    p.waveform = static_cast<int>(Waveform::SINE);
+    p.effectType = CHORUS;
+    return p;
+}
+
+std::unique_ptr<Modulation> makeModulation(const Config& c, const ModulationParams& p)
+{
+    std::unique_ptr<Modulation> mod(new Modulation(sample_rate, p.modRate, c.oversampling));
+    mod->setParams(p);
+    mod->setQualitySettings(QualitySettings {c.order, c.controlRate, c.oversampling});
+    return mod;
+}
+
+struct Fit
+{
+    double residual, fitted, gain;
+};
+
+// least squares a sin + b cos of the reference phase, the delay trajectory
+// read `lag` samples earlier
+Fit fitTone(const std::vector<float>& out, const std::vector<double>& delay, size_t first, double toneHz,
+            double lag)
+{
+    const double w = two_pi * toneHz / sample_rate;
+    std::vector<double> phase(out.size() - first);
+    for (size_t n = first; n < out.size(); ++n) {
+        const double t = static_cast<double>(n) - lag;
+        const size_t i = static_cast<size_t>(t);
+        const double f = t - static_cast<double>(i);
+        const double d = delay[i] + (delay[i + 1] - delay[i]) * f;
+        phase[n - first] = w * (static_cast<double>(n) - d);
+    }
+    double ss = 0.0, cc = 0.0, sc = 0.0, ys = 0.0, yc = 0.0;
+    for (size_t n = first; n < out.size(); ++n) {
+        const double s = std::sin(phase[n - first]), c = std::cos(phase[n - first]);
+        ss += s * s;
+        cc += c * c;
+        sc += s * c;
+        ys += out[n] * s;
+        yc += out[n] * c;
+    }
+    const double det = ss * cc - sc * sc;
+    const double a = (ys * cc - yc * sc) / det;
+    const double b = (yc * ss - ys * sc) / det;
+    Fit fit = {0.0, 0.0, std::sqrt(a * a + b * b)};
+    for (size_t n = first; n < out.size(); ++n) {
+        const double f = a * std::sin(phase[n - first]) + b * std::cos(phase[n - first]);
+        fit.residual += (out[n] - f) * (out[n] - f);
+        fit.fitted += f * f;
+    }
+    return fit;
+}
+
+ToneResult measureTone(const Config& c, double toneHz, long long frames)
+{
+    const ModulationParams p = sweep();
+    std::unique_ptr<Modulation> mod = makeModulation(c, p);
+    // the first stretch fills the delay line and settles the filters
+    const size_t settle = static_cast<size_t>(sample_rate * 0.05);
+    const size_t total = settle + static_cast<size_t>(frames);
+    const double amplitude = 0.5;
+    std::vector<float> out(total);
+    std::vector<double> delay(total);
+    for (size_t n = 0; n < total; ++n) {
+        const float in = static_cast<float>(amplitude * std::sin(two_pi * toneHz * n / sample_rate));
+        mod->process(&in, &out[n], 1, 0);
+        delay[n] = mod->currentDelaySamples(0);
+    }
+
+    // oversampled, the delay read back is the last sub-sample's, and the
+    // output lags the delay line by the down-sampler's group delay at the
+    // tone; the lag that fits best is that, the phase takes the rest
+    Fit best = fitTone(out, delay, settle, toneHz, 0.0);
+    double lag = 0.0;
+    if (c.oversampling > 1) {
+        for (double l = 0.125; l <= 8.0; l += 0.125) {
+            const Fit fit = fitTone(out, delay, settle, toneHz, l);
+            if (fit.residual < best.residual) {
+                best = fit;
+                lag = l;
+            }
+        }
+        for (double step = 0.0625; step > 1e-4; step *= 0.5) {
+            for (double l : {lag - step, lag + step}) {
+                const Fit fit = fitTone(out, delay, settle, toneHz, l);
+                if (l > 0.0 && fit.residual < best.residual) {
+                    best = fit;
+                    lag = l;
+                }
+            }
+        }
+    }
+
+    // what a sine sweep without errors would set, at the time the engine set it
+    const double depthSamples = p.modDepth * 25.0 * sample_rate * 1e-3;
+    const double minSamples = (p.chorusOffset + 0.01) * sample_rate * 1e-3;
+    const double subSample = (c.oversampling - 1.0) / c.oversampling;
+    double pathErr = 0.0;
+    for (size_t n = settle; n < total; ++n) {
+        const double t = (static_cast<double>(n) + subSample) / sample_rate;
+        const double ideal = minSamples + depthSamples * (0.5 + 0.5 * std::sin(two_pi * sweep_hz * t));
+        pathErr = std::max(pathErr, std::fabs(delay[n] - ideal));
+    }
+
+    ToneResult r;
+    r.noiseDb = dB(best.residual / best.fitted);
+    r.gainDb = 20.0 * std::log10(best.gain / amplitude);
+    r.pathErr = pathErr;
+    return r;
+}
+
+double configCycles(const Config& c, long long frames)
+{
+    ModulationParams p;
+    p.effectType = CHORUS;
+    p.feedback = 0.5;
+    std::unique_ptr<Modulation> mod = makeModulation(c, p);
+    std::vector<float> left(cost_block), right(cost_block);
+    for (int i = 0; i < cost_block; ++i) {
+        left[i] = static_cast<float>(std::sin(two_pi * 440.0 * i / sample_rate));
+        right[i] = -left[i];
+    }
+    const long long blocks = cost_chunk;
+    double best = 1e300;
+    for (long long repeat = 0; repeat < costRepeats(frames); ++repeat) {
+        const uint64_t t0 = bench::cycles();
+        for (long long b = 0; b < blocks; ++b) {
+            mod->processStereo(left.data(), right.data(), left.data(), right.data(), cost_block);
+            bench::doNotOptimize(left[0]);
+        }
+        best = std::min(best, static_cast<double>(bench::cycles() - t0) / (blocks * cost_block));
+    }
+    return best;
+}
+
+std::string tiersOf(const Config& c)
+{
+    static const char* names[NUM_QUALITY_TIERS] = {"ECO", "STANDARD", "HIGH", "ULTRA"};
+    std::string label;
+    for (int t = 0; t < NUM_QUALITY_TIERS; ++t) {
+        const QualitySettings q = qualitySettings(static_cast<QualityTier>(t));
+        if (q.interpolationOrder == c.order && q.oversampling == c.oversampling && q.lfoControlRate == c.controlRate) {
+            label += label.empty() ? "" : ",";
+            label += names[t];
+            // what realtime hosts get with the quality on Auto
+            if (static_cast<QualityTier>(t) == QualityTier::STANDARD)
+                label += " (default)";
+        }
+    }
+    return label;
+}
+
+void delayTable(double seconds)
+{
+    const Config configs[] = {
+        {"linear", 1, 1, 1}, {"linear", 1, 1, 16}, {"hermite", 3, 1, 1}, {"hermite", 3, 1, 16},
+        {"linear", 1, 2, 1}, {"linear", 1, 2, 16}, {"hermite", 3, 2, 1}, {"hermite", 3, 2, 16},
+    };
+    const long long frames = static_cast<long long>(seconds * sample_rate);
+    std::vector<std::vector<double>> rows;
+    std::vector<double> cycles;
+    for (const Config& c : configs) {
+        const ToneResult low = measureTone(c, 1000.0, frames);
+        const ToneResult high = measureTone(c, 10000.0, frames);
+        cycles.push_back(configCycles(c, frames));
+        rows.push_back({cycles.back(), low.noiseDb, high.noiseDb, -high.gainDb, std::max(low.pathErr, high.pathErr)});
+    }
+    std::vector<std::vector<double>> ranked;
+    for (const std::vector<double>& r : rows)
+        ranked.push_back({rounded(r[0], 0.1), rounded(r[1], 0.1), rounded(r[2], 0.1), rounded(r[3], 0.01)});
+    const std::vector<bool> front = paretoFront(ranked);
+
+    printf("delay, %s LFO, %.0f Hz chorus sweep at %.0f kHz\n",
+#ifdef MYMODULATION_ANALYTIC_LFO
+           "analytic",
+#else
+           "wavetable",
+#endif
+           sweep_hz, sample_rate * 1e-3);
+    printf("  %-8s %3s %4s %10s %10s %10s %10s %10s  %s\n", "interp", "os", "ctrl", "cyc/frame",
+           "THD+N dB", "modnoise", "droop dB", "path err", "tier");
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const Config& c = configs[i];
+        printf("%c %-8s %2dx %4d %10.1f %10.1f %10.1f %10.2f %10.2g  %s\n", front[i] ? '*' : ' ', c.interpolation,
+               c.oversampling, c.controlRate, rows[i][0], rows[i][1], rows[i][2], -rows[i][3], rows[i][4],
+               tiersOf(c).c_str());
+    }
+}
+
+//--- LFOs -------------------------------------------------------------------
+
+struct LfoResult
+{
+    double cycles;
+    double harmonicDb;
+    double sineMaxErr;
+    double triMaxErr;
+};
+
+double triangle(double cycle)
+{
+    return cycle < 0.25 ? 4.0 * cycle : cycle < 0.75 ? 2.0 - 4.0 * cycle : 4.0 * cycle - 4.0;
+}
+
+// the value at every sample, or every `rate` samples with a linear ramp in
+// between as Modulation does when the control rate is above 1
+template <typename Osc>
+void compare(Osc& osc, Waveform wf, int rate, long long samples, double& maxErr, double& errorPower,
+             double& signalPower)
+{
+    osc.changeWaveform(wf);
+    osc.seek(0);
+    maxErr = errorPower = signalPower = 0.0;
+    // v0 at the start of a control period, v1 at the next
+    double c0 = osc.cyclePosition(0);
+    float v0 = 0.0f;
+    osc.generate(&v0, 0);
+    osc.skip(static_cast<uint64_t>(rate - 1), 0);
+    for (long long n = 0; n < samples; n += rate) {
+        const double c1 = osc.cyclePosition(0);
+        float v1 = 0.0f;
+        osc.generate(&v1, 0);
+        osc.skip(static_cast<uint64_t>(rate - 1), 0);
+        const double span = c1 - c0 + (c1 < c0 ? 1.0 : 0.0);
+        for (int k = 0; k < rate; ++k) {
+            const double cycle = std::fmod(c0 + span * k / rate, 1.0);
+            const double exact = wf == Waveform::SINE ? std::sin(two_pi * cycle) : triangle(cycle);
+            const double y = v0 + (static_cast<double>(v1) - v0) * k / rate;
+            maxErr = std::max(maxErr, std::fabs(y - exact));
+            errorPower += (y - exact) * (y - exact);
+            signalPower += exact * exact;
+        }
+        c0 = c1;
+        v0 = v1;
+    }
+}
+
+template <typename Osc>
+LfoResult measureLfo(Osc& osc, int rate, long long samples)
+{
+    LfoResult r;
+    double errorPower, signalPower, unused;
+    compare(osc, Waveform::SINE, rate, samples, r.sineMaxErr, errorPower, signalPower);
+    r.harmonicDb = dB(errorPower / signalPower);
+    compare(osc, Waveform::TRIANGLE, rate, samples, r.triMaxErr, unused, unused);
+
+    // the linked stereo generation Modulation uses, ramped like rampDelayOffsets()
+    osc.changeWaveform(Waveform::SINE);
+    osc.setStereoPhase(90.0);
+    float out[2 * cost_block];
+    const long long blocks = cost_chunk;
+    double best = 1e300;
+    for (long long repeat = 0; repeat < costRepeats(samples); ++repeat) {
+        osc.seek(0);
+        float last[2] = {0.0f, 0.0f}, step[2] = {0.0f, 0.0f};
+        int count = 0;
+        const uint64_t t0 = bench::cycles();
+        for (long long b = 0; b < blocks; ++b) {
+            for (int s = 0; s < cost_block; ++s) {
+                if (rate == 1) {
+                    osc.template generateStereoUnipolar<Waveform::SINE>(&out[2 * s], &out[2 * s + 1]);
+                    continue;
+                }
+                if (count == 0) {
+                    float next[2];
+                    osc.template generateStereoUnipolar<Waveform::SINE>(&next[0], &next[1]);
+                    osc.skipStereo(static_cast<uint64_t>(rate - 1));
+                    step[0] = (next[0] - last[0]) / rate;
+                    step[1] = (next[1] - last[1]) / rate;
+                    count = rate;
+                }
+                --count;
+                out[2 * s] = last[0];
+                out[2 * s + 1] = last[1];
+                last[0] += step[0];
+                last[1] += step[1];
+            }
+            bench::doNotOptimize(out[0]);
+        }
+        best = std::min(best, static_cast<double>(bench::cycles() - t0) / (blocks * cost_block));
+    }
+    r.cycles = best;
+    return r;
+}
+
+void lfoTable(double seconds)
+{
+    const long long samples = static_cast<long long>(seconds * sample_rate);
+    const double freq = ModulationConst::RATE_MAX;  // fastest sweep, the ramps' worst case
+    WT_Osc<256> wt256(freq, sample_rate);
+    WT_Osc<1024> wt1024(freq, sample_rate);
+    WT_Osc<4096> wt4096(freq, sample_rate);
+    AnalyticOsc analytic(freq, sample_rate);
+
+    struct Row
+    {
+        const char* name;
+        int rate;
+        size_t tableBytes;
+        bool isDefault;
+        LfoResult result;
+    };
+#ifdef MYMODULATION_ANALYTIC_LFO
+    const bool analyticDefault = true;
+#else
+    const bool analyticDefault = false;
+#endif
+    std::vector<Row> rows;
+    for (int rate : {1, 16}) {
+        rows.push_back({"wavetable 256", rate, sizeof(WTables<256>), false, measureLfo(wt256, rate, samples)});
+        rows.push_back({"wavetable 1024", rate, sizeof(WTables<1024>), !analyticDefault,
+                        measureLfo(wt1024, rate, samples)});
+        rows.push_back({"wavetable 4096", rate, sizeof(WTables<4096>), false, measureLfo(wt4096, rate, samples)});
+        rows.push_back({"analytic", rate, 0, analyticDefault, measureLfo(analytic, rate, samples)});
+    }
+    std::vector<std::vector<double>> metrics;
+    for (const Row& r : rows)
+        metrics.push_back({rounded(r.result.cycles, 0.01), std::max(rounded(r.result.harmonicDb, 0.1), -120.0),
+                           std::max(r.result.sineMaxErr, 1e-6), std::max(r.result.triMaxErr, 1e-6),
+                           static_cast<double>(r.tableBytes)});
+    const std::vector<bool> front = paretoFront(metrics);
+
+    printf("\nLFO, %.0f Hz sine and triangle at %.0f kHz\n", freq, sample_rate * 1e-3);
+    printf("  %-15s %4s %10s %12s %10s %10s %8s  %s\n", "engine", "ctrl", "cyc/sample", "harmonic dB",
+           "sine err", "tri err", "table KB", "");
+    for (size_t i = 0; i < rows.size(); ++i) {
+        const Row& r = rows[i];
+        std::string label;
+        if (r.isDefault)
+            label = r.rate == 1 ? "default (STANDARD, HIGH, ULTRA)" : "default (ECO)";
+        printf("%c %-15s %4d %10.2f %12.1f %10.2g %10.2g %8.1f  %s\n", front[i] ? '*' : ' ', r.name, r.rate,
+               r.result.cycles, r.result.harmonicDb, r.result.sineMaxErr, r.result.triMaxErr,
+               r.tableBytes / 1024.0, label.c_str());
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const double seconds = argc > 1 ? std::atof(argv[1]) : 2.0;
+    if (!(seconds > 0.0)) {
+        fprintf(stderr, "usage: quality_bench [seconds]\n");
+        return 1;
+    }
+    delayTable(seconds);
+    lfoTable(seconds);
+    return 0;
+}
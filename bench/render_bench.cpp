@@ -0,0 +1,179 @@
+// render_bench - chunk-parallel offline rendering against the serial reference.
+//
+//   render_bench [input.wav | -] [threads]
+//
+// Renders the input (or, without one or with "-", 30 s of generated stereo
+// material: noise bursts, a sine sweep and silence, so seams land in every
+// kind of signal) with renderSerial() and renderParallel() for every effect
+// type and waveform at no, moderate and strong negative feedback. Chunks are
+// kept small and 4 threads are used unless told otherwise, so even on one
+// core a render has seams, each starting from a fresh Modulation. Stronger
+// feedback needs a pre-roll that leaves a file this long in one chunk.
+//
+// renderParallel() promises to stay within tailThreshold * peak(|input|) of
+// the serial render, and to be bit-identical without feedback. Reports the
+// largest difference against that bound and the speedup, and exits with 1
+// if any render breaks the promise, so it doubles as the check for it.
+
+#include "../include/offline_render.h"
+#include "../include/wavfile.h"
+#include "benchutil.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace Steinberg::MyModulation;
+
+namespace
+{
+
+constexpr double two_pi = 6.283185307179586477;
+constexpr size_t chunk_size = 1u << 16;
+
+struct Audio
+{
+    std::vector<std::vector<float>> channels;
+    double sampleRate = 48000.0;
+    size_t numSamples() const noexcept { return channels.empty() ? 0 : channels[0].size(); }
+};
+
+bool load(const char* path, Audio& audio)
+{
+    WavReader reader;
+    if (!reader.open(path))
+        return false;
+    audio.sampleRate = reader.sampleRate();
+    audio.channels.assign(static_cast<size_t>(reader.numChannels()),
+                          std::vector<float>(static_cast<size_t>(reader.numFrames())));
+    std::vector<float*> dst(audio.channels.size());
+    size_t done = 0;
+    for (;;) {
+        for (size_t ch = 0; ch < dst.size(); ++ch)
+            dst[ch] = audio.channels[ch].data() + done;
+        const size_t got = reader.read(dst.data(), audio.numSamples() - done);
+        if (got == 0)
+            break;
+        done += got;
+    }
+    return done == audio.numSamples();
+}
+
+// a second of each: noise burst, sine sweep, silence, repeated
+void generate(Audio& audio, double seconds)
+{
+    const size_t n = static_cast<size_t>(seconds * audio.sampleRate);
+    const size_t second = static_cast<size_t>(audio.sampleRate);
+    audio.channels.assign(2, std::vector<float>(n));
+    uint32_t seed = 1u;
+    double phase = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        const size_t t = i % (3 * second);
+        float l = 0.0f, r = 0.0f;
+        if (t < second) {
+            seed = seed * 1664525u + 1013904223u;
+            l = static_cast<float>(static_cast<int32_t>(seed) * (0.5 / 2147483648.0));
+            r = -0.5f * l;
+        } else if (t < 2 * second) {
+            const double hz = 50.0 * std::pow(300.0, static_cast<double>(t - second) / second);
+            phase += two_pi * hz / audio.sampleRate;
+            l = static_cast<float>(0.7 * std::sin(phase));
+            r = static_cast<float>(0.7 * std::cos(phase));
+        }
+        audio.channels[0][i] = l;
+        audio.channels[1][i] = r;
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Audio audio;
+    if (argc > 1 && strcmp(argv[1], "-") != 0) {
+        if (!load(argv[1], audio)) {
+            fprintf(stderr, "render_bench: can't read %s\n", argv[1]);
+            return 1;
+        }
+    } else {
+        generate(audio, 30.0);
+    }
+    const unsigned threads = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : 4;
+    const size_t n = audio.numSamples();
+    const int numChannels = static_cast<int>(audio.channels.size());
+    if (n == 0 || numChannels == 0 || threads == 0) {
+        fprintf(stderr, "usage: render_bench [input.wav | -] [threads]\n");
+        return 1;
+    }
+
+    float peak = 0.0f;
+    std::vector<const float*> in;
+    for (const std::vector<float>& ch : audio.channels) {
+        in.push_back(ch.data());
+        for (float v : ch)
+            peak = std::max(peak, std::fabs(v));
+    }
+    std::vector<std::vector<float>> serial(numChannels, std::vector<float>(n)), parallel = serial;
+    std::vector<float*> outSerial, outParallel;
+    for (int ch = 0; ch < numChannels; ++ch) {
+        outSerial.push_back(serial[ch].data());
+        outParallel.push_back(parallel[ch].data());
+    }
+
+    offline_render::RenderOptions options;
+    options.chunkSize = chunk_size;
+    options.numThreads = threads;
+    // in FxType and Waveform order, indexed by them
+    const char* effects[] = {"flanger", "chorus", "vibrato"};
+    const char* waveforms[] = {"sine", "saw", "triangle", "square"};
+    const double feedbacks[] = {0.0, 0.5, -0.8};
+
+    printf("%zu samples x %d channels, peak %.3f, %u threads\n", n, numChannels, peak, threads);
+    printf("%-8s %-9s %5s %7s %12s %12s %9s  %s\n", "effect", "waveform", "fb", "chunks", "max diff", "bound",
+           "speedup", "");
+    int failures = 0;
+    for (int fx = FLANGER; fx <= VIBRATO; ++fx) {
+        for (int wf = 0; wf < ModulationConst::NUM_WAVEFORMS; ++wf) {
+            for (double fb : feedbacks) {
+                ModulationParams p;
+                p.effectType = fx;
+                p.waveform = wf;
+                p.feedback = fb;
+                p.modRate = 1.3;
+                p.modDepth = 0.8;
+                p.chorusOffset = 12.0;
+                p.dryWet = 0.5;
+
+                // the chunk size renderParallel() settles on
+                Modulation probe(audio.sampleRate, p.modRate);
+                probe.setParams(p);
+                const size_t chunk = std::max(chunk_size,
+                                              4 * offline_render::prerollSamples(probe, audio.sampleRate,
+                                                                                 options.tailThreshold));
+
+                const uint64_t t0 = bench::cycles();
+                offline_render::renderSerial(in.data(), outSerial.data(), numChannels, n, audio.sampleRate, p);
+                const uint64_t t1 = bench::cycles();
+                offline_render::renderParallel(in.data(), outParallel.data(), numChannels, n, audio.sampleRate,
+                                               p, options);
+                const uint64_t t2 = bench::cycles();
+
+                double diff = 0.0;
+                for (int ch = 0; ch < numChannels; ++ch)
+                    for (size_t i = 0; i < n; ++i)
+                        diff = std::max(diff, std::fabs(static_cast<double>(serial[ch][i]) - parallel[ch][i]));
+                // without feedback nothing reaches across a seam past the pre-roll
+                const double bound = fb == 0.0 ? 0.0 : static_cast<double>(options.tailThreshold) * peak;
+                const bool ok = diff <= bound;
+                failures += ok ? 0 : 1;
+                printf("%-8s %-9s %5.2f %7zu %12.3g %12.3g %8.2fx  %s\n", effects[fx], waveforms[wf], fb,
+                       (n + chunk - 1) / chunk, diff, bound,
+                       static_cast<double>(t1 - t0) / std::max<uint64_t>(t2 - t1, 1), ok ? "" : "FAIL");
+            }
+        }
+    }
+    printf("%s, %d renders out of bounds\n", failures ? "FAIL" : "ok", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,261 @@
+// state_bench - session recall: a project's worth of instances loading their state.
+//
+//   state_bench [instances] [rounds]
+//
+// Creates `instances` (default 500) processor/controller pairs, each with its
+// own settings, snapshots and custom LFO shape, and saves every one in the
+// current format and in version 1, the unversioned layout of older sessions.
+// Then loads the whole session as a host does on opening a project:
+// PlugProcessor::setState and PlugController::setComponentState per
+// instance, for both formats, timing every call. The best of `rounds` passes
+// is shown per format and per side, with getState for comparison.
+//
+// Both formats must recall the same settings: a processor loaded from
+// version 1 saves exactly what one loaded from the current format saves, and
+// the controllers end up with the same parameters. Exits with 1 if not.
+
+#include "../include/plugprocessor.h"
+#include "../include/plugcontroller.h"
+#include "../include/plugids.h"
+#include "../include/plugstate.h"
+#include "benchutil.h"
+#include "base/source/fstreamer.h"
+#include "public.sdk/source/common/memorystream.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace Steinberg;
+using namespace Steinberg::MyModulation;
+
+namespace
+{
+
+const Vst::ParamID checkedIDs[] = {kParamDryWetID, kParamModulationRateID, kParamModulationDepthID,
+                                   kParamModWaveformID, kParamFeedbackID, kParamChorusOffsetID,
+                                   kParamEffectTypeID, kBypassID, kSnapshotMorphID, kQualityID,
+                                   kGovernorID, kStereoPhaseID, kCustomLfoID};
+constexpr int numChecked = sizeof(checkedIDs) / sizeof(checkedIDs[0]);
+
+uint32 lcg(uint32& seed) noexcept
+{
+    seed = seed * 1664525u + 1013904223u;
+    return seed >> 8;
+}
+
+double uniform(uint32& seed, double lo, double hi) noexcept
+{
+    return lo + (hi - lo) * (lcg(seed) / double(1 << 24));
+}
+
+// an instance's settings, everything in range and different per instance
+PlugState makeState(uint32 seed)
+{
+    using namespace ModulationConst;
+    PlugState s {};
+    s.dryWet = uniform(seed, DRY_WET_MIN, DRY_WET_MAX);
+    s.modRate = uniform(seed, RATE_MIN, RATE_MAX);
+    s.modDepth = uniform(seed, DEPTH_MIN, DEPTH_MAX);
+    s.feedback = uniform(seed, FEEDBACK_MIN, FEEDBACK_MAX);
+    s.chorusOffset = uniform(seed, CHRS_OFST_MIN, CHRS_OFST_MAX);
+    s.morph = uniform(seed, 0.0, 1.0);
+    s.stereoPhase = uniform(seed, STEREO_PHASE_MIN, STEREO_PHASE_MAX);
+    s.waveform = lcg(seed) % NUM_WAVEFORMS;
+    s.customLfo = lcg(seed) % 2;
+    if (s.customLfo)
+        s.waveform = 0;                                 // version 1 keeps only the custom shape then
+    s.effectType = lcg(seed) % NUM_FX_TYPES;
+    s.bypass = lcg(seed) % 2;
+    s.quality = lcg(seed) % (NUM_QUALITY_TIERS + 1);
+    s.governor = lcg(seed) % 2;
+    s.snapshotsStored = (1 << NUM_SNAPSHOTS) - 1;     // what version 1 infers from random slots
+    for (PlugStateSnapshot& p : s.snapshots) {
+        p.dryWet = uniform(seed, DRY_WET_MIN, DRY_WET_MAX);
+        p.modRate = uniform(seed, RATE_MIN, RATE_MAX);
+        p.modDepth = uniform(seed, DEPTH_MIN, DEPTH_MAX);
+        p.feedback = uniform(seed, FEEDBACK_MIN, FEEDBACK_MAX);
+        p.chorusOffset = uniform(seed, CHRS_OFST_MIN, CHRS_OFST_MAX);
+        p.waveform = lcg(seed) % NUM_LFO_SHAPES;
+        p.effectType = lcg(seed) % NUM_FX_TYPES;
+    }
+    // two harmonics, kept inside [-1, 1] so resampling leaves them alone
+    const double h = uniform(seed, 0.0, 0.5);
+    for (size_t i = 0; i < USER_LFO_SIZE; ++i) {
+        const double x = 6.283185307179586 * i / USER_LFO_SIZE;
+        s.userLfo[i] = static_cast<float>((1.0 - h) * std::sin(x) + h * std::sin(3.0 * x));
+    }
+    return s;
+}
+
+// what getState wrote before the state was versioned
+void writeV1(IBStream* stream, const PlugState& s)
+{
+    IBStreamer out(stream, kLittleEndian);
+    out.writeDouble(s.dryWet);
+    out.writeDouble(s.modRate);
+    out.writeDouble(s.modDepth);
+    out.writeInt8(static_cast<int8>(s.customLfo ? ModulationConst::NUM_WAVEFORMS : s.waveform));
+    out.writeDouble(s.feedback);
+    out.writeDouble(s.chorusOffset);
+    out.writeInt8(static_cast<int8>(s.effectType));
+    out.writeInt32(s.bypass);
+    out.writeDouble(s.morph);
+    out.writeInt32(ModulationConst::NUM_SNAPSHOTS);
+    for (const PlugStateSnapshot& p : s.snapshots) {
+        out.writeDouble(p.dryWet);
+        out.writeDouble(p.modRate);
+        out.writeDouble(p.modDepth);
+        out.writeDouble(p.feedback);
+        out.writeDouble(p.chorusOffset);
+        out.writeInt8(static_cast<int8>(p.waveform));
+        out.writeInt8(static_cast<int8>(p.effectType));
+    }
+    out.writeInt8(static_cast<int8>(s.quality));
+    out.writeInt8(static_cast<int8>(s.governor));
+    out.writeInt32(static_cast<int32>(USER_LFO_SIZE));
+    for (float v : s.userLfo)
+        out.writeFloat(v);
+    out.writeDouble(s.stereoPhase);
+}
+
+struct Instance
+{
+    PlugProcessor* processor;
+    PlugController* controller;
+};
+
+struct Times
+{
+    double processorUs = 0.0, controllerUs = 0.0;       // whole session
+    double worstUs = 0.0;                               // slowest instance, both sides
+};
+
+struct Recalled
+{
+    std::vector<char> saved;                            // the processor's getState afterwards
+    double params[numChecked];
+};
+
+// seeks to the start before every call, the host hands each side a fresh stream
+Times loadSession(std::vector<Instance>& instances, std::vector<MemoryStream>& streams, double usPerTick,
+                  bool& ok)
+{
+    Times t;
+    for (size_t i = 0; i < instances.size(); ++i) {
+        streams[i].seek(0, IBStream::kIBSeekSet, nullptr);
+        const uint64_t t0 = bench::cycles();
+        ok = instances[i].processor->setState(&streams[i]) == kResultOk && ok;
+        const uint64_t t1 = bench::cycles();
+        streams[i].seek(0, IBStream::kIBSeekSet, nullptr);
+        const uint64_t t2 = bench::cycles();
+        ok = instances[i].controller->setComponentState(&streams[i]) == kResultOk && ok;
+        const uint64_t t3 = bench::cycles();
+        t.processorUs += (t1 - t0) * usPerTick;
+        t.controllerUs += (t3 - t2) * usPerTick;
+        t.worstUs = std::max(t.worstUs, (t1 - t0 + t3 - t2) * usPerTick);
+    }
+    return t;
+}
+
+Recalled recall(Instance& instance)
+{
+    Recalled r;
+    MemoryStream out;
+    instance.processor->getState(&out);
+    r.saved.assign(out.getData(), out.getData() + out.getSize());
+    for (int p = 0; p < numChecked; ++p)
+        r.params[p] = instance.controller->getParamNormalized(checkedIDs[p]);
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const int numInstances = argc > 1 ? std::atoi(argv[1]) : 500;
+    const int rounds = argc > 2 ? std::atoi(argv[2]) : 5;
+    if (numInstances <= 0 || rounds <= 0) {
+        fprintf(stderr, "usage: state_bench [instances] [rounds]\n");
+        return 1;
+    }
+    const double usPerTick = 1e6 / cycleCounterFrequency();
+
+    std::vector<Instance> instances(static_cast<size_t>(numInstances));
+    std::vector<MemoryStream> current(instances.size()), legacy(instances.size());
+    for (size_t i = 0; i < instances.size(); ++i) {
+        instances[i].processor = static_cast<PlugProcessor*>(
+                    static_cast<Vst::IAudioProcessor*>(PlugProcessor::createInstance(nullptr)));
+        instances[i].controller = static_cast<PlugController*>(
+                    static_cast<Vst::IEditController*>(PlugController::createInstance(nullptr)));
+        instances[i].processor->initialize(nullptr);
+        instances[i].controller->initialize(nullptr);
+        const PlugState s = makeState(static_cast<uint32>(i) * 2654435761u + 1u);
+        plug_state::write(&current[i], s);
+        writeV1(&legacy[i], s);
+    }
+
+    // the current format is whatever plug_state::write() writes
+    char currentName[16];
+    snprintf(currentName, sizeof(currentName), "version %u", static_cast<unsigned>(plug_state::VERSION));
+    const char* names[] = {currentName, "version 1"};
+    std::vector<MemoryStream>* sessions[] = {&current, &legacy};
+    Times best[2];
+    std::vector<Recalled> recalled[2];
+    bool ok = true;
+    for (int f = 0; f < 2; ++f) {
+        best[f].processorUs = best[f].controllerUs = best[f].worstUs = 1e300;
+        for (int r = 0; r < rounds; ++r) {
+            const Times t = loadSession(instances, *sessions[f], usPerTick, ok);
+            if (t.processorUs + t.controllerUs < best[f].processorUs + best[f].controllerUs)
+                best[f] = t;
+        }
+        for (Instance& instance : instances)
+            recalled[f].push_back(recall(instance));
+    }
+
+    double saveUs = 1e300;
+    for (int r = 0; r < rounds; ++r) {
+        double total = 0.0;
+        for (Instance& instance : instances) {
+            MemoryStream out;
+            const uint64_t t0 = bench::cycles();
+            instance.processor->getState(&out);
+            total += (bench::cycles() - t0) * usPerTick;
+        }
+        saveUs = std::min(saveUs, total);
+    }
+
+    int mismatches = 0;
+    for (size_t i = 0; i < instances.size(); ++i) {
+        const Recalled& a = recalled[0][i];
+        const Recalled& b = recalled[1][i];
+        if (a.saved != b.saved || memcmp(a.params, b.params, sizeof(a.params)) != 0)
+            ++mismatches;
+    }
+
+    printf("%d instances, best of %d rounds\n", numInstances, rounds);
+    printf("%-10s %8s %12s %13s %13s %12s %10s\n", "format", "bytes", "session ms", "processor us",
+           "controller us", "per inst us", "worst us");
+    for (int f = 0; f < 2; ++f) {
+        const Times& t = best[f];
+        printf("%-10s %8lld %12.3f %13.3f %13.3f %12.3f %10.3f\n", names[f],
+               static_cast<long long>((*sessions[f])[0].getSize()), (t.processorUs + t.controllerUs) * 1e-3,
+               t.processorUs / numInstances, t.controllerUs / numInstances,
+               (t.processorUs + t.controllerUs) / numInstances, t.worstUs);
+    }
+    printf("getState   %8s %12.3f %13.3f\n", "", saveUs * 1e-3, saveUs / numInstances);
+    printf("%s, %d of %d instances recalled differently\n", ok && mismatches == 0 ? "ok" : "MISMATCH",
+           mismatches, numInstances);
+
+    for (Instance& instance : instances) {
+        instance.controller->terminate();
+        instance.controller->release();
+        instance.processor->terminate();
+        instance.processor->release();
+    }
+    return ok && mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,189 @@
+// wcet_bench - per-block latency of PlugProcessor::process under automation stress.
+//
+//   wcet_bench [channels] [seconds]
+//
+// Runs every scenario for `seconds` of audio and prints mean, p99, p99.9 and
+// worst block time, in microseconds and as a percentage of the block's real-time
+// budget. Scenarios: plain processing, every parameter automated with a point
+// on every sample, effect type / waveform flips every block, bypass toggling,
+// snapshot morph sweeps, feedback tails decaying into denormals, 1-sample
+// blocks and 64-bit processing. Runs through bench::MockHost, parameter
+// changes in the SDK's hosting ParameterChanges.
+
+#include "mockhost.h"
+#include "../include/cyclecounter.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace Steinberg;
+using namespace Steinberg::MyModulation;
+
+namespace
+{
+
+constexpr double sample_rate = 48000.0;
+constexpr int32 max_block = 4096;
+
+enum class Input {NOISE, DENORMAL_TAIL};
+
+struct Scenario
+{
+    const char* name;
+    int32 blockSize;
+    Input input;
+    bench::MockHost::Script automate;
+    int32 sampleSize;
+};
+
+void addPoint(Vst::ParameterChanges& changes, Vst::ParamID id, int32 offset, Vst::ParamValue value)
+{
+    int32 index = 0;
+    Vst::IParamValueQueue* queue = changes.addParameterData(id, index);
+    if (queue)
+        queue->addPoint(offset, value, index);
+}
+
+void noAutomation(Vst::ParameterChanges&, long long, int32) {}
+
+// one point per sample on every continuous parameter
+void automateAll(Vst::ParameterChanges& changes, long long block, int32 numSamples)
+{
+    static const Vst::ParamID ids[] = {kParamDryWetID, kParamModulationRateID, kParamModulationDepthID,
+                                       kParamFeedbackID, kParamChorusOffsetID};
+    for (int i = 0; i < 5; ++i)
+        for (int32 s = 0; s < numSamples; ++s)
+            addPoint(changes, ids[i], s, 0.5 + 0.5 * std::sin(0.001 * (block * numSamples + s) + i));
+}
+
+void flipTypes(Vst::ParameterChanges& changes, long long block, int32)
+{
+    addPoint(changes, kParamEffectTypeID, 0, (block % 3) / 2.0);
+    addPoint(changes, kParamModWaveformID, 0, (block % 4) / 3.0);
+}
+
+void toggleBypass(Vst::ParameterChanges& changes, long long block, int32)
+{
+    addPoint(changes, kBypassID, 0, block & 1 ? 1.0 : 0.0);
+}
+
+// sweeps the morph back and forth, so the smoothing path is running most of the time
+void sweepMorph(Vst::ParameterChanges& changes, long long block, int32)
+{
+    if (block < ModulationConst::NUM_SNAPSHOTS) {
+        // give the slots different settings, one per block: a queue keeps one value per offset
+        const int slot = static_cast<int>(block);
+        addPoint(changes, kParamModulationRateID, 0, slot / 3.0);
+        addPoint(changes, kParamEffectTypeID, 0, (slot % 3) / 2.0);
+        addPoint(changes, kSnapshotStoreID, 0, (slot + 1) / static_cast<double>(ModulationConst::NUM_SNAPSHOTS));
+        return;
+    }
+    addPoint(changes, kSnapshotMorphID, 0, (block % 64) < 32 ? (block % 32) / 31.0 : 1.0 - (block % 32) / 31.0);
+}
+
+void maxFeedback(Vst::ParameterChanges& changes, long long block, int32)
+{
+    if (block == 0) {
+        addPoint(changes, kParamEffectTypeID, 0, 0.0);
+        addPoint(changes, kParamFeedbackID, 0, 1.0);
+        addPoint(changes, kParamDryWetID, 0, 1.0);
+    }
+}
+
+struct Result
+{
+    double mean, p99, p999, worst;      // microseconds
+};
+
+Result run(const Scenario& sc, int32 numChannels, double seconds)
+{
+    bench::MockHost::Config config;
+    config.numChannels = numChannels;
+    config.maxBlockSize = max_block;
+    config.sampleRate = sample_rate;
+    config.sampleSize = sc.sampleSize;
+    bench::MockHost host(config);
+    host.setScript(sc.automate);
+
+    const long long numBlocks = static_cast<long long>(seconds * sample_rate) / sc.blockSize;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+    std::vector<uint64_t> ticks(static_cast<size_t>(numBlocks));
+    const long long tailPeriod = static_cast<long long>(2.0 * sample_rate);
+    long long sample = 0;
+
+    for (long long b = 0; b < numBlocks; ++b) {
+        for (int32 ch = 0; ch < numChannels; ++ch) {
+            for (int32 s = 0; s < sc.blockSize; ++s) {
+                float x;
+                if (sc.input == Input::NOISE)
+                    x = noise(rng);
+                else    // a tiny impulse every 2 s, the feedback tail spends most of the gap in denormals
+                    x = (sample + s) % tailPeriod == 0 ? 1e-30f : 0.0f;
+                if (sc.sampleSize == Vst::kSample64)
+                    host.input64(ch)[s] = x;
+                else
+                    host.input32(ch)[s] = x;
+            }
+        }
+        host.process(sc.blockSize);
+        ticks[static_cast<size_t>(b)] = host.lastProcessTicks();
+        sample += sc.blockSize;
+    }
+
+    const double usPerTick = 1e6 / cycleCounterFrequency();
+    std::sort(ticks.begin(), ticks.end());
+    double sum = 0.0;
+    for (uint64_t t : ticks)
+        sum += static_cast<double>(t);
+    auto percentile = [&](double p) {
+        const size_t i = std::min(ticks.size() - 1, static_cast<size_t>(p * static_cast<double>(ticks.size())));
+        return static_cast<double>(ticks[i]) * usPerTick;
+    };
+    Result r;
+    r.mean = sum / static_cast<double>(ticks.size()) * usPerTick;
+    r.p99 = percentile(0.99);
+    r.p999 = percentile(0.999);
+    r.worst = static_cast<double>(ticks.back()) * usPerTick;
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    const int32 numChannels = argc > 1 ? std::atoi(argv[1]) : 2;
+    const double seconds = argc > 2 ? std::atof(argv[2]) : 10.0;
+    if (numChannels <= 0 || numChannels > 32 || seconds <= 0.0) {
+        fprintf(stderr, "usage: wcet_bench [channels 1-32] [seconds]\n");
+        return 1;
+    }
+
+    const Scenario scenarios[] = {
+        {"plain",              512, Input::NOISE,          noAutomation,  Vst::kSample32},
+        {"plain",               64, Input::NOISE,          noAutomation,  Vst::kSample32},
+        {"plain 64-bit",        64, Input::NOISE,          noAutomation,  Vst::kSample64},
+        {"automate all",       512, Input::NOISE,          automateAll,   Vst::kSample32},
+        {"automate all",        64, Input::NOISE,          automateAll,   Vst::kSample32},
+        {"type flips",          64, Input::NOISE,          flipTypes,     Vst::kSample32},
+        {"bypass toggle",       64, Input::NOISE,          toggleBypass,  Vst::kSample32},
+        {"morph sweep",         64, Input::NOISE,          sweepMorph,    Vst::kSample32},
+        {"denormal tail",      512, Input::DENORMAL_TAIL,  maxFeedback,   Vst::kSample32},
+        {"1-sample blocks",      1, Input::NOISE,          noAutomation,  Vst::kSample32},
+        {"1-sample automate",    1, Input::NOISE,          automateAll,   Vst::kSample32},
+    };
+
+    printf("%d channels, %.1f s of audio per scenario, %.0f Hz\n", numChannels, seconds, sample_rate);
+    printf("%-18s %6s %9s %9s %9s %9s %9s %9s\n", "scenario", "block", "mean us", "p99 us", "p99.9 us",
+           "worst us", "p99.9 %", "worst %");
+    for (const Scenario& sc : scenarios) {
+        const Result r = run(sc, numChannels, seconds);
+        const double budgetUs = sc.blockSize / sample_rate * 1e6;
+        printf("%-18s %6d %9.2f %9.2f %9.2f %9.2f %9.1f %9.1f\n", sc.name, sc.blockSize, r.mean, r.p99, r.p999,
+               r.worst, 100.0 * r.p999 / budgetUs, 100.0 * r.worst / budgetUs);
+    }
+    return 0;
+}
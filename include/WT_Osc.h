@@ -1,15 +1,20 @@
+#ifndef WT_OSC_H
+#define WT_OSC_H
+
 #include <cmath>
 #include <array>
 #include <cstring>
+#include <cstdint>
 #include "constants.h"
+#include "fastmath.h"
 
 inline float linearInterp(float y1, float y2, float _readPoint)
 {
-    float scaledVal = _readPoint - std::floor(_readPoint);
+    float scaledVal = _readPoint - audio_tools::fastFloor(_readPoint);
     return (y1 *(1.0f - scaledVal) + (y2 * scaledVal));
 } 
 
-enum class Waveform {SINE, SAW, TRIANGLE, SQUARE};
+enum class Waveform {SINE, SAW, TRIANGLE, SQUARE, CUSTOM};
 
 union f_int32
 {
@@ -24,53 +29,151 @@ struct WTables
     std::array<float, SIZE> Saw;
     std::array<float, SIZE> Tri;
     std::array<float, SIZE> Sqr;
+
+    void fill() noexcept;
 };
 
+// naive (non band-limited) shapes
+template <size_t SIZE>
+void WTables<SIZE>::fill() noexcept
+{
+    constexpr float half = SIZE * 0.5f;
+    constexpr float quater = SIZE * 0.25f;
+    constexpr float threeQuaters = SIZE * 0.75f;
+    constexpr float size_recip = 1.0f / static_cast<float>(SIZE);
+    constexpr float ms = 1.0f / half;
+    constexpr float b1 = 0.0f;
+    constexpr float b2 = -1.0f;
+    constexpr float mt = 1.0f / quater;
+    constexpr float mtf = -2.0f / half;
+    constexpr float btf = 1.0f;
+
+    // Sine, the angles first and then one pass of the vector sine over them
+    for (size_t j = 0; j < SIZE; ++j)
+        Sin[j] = static_cast<float>(j) * size_recip * 2.0f * static_cast<float>(PI);
+    audio_tools::fastSin(Sin.data(), Sin.data(), static_cast<int>(SIZE));
+
+    for (size_t j = 0; j < SIZE; ++j){
+        // Saw
+        Saw[j] = j < half ? (ms*j + b1) : (ms*(j-(half-1)) + b2);
+        //Triangle
+        if (j < quater)
+            Tri[j] = mt*j + b1;
+        else if (j >= quater && j < threeQuaters)
+            Tri[j] = mtf*(j-quater) + btf;
+        else
+            Tri[j] = mt*(j-threeQuaters) + b2;
+        //Square
+        Sqr[j] = j < half ? 1.0f : -1.0f;
+    }
+}
+
 template <size_t SIZE=1024u>
 class WT_Osc
 {
-    WTables<SIZE>* wTables;
-    std::array<float, SIZE>* p_wTable;
     static constexpr size_t size_mask = SIZE - 1;
-    int32_t incr_i;
-    float incr_f, incr_f_accum[2];
-    size_t readIndex[2];
+    // phase is 32.32 fixed point: table index in the upper bits, fraction in the lower 32
+    static constexpr uint64_t phase_mask = (static_cast<uint64_t>(SIZE) << 32) - 1;
+    // per sample state first
+    const std::array<float, SIZE>* p_wTable;
+    uint64_t incr;
+    uint64_t phase[2];
+    uint64_t stereoOffset;      // channel 1 leads channel 0 by this much phase
     int32_t invert;
+    WTables<SIZE>* wTables;
+    const std::array<float, SIZE>* userTable;  // CUSTOM, not owned
+    bool ownsTables;
+    bool userSelected;
+    double sampleRate;
 
     void reset() noexcept;
     void makeUnipolar(float*) noexcept;
+    float read(uint64_t) const noexcept;
+    static WTables<SIZE>* sharedTables();
 public:
-    WT_Osc(double);
-    WT_Osc(double, const int32_t numHarmonics);   // numHarmonics = 5
+    WT_Osc(double, double);
+    WT_Osc(double, double, const int32_t numHarmonics);   // numHarmonics = 5
+    WT_Osc(const WT_Osc&) = delete;
+    WT_Osc& operator=(const WT_Osc&) = delete;
     ~WT_Osc();
     void changeWaveform(Waveform) noexcept;
     void changeWaveform(int) noexcept;
     void changeFreq(double) noexcept;
     void generate(float*, int) noexcept;
     void generateUnipolar(float*, int) noexcept;
+    void generateStereo(float*, float*) noexcept;
+    void generateStereoUnipolar(float*, float*) noexcept;
+    // the shape is in the table here, so these only match AnalyticOsc's interface
+    template <Waveform WF>
+    void generateUnipolar(float* buffer, int ch) noexcept { generateUnipolar(buffer, ch); }
+    template <Waveform WF>
+    void generateStereoUnipolar(float* out0, float* out1) noexcept { generateStereoUnipolar(out0, out1); }
     void invertPhase() { invert ^= 0x80000000; }
+    void setStereoPhase(double degrees) noexcept;
     void setQuadPhase() noexcept;
     void resetPhase() noexcept;
+    void seek(uint64_t) noexcept;
+    void skip(uint64_t, int) noexcept;
+    void skipStereo(uint64_t) noexcept;
+    double cyclePosition(int ch) const noexcept;
+    void setUserTable(const std::array<float, SIZE>*) noexcept;
 };
 
 template <size_t SIZE>
 inline void WT_Osc<SIZE>::reset() noexcept
 {
-    memset(readIndex, 0, 2*sizeof(size_t));
-    memset(incr_f_accum, 0, 2*sizeof(float));
+    memset(phase, 0, 2*sizeof(uint64_t));
+}
+
+// channel 1 follows channel 0 at a fixed phase offset, wrapping past 360
+template<size_t SIZE>
+inline void WT_Osc<SIZE>::setStereoPhase(double degrees) noexcept
+{
+    const double cycles = degrees / 360.0 - std::floor(degrees / 360.0);
+    stereoOffset = static_cast<uint64_t>(cycles * static_cast<double>(SIZE) * 4294967296.0) & phase_mask;
+    phase[1] = (phase[0] + stereoOffset) & phase_mask;
 }
 
 template<size_t SIZE>
 inline void WT_Osc<SIZE>::setQuadPhase() noexcept
 {
-    constexpr size_t quaterSize = static_cast<size_t>(static_cast<double>(SIZE)* 0.25);
-    readIndex[1] = (readIndex[0] + quaterSize) & size_mask;
+    setStereoPhase(90.0);
 }
 
 template<size_t SIZE>
 inline void WT_Osc<SIZE>::resetPhase() noexcept
 {
-    readIndex[1] = readIndex[0];
+    setStereoPhase(0.0);
+}
+
+// jump both channels to the phase they'd have after sampleIndex samples from reset,
+// exact since the accumulator is integer
+template<size_t SIZE>
+inline void WT_Osc<SIZE>::seek(uint64_t sampleIndex) noexcept
+{
+    phase[0] = (sampleIndex * incr) & phase_mask;
+    phase[1] = (phase[0] + stereoOffset) & phase_mask;
+}
+
+// 0..1 through the current cycle
+template<size_t SIZE>
+inline double WT_Osc<SIZE>::cyclePosition(int ch) const noexcept
+{
+    return static_cast<double>(phase[ch]) / (static_cast<double>(SIZE) * 4294967296.0);
+}
+
+// advance one channel by a number of samples without generating them
+template<size_t SIZE>
+inline void WT_Osc<SIZE>::skip(uint64_t samples, int ch) noexcept
+{
+    phase[ch] = (phase[ch] + samples * incr) & phase_mask;
+}
+
+template<size_t SIZE>
+inline void WT_Osc<SIZE>::skipStereo(uint64_t samples) noexcept
+{
+    phase[0] = (phase[0] + samples * incr) & phase_mask;
+    phase[1] = (phase[0] + stereoOffset) & phase_mask;
 }
 
 template <size_t SIZE>
@@ -80,45 +183,32 @@ inline void WT_Osc<SIZE>::makeUnipolar(float* buff) noexcept
    *buff += 0.5f;
 }
 
+// the naive tables are the same for every instance, so they're built once and shared
 template <size_t SIZE>
-WT_Osc<SIZE>::WT_Osc(double freq) : invert(0)
+WTables<SIZE>* WT_Osc<SIZE>::sharedTables()
 {
-    reset();
-    wTables = new WTables<SIZE>();
-
-    constexpr float half = SIZE * 0.5f;
-    constexpr float quater = SIZE * 0.25f;
-    constexpr float threeQuaters = SIZE * 0.75f;
-    constexpr float size_recip = 1.0f / static_cast<float>(SIZE);
-    constexpr float ms = 1.0f / half;
-    constexpr float b1 = 0.0f;
-    constexpr float b2 = -1.0f;
-    constexpr float mt = 1.0f / quater;
-    constexpr float mtf = -2.0f / half;
-    constexpr float btf = 1.0f;
+    struct Filled : WTables<SIZE>
+    {
+        Filled() { this->fill(); }
+    };
+    static Filled tables;
+    return &tables;
+}
 
-    for (size_t j = 0; j < SIZE; ++j){
-        // Sine
-        wTables->Sin[j] = sinf(static_cast<float>(j) * size_recip * 2.0f * static_cast<float>(PI));
-        // Saw
-        wTables->Saw[j] = j < half ? (ms*j + b1) : (ms*(j-(half-1)) + b2);
-        //Triangle
-        if (j < quater)
-            wTables->Tri[j] = mt*j + b1;
-        else if (j >= quater && j < threeQuaters)
-            wTables->Tri[j] = mtf*(j-quater) + btf;
-        else
-            wTables->Tri[j] = mt*(j-threeQuaters) + b2;
-        //Square
-        wTables->Sqr[j] = j < half ? 1.0f : -1.0f;
-    }
+template <size_t SIZE>
+WT_Osc<SIZE>::WT_Osc(double freq, double sr) : stereoOffset(0), invert(0), wTables(sharedTables()), ownsTables(false),
+                                                userSelected(false), sampleRate(sr)
+{
+    reset();
 
     p_wTable = &wTables->Sin;   // default
+    userTable = &wTables->Sin;
     changeFreq(freq);
 }
 
 template <size_t SIZE>
-WT_Osc<SIZE>::WT_Osc(double freq, int32_t numHarmonics) : invert(0)
+WT_Osc<SIZE>::WT_Osc(double freq, double sr, int32_t numHarmonics) : stereoOffset(0), invert(0), ownsTables(true),
+                                                                    userSelected(false), sampleRate(sr)
 {
     reset();
     wTables = new WTables<SIZE>();
@@ -128,30 +218,30 @@ WT_Osc<SIZE>::WT_Osc(double freq, int32_t numHarmonics) : invert(0)
     float maxTri = 0.0f;
     float maxSqr = 0.0f;
 
-    for (size_t j = 0; j < SIZE; ++j){
-        // Sine
-        wTables->Sin[j] = sinf(static_cast<float>(j) * size_recip * 2.0f * static_cast<float>(PI));
-
-       // wTables->Saw[j] = 0.0f;
-       // wTables->Tri[j] = 0.0f;
-       // wTables->Sqr[j] = 0.0f;
+    // Sine; sin(2 pi j n / SIZE) only depends on j n mod SIZE, so every harmonic
+    // below is a lookup into this one period
+    for (size_t j = 0; j < SIZE; ++j)
+        wTables->Sin[j] = static_cast<float>(j) * size_recip * 2.0f * static_cast<float>(PI);
+    audio_tools::fastSin(wTables->Sin.data(), wTables->Sin.data(), static_cast<int>(SIZE));
+    const std::array<float, SIZE>& sine = wTables->Sin;
 
-        // saw
+    for (size_t j = 0; j < SIZE; ++j){
+        // saw, alternating signs from +1
         for (int32_t g = 1; g <= (numHarmonics + 1); ++g){
-            float n = static_cast<float>(g);
-            wTables->Saw[j] += pow(-1.0, g+1)*(1.0f/n)*sinf(2.0f*PI*j*n/static_cast<float>(SIZE));
+            const float sign = (g & 1) ? 1.0f : -1.0f;
+            wTables->Saw[j] += sign * (1.0f / g) * sine[(j * g) & size_mask];
         }
         if (fabs(wTables->Saw[j]) > fabs(maxSaw)) maxSaw = wTables->Saw[j];
-        // triangle
+        // triangle, odd harmonics 2g + 1 at alternating sign and 1 / (2g + 1)^2
         for (int32_t g = 0; g < ((numHarmonics >> 1)+1); ++g){ // or should it be g <= ((numHarmonics / 2)+1);
-            float n = static_cast<float>(g);
-            wTables->Tri[j] += pow(-1.0f, n) * (1.0f / pow((2*n + 1), 2.0f)) * sinf(2.0f * PI * (2.0f*n + 1) * j / SIZE);
+            const float sign = (g & 1) ? -1.0f : 1.0f;
+            const int32_t n = 2*g + 1;
+            wTables->Tri[j] += sign * (1.0f / static_cast<float>(n * n)) * sine[(j * n) & size_mask];
         }
         if (fabs(wTables->Tri[j]) > fabs(maxTri)) maxTri = wTables->Tri[j];
         // square
         for (int32_t g = 1; g <= numHarmonics; g+=2){
-            float n = static_cast<float>(g);
-            wTables->Sqr[j] += (1.0f / n) * sinf(2.0f*PI*j*n/SIZE);
+            wTables->Sqr[j] += (1.0f / g) * sine[(j * g) & size_mask];
         }
         if (fabs(wTables->Sqr[j]) > fabs(maxSqr)) maxSqr = wTables->Sqr[j];
     }
@@ -166,18 +256,22 @@ WT_Osc<SIZE>::WT_Osc(double freq, int32_t numHarmonics) : invert(0)
     }
 
     p_wTable = &wTables->Sin;   // default
+    userTable = &wTables->Sin;
     changeFreq(freq);
 }
 
 template <size_t SIZE>
 inline WT_Osc<SIZE>::~WT_Osc(){
-    if (wTables) delete wTables;
+    if (ownsTables) delete wTables;
 }
 
 template <size_t SIZE>
 void WT_Osc<SIZE>::changeWaveform(Waveform wf) noexcept
 {
-    if (wf == Waveform::SINE)
+    userSelected = (wf == Waveform::CUSTOM);
+    if (wf == Waveform::CUSTOM)
+        p_wTable = userTable;
+    else if (wf == Waveform::SINE)
         p_wTable = &wTables->Sin;
     else if (wf == Waveform::SAW)
         p_wTable = &wTables->Saw;
@@ -190,6 +284,7 @@ void WT_Osc<SIZE>::changeWaveform(Waveform wf) noexcept
 template <size_t SIZE>
 void WT_Osc<SIZE>::changeWaveform(int wf) noexcept
 {
+    userSelected = (wf == static_cast<int>(Waveform::CUSTOM));
     switch(wf){
     case static_cast<int>(Waveform::SINE) :
         p_wTable = &wTables->Sin;
@@ -203,37 +298,62 @@ void WT_Osc<SIZE>::changeWaveform(int wf) noexcept
     case static_cast<int>(Waveform::SQUARE) :
         p_wTable = &wTables->Sqr;
         break;
+    case static_cast<int>(Waveform::CUSTOM) :
+        p_wTable = userTable;
+        break;
     default:
         p_wTable = &wTables->Sin;
     }
 }
 
+// the table has to outlive its use here, the owner swaps it between blocks
+template <size_t SIZE>
+inline void WT_Osc<SIZE>::setUserTable(const std::array<float, SIZE>* table) noexcept
+{
+    userTable = table ? table : &wTables->Sin;
+    if (userSelected)
+        p_wTable = userTable;
+}
+
 template <size_t SIZE>
 void WT_Osc<SIZE>::changeFreq(double freq) noexcept
 {
-    float incr = static_cast<float>(SIZE) * freq / static_cast<float>(audio_tools::SAMPLE_RATE);
-    incr_i = std::floor(incr);
-    incr_f = incr - incr_i;
+    incr = static_cast<uint64_t>(static_cast<double>(SIZE) * freq / sampleRate * 4294967296.0);
 }
 
 template <size_t SIZE>
-void WT_Osc<SIZE>::generate(float* buffer, int ch) noexcept
+inline float WT_Osc<SIZE>::read(uint64_t ph) const noexcept
 {
-    size_t readIndexNext = (readIndex[ch] +1) & size_mask;
+    constexpr float frac_scale = 1.0f / 16777216.0f;    // 2^-24
+    const size_t readIndex = static_cast<size_t>(ph >> 32);
+    const size_t readIndexNext = (readIndex + 1) & size_mask;
+    // top 24 bits of the fraction convert to float exactly, so it never rounds up to 1.0
+    const float fraction = static_cast<float>((ph >> 8) & 0xFFFFFF) * frac_scale;
 
     f_int32 fi32;
-    fi32.f = linearInterp(p_wTable->at(readIndex[ch]),
-                                p_wTable->at(readIndexNext),
-                                incr_f_accum[ch]);
+    // both indices are masked, no need for at()'s range check
+    fi32.f = linearInterp((*p_wTable)[readIndex],
+                          (*p_wTable)[readIndexNext],
+                          fraction);
     fi32.i32 ^= invert;
-    *buffer = fi32.f;
+    return fi32.f;
+}
 
-    // check this part (its to wrap without branching)
-    incr_f_accum[ch] += incr_f;
-    int32_t incr_i_accum = std::floor(incr_f_accum[ch]);
-    incr_f_accum[ch] -= static_cast<float>(incr_i_accum);
+template <size_t SIZE>
+void WT_Osc<SIZE>::generate(float* buffer, int ch) noexcept
+{
+    *buffer = read(phase[ch]);
+    phase[ch] = (phase[ch] + incr) & phase_mask;
+}
 
-    readIndex[ch] = (readIndex[ch] + incr_i + incr_i_accum) & size_mask;
+// both channels from one phase advance, channel 1 read stereoOffset ahead
+template <size_t SIZE>
+inline void WT_Osc<SIZE>::generateStereo(float* out0, float* out1) noexcept
+{
+    *out0 = read(phase[0]);
+    *out1 = read((phase[0] + stereoOffset) & phase_mask);
+    phase[0] = (phase[0] + incr) & phase_mask;
+    phase[1] = (phase[0] + stereoOffset) & phase_mask;
 }
 
 template<size_t SIZE>
@@ -242,3 +362,13 @@ inline void WT_Osc<SIZE>::generateUnipolar(float* buffer, int ch) noexcept
     generate(buffer, ch);
     makeUnipolar(buffer);
 }
+
+template<size_t SIZE>
+inline void WT_Osc<SIZE>::generateStereoUnipolar(float* out0, float* out1) noexcept
+{
+    generateStereo(out0, out1);
+    makeUnipolar(out0);
+    makeUnipolar(out1);
+}
+
+#endif // WT_OSC_H
@@ -0,0 +1,331 @@
+#ifndef ANALYTIC_OSC_H
+#define ANALYTIC_OSC_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include "WT_Osc.h"
+#include "user_lfo.h"
+
+// Table-free LFO with the same interface as WT_Osc. The phase is a 0.64 fixed
+// point fraction of a cycle, so seek() is exact like WT_Osc's. Sine comes from
+// a quadrature rotation recursion (renormalized every RENORM samples and
+// re-anchored to the phase whenever it jumps or the sine gets selected),
+// saw/triangle/square straight from the phase. Nothing is read apart from the
+// object itself, so many instances don't compete for L1 with 16 KB of tables
+// each.
+//
+// The shapes follow WTables: saw rises from 0, triangle and square start at
+// the zero crossing / high half of a sine. CUSTOM reads a user table, the one
+// place a table is involved.
+//
+// generateStereo() runs channel 1 off channel 0's phase and recursion; it
+// keeps phase[1] in step but not channel 1's own sine state, so going back to
+// per channel generate() takes a seek() or setStereoPhase() first.
+
+class AnalyticOsc
+{
+    static constexpr int RENORM = 64;
+    static constexpr double phase_scale = 1.0 / 18446744073709551616.0;  // 2^-64
+    static constexpr double two_pi = 6.283185307179586477;
+
+    uint64_t incr;
+    uint64_t phase[2];
+    double sinState[2], cosState[2];
+    double rotSin, rotCos;
+    double skipSin, skipCos;    // rotation for skipSamples steps, 0 = not computed
+    uint64_t skipSamples;
+    uint64_t stereoOffset;      // channel 1 leads channel 0 by this much phase
+    double offsetSin, offsetCos;
+    double sampleRate;
+    Waveform waveform;
+    const UserLfoTable* userTable;     // not owned
+    int renormCount[2];
+    int32_t invert;
+
+    void anchor(int ch) noexcept;
+    void followChannel0() noexcept;
+    float shape(uint64_t) const noexcept;
+    template <Waveform WF>
+    float shape(uint64_t) const noexcept;
+    void advance(int ch) noexcept;
+    template <Waveform WF>
+    void advance(int ch) noexcept;
+public:
+    AnalyticOsc(double freq, double sr);
+    void changeWaveform(Waveform) noexcept;
+    void changeWaveform(int) noexcept;
+    void changeFreq(double) noexcept;
+    void generate(float*, int) noexcept;
+    void generateUnipolar(float*, int) noexcept;
+    void generateStereo(float*, float*) noexcept;
+    void generateStereoUnipolar(float*, float*) noexcept;
+    // the same with the waveform fixed by the caller, who keeps it equal to
+    // the selected one
+    template <Waveform WF>
+    void generateUnipolar(float*, int) noexcept;
+    template <Waveform WF>
+    void generateStereoUnipolar(float*, float*) noexcept;
+    void invertPhase() { invert ^= 0x80000000; }
+    void setStereoPhase(double degrees) noexcept;
+    void setQuadPhase() noexcept;
+    void resetPhase() noexcept;
+    void seek(uint64_t) noexcept;
+    void skip(uint64_t, int) noexcept;
+    void skipStereo(uint64_t) noexcept;
+    double cyclePosition(int ch) const noexcept { return static_cast<double>(phase[ch]) * phase_scale; }
+    void setUserTable(const UserLfoTable*) noexcept;
+};
+
+inline AnalyticOsc::AnalyticOsc(double freq, double sr) : skipSamples(0), stereoOffset(0), offsetSin(0.0), offsetCos(1.0),
+                                                            sampleRate(sr), waveform(Waveform::SINE),
+                                                            userTable(&user_lfo::defaultTable()), invert(0)
+{
+    memset(phase, 0, sizeof(phase));
+    changeFreq(freq);
+    anchor(0);
+    anchor(1);
+}
+
+// exact sin/cos of the current phase, used whenever the recursion can't continue
+inline void AnalyticOsc::anchor(int ch) noexcept
+{
+    const double angle = static_cast<double>(phase[ch]) * phase_scale * two_pi;
+    sinState[ch] = std::sin(angle);
+    cosState[ch] = std::cos(angle);
+    renormCount[ch] = RENORM;
+}
+
+// the rotation only runs for the sine, so it has to pick up the phase again
+inline void AnalyticOsc::changeWaveform(Waveform wf) noexcept
+{
+    if (wf == Waveform::SINE && waveform != Waveform::SINE) {
+        anchor(0);
+        anchor(1);
+    }
+    waveform = wf;
+}
+
+inline void AnalyticOsc::changeWaveform(int wf) noexcept
+{
+    changeWaveform((wf >= static_cast<int>(Waveform::SINE) && wf <= static_cast<int>(Waveform::CUSTOM))
+                   ? static_cast<Waveform>(wf) : Waveform::SINE);
+}
+
+inline void AnalyticOsc::changeFreq(double freq) noexcept
+{
+    incr = static_cast<uint64_t>(freq / sampleRate * 18446744073709551616.0);
+    const double w = static_cast<double>(incr) * phase_scale * two_pi;
+    rotSin = std::sin(w);
+    rotCos = std::cos(w);
+    skipSamples = 0;
+}
+
+inline void AnalyticOsc::setUserTable(const UserLfoTable* table) noexcept
+{
+    userTable = table ? table : &user_lfo::defaultTable();
+}
+
+// put channel 1 stereoOffset ahead of channel 0, copying the state outright
+// when there's no offset so both channels stay bit identical
+inline void AnalyticOsc::followChannel0() noexcept
+{
+    phase[1] = phase[0] + stereoOffset;
+    if (stereoOffset == 0) {
+        sinState[1] = sinState[0];
+        cosState[1] = cosState[0];
+        renormCount[1] = renormCount[0];
+    }
+    else {
+        anchor(1);
+    }
+}
+
+// channel 1 follows channel 0 at a fixed phase offset, wrapping past 360
+inline void AnalyticOsc::setStereoPhase(double degrees) noexcept
+{
+    const double cycles = degrees / 360.0 - std::floor(degrees / 360.0);
+    stereoOffset = static_cast<uint64_t>(cycles * 18446744073709551616.0);
+    offsetSin = std::sin(cycles * two_pi);
+    offsetCos = std::cos(cycles * two_pi);
+    followChannel0();
+}
+
+inline void AnalyticOsc::setQuadPhase() noexcept
+{
+    setStereoPhase(90.0);
+}
+
+inline void AnalyticOsc::resetPhase() noexcept
+{
+    setStereoPhase(0.0);
+}
+
+inline void AnalyticOsc::seek(uint64_t sampleIndex) noexcept
+{
+    phase[0] = sampleIndex * incr;
+    anchor(0);
+    followChannel0();
+}
+
+// the sine takes one rotation by the whole stride, computed again only when
+// the stride or the frequency changes
+inline void AnalyticOsc::skip(uint64_t samples, int ch) noexcept
+{
+    if (samples == 0)
+        return;
+    phase[ch] += samples * incr;
+    if (waveform != Waveform::SINE)
+        return;
+    if (samples != skipSamples) {
+        const double w = static_cast<double>(samples * incr) * phase_scale * two_pi;
+        skipSin = std::sin(w);
+        skipCos = std::cos(w);
+        skipSamples = samples;
+    }
+    const double s = sinState[ch] * skipCos + cosState[ch] * skipSin;
+    const double c = cosState[ch] * skipCos - sinState[ch] * skipSin;
+    const double g = 1.5 - 0.5 * (s * s + c * c);
+    sinState[ch] = s * g;
+    cosState[ch] = c * g;
+}
+
+inline void AnalyticOsc::skipStereo(uint64_t samples) noexcept
+{
+    skip(samples, 0);
+    phase[1] = phase[0] + stereoOffset;
+}
+
+// everything but the sine, straight from the phase
+template <Waveform WF>
+inline float AnalyticOsc::shape(uint64_t ph) const noexcept
+{
+    constexpr float frac_scale = 1.0f / 16777216.0f;    // 2^-24
+    switch (WF) {
+    case Waveform::SAW:     // 2 * frac(p + 1/2) - 1
+        return static_cast<float>((ph + (static_cast<uint64_t>(1) << 63)) >> 40) * (2.0f * frac_scale) - 1.0f;
+    case Waveform::TRIANGLE:    // 1 - 4 * |frac(p + 1/4) - 1/2|
+        return 1.0f - 4.0f * std::fabs(static_cast<float>((ph + (static_cast<uint64_t>(1) << 62)) >> 40) * frac_scale - 0.5f);
+    case Waveform::SQUARE:
+        return (ph >> 63) ? -1.0f : 1.0f;
+    default: {  // CUSTOM, table index in the top 10 bits, 24 bits of fraction below
+        static_assert(USER_LFO_SIZE == 1024, "index width follows the table size");
+        const size_t i0 = static_cast<size_t>(ph >> 54);
+        const size_t i1 = (i0 + 1) & (USER_LFO_SIZE - 1);
+        const float fraction = static_cast<float>((ph >> 30) & 0xFFFFFF) * frac_scale;
+        return (*userTable)[i0] + ((*userTable)[i1] - (*userTable)[i0]) * fraction;
+    }
+    }
+}
+
+inline float AnalyticOsc::shape(uint64_t ph) const noexcept
+{
+    switch (waveform) {
+    case Waveform::SAW:         return shape<Waveform::SAW>(ph);
+    case Waveform::TRIANGLE:    return shape<Waveform::TRIANGLE>(ph);
+    case Waveform::SQUARE:      return shape<Waveform::SQUARE>(ph);
+    default:                    return shape<Waveform::CUSTOM>(ph);
+    }
+}
+
+template <Waveform WF>
+inline void AnalyticOsc::advance(int ch) noexcept
+{
+    phase[ch] += incr;
+    if (WF != Waveform::SINE)
+        return;
+    const double s = sinState[ch] * rotCos + cosState[ch] * rotSin;
+    const double c = cosState[ch] * rotCos - sinState[ch] * rotSin;
+    if (--renormCount[ch] == 0) {
+        // first order correction of |(c, s)| back to 1
+        const double g = 1.5 - 0.5 * (s * s + c * c);
+        sinState[ch] = s * g;
+        cosState[ch] = c * g;
+        renormCount[ch] = RENORM;
+    }
+    else {
+        sinState[ch] = s;
+        cosState[ch] = c;
+    }
+}
+
+// only the sine keeps a recursion, any other shape advances the same way
+inline void AnalyticOsc::advance(int ch) noexcept
+{
+    waveform == Waveform::SINE ? advance<Waveform::SINE>(ch) : advance<Waveform::SAW>(ch);
+}
+
+inline void AnalyticOsc::generate(float* buffer, int ch) noexcept
+{
+    f_int32 fi32;
+    fi32.f = (waveform == Waveform::SINE) ? static_cast<float>(sinState[ch]) : shape(phase[ch]);
+    fi32.i32 ^= invert;
+    *buffer = fi32.f;
+    advance(ch);
+}
+
+// both channels from one phase advance; the sine of channel 1 is channel 0's
+// state rotated by the offset rather than a second recursion
+inline void AnalyticOsc::generateStereo(float* out0, float* out1) noexcept
+{
+    f_int32 l, r;
+    if (waveform == Waveform::SINE) {
+        l.f = static_cast<float>(sinState[0]);
+        r.f = static_cast<float>(sinState[0] * offsetCos + cosState[0] * offsetSin);
+    }
+    else {
+        l.f = shape(phase[0]);
+        r.f = shape(phase[0] + stereoOffset);
+    }
+    l.i32 ^= invert;
+    r.i32 ^= invert;
+    *out0 = l.f;
+    *out1 = r.f;
+    advance(0);
+    phase[1] = phase[0] + stereoOffset;
+}
+
+inline void AnalyticOsc::generateUnipolar(float* buffer, int ch) noexcept
+{
+    generate(buffer, ch);
+    *buffer = *buffer * 0.5f + 0.5f;
+}
+
+inline void AnalyticOsc::generateStereoUnipolar(float* out0, float* out1) noexcept
+{
+    generateStereo(out0, out1);
+    *out0 = *out0 * 0.5f + 0.5f;
+    *out1 = *out1 * 0.5f + 0.5f;
+}
+
+template <Waveform WF>
+inline void AnalyticOsc::generateUnipolar(float* buffer, int ch) noexcept
+{
+    f_int32 fi32;
+    fi32.f = (WF == Waveform::SINE) ? static_cast<float>(sinState[ch]) : shape<WF>(phase[ch]);
+    fi32.i32 ^= invert;
+    *buffer = fi32.f * 0.5f + 0.5f;
+    advance<WF>(ch);
+}
+
+template <Waveform WF>
+inline void AnalyticOsc::generateStereoUnipolar(float* out0, float* out1) noexcept
+{
+    f_int32 l, r;
+    if (WF == Waveform::SINE) {
+        l.f = static_cast<float>(sinState[0]);
+        r.f = static_cast<float>(sinState[0] * offsetCos + cosState[0] * offsetSin);
+    }
+    else {
+        l.f = shape<WF>(phase[0]);
+        r.f = shape<WF>(phase[0] + stereoOffset);
+    }
+    l.i32 ^= invert;
+    r.i32 ^= invert;
+    *out0 = l.f * 0.5f + 0.5f;
+    *out1 = r.f * 0.5f + 0.5f;
+    advance<WF>(0);
+    phase[1] = phase[0] + stereoOffset;
+}
+
+#endif // ANALYTIC_OSC_H
@@ -0,0 +1,96 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Cache line aligned storage for per-instance DSP state.
+//
+// alignedAllocate() hands out 64-byte aligned blocks. With
+// MYMODULATION_SLAB_POOL they come from SlabPool, a process-wide pool of large
+// (huge page backed where the OS allows) slabs, so hundreds of instances end
+// up packed together instead of scattered over the heap; otherwise from the
+// system's aligned allocator.
+//
+// DspArena is one such block owned by an instance and carved up front with
+// allocate(); nothing in it is freed separately.
+
+void* alignedAllocate(size_t bytes);
+void alignedFree(void* p, size_t bytes) noexcept;
+
+class DspArena
+{
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    DspArena() noexcept = default;
+    explicit DspArena(size_t bytes);
+    DspArena(DspArena&& other) noexcept;
+    DspArena& operator=(DspArena&& other) noexcept;
+    DspArena(const DspArena&) = delete;
+    DspArena& operator=(const DspArena&) = delete;
+    ~DspArena();
+
+    // next count Ts, cache line aligned; nullptr once the arena is used up
+    template <typename T>
+    T* allocate(size_t count) noexcept
+    {
+        const size_t bytes = roundUp(count * sizeof(T));
+        if (m_used + bytes > m_capacity)
+            return nullptr;
+        T* p = reinterpret_cast<T*>(m_data + m_used);
+        m_used += bytes;
+        return p;
+    }
+
+    size_t capacity() const noexcept { return m_capacity; }
+    size_t used() const noexcept { return m_used; }
+
+    static size_t roundUp(size_t bytes) noexcept { return (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1); }
+private:
+    char* m_data = nullptr;
+    size_t m_capacity = 0;
+    size_t m_used = 0;
+};
+
+// Slabs are never given back to the OS; freed blocks go to a free list of
+// their power of two size class and are reused by the next instance.
+// Allocation takes a lock, it's meant for setup time, not the audio thread.
+class SlabPool
+{
+public:
+    static constexpr size_t SLAB_SIZE = static_cast<size_t>(32) << 20;
+    static constexpr size_t MIN_BLOCK = 64;
+
+    static SlabPool& instance();
+
+    void* allocate(size_t bytes);
+    void deallocate(void* p, size_t bytes) noexcept;
+
+    struct Stats
+    {
+        size_t slabBytes = 0;       // mapped for slabs and oversized blocks
+        size_t liveBytes = 0;       // handed out, rounded to size classes
+        bool hugePages = false;     // at least one mapping got huge pages
+    };
+    Stats stats() const;
+private:
+    static constexpr int NUM_CLASSES = 40;
+
+    SlabPool() = default;
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    static int sizeClass(size_t bytes) noexcept;
+    void* map(size_t bytes);
+
+    mutable std::mutex m_mutex;
+    std::vector<void*> m_free[NUM_CLASSES];
+    char* m_slab = nullptr;
+    size_t m_slabUsed = 0;
+    Stats m_stats;
+};
+
+#endif // ARENA_H
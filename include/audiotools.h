@@ -2,6 +2,7 @@
 #define AUDIOTOOLS_H
 #include <cmath>
 #include "constants.h"
+#include "fastmath.h"
 
 namespace audio_tools
 {
@@ -19,7 +20,7 @@ inline void scaleVolume(double* buf, double volume) noexcept
 
 inline void dbToVolume(double& volume) noexcept
 {
-    volume = pow(10.0, volume / 20.0);
+    volume = fastPow10(volume / 20.0);
 }
 
 //-------------------------------------------------------------
@@ -52,19 +53,21 @@ class ParamSmoothing {
                    double smoothingMS, T cval);
     T smoothParam(const T) noexcept;
     void setAmount(const T) noexcept;
+    void reset(const T value) noexcept { currentValue = value; }
+    T current() const noexcept { return currentValue; }
 };
 
 template <typename T>
 ParamSmoothing<T>::ParamSmoothing(double _sampleRate,
                  double smoothingMS, T cval) : sR(_sampleRate) {
-    a = exp(-TWO_PI / (smoothingMS * 0.001 * sR));
+    a = fastExp(-TWO_PI / (smoothingMS * 0.001 * sR));
     b = 1.0 - a;
     currentValue = cval;
 }
 
 template <typename T>
 void ParamSmoothing<T>::setAmount(const T smoothingMS) noexcept {
-    a = exp(-TWO_PI / (smoothingMS * 0.001 * sR));
+    a = fastExp(-TWO_PI / (smoothingMS * 0.001 * sR));
     b = 1.0 - a;
 }
 
@@ -76,6 +79,20 @@ inline T ParamSmoothing<T>::smoothParam(const T targetValue) noexcept {
 
 //--------------------------------------------------------
 
+// flush-to-zero and denormals-are-zero while in scope, the caller's mode is
+// restored after; feedback tails would otherwise decay through denormals at
+// many times the normal cost. Set per thread, workers need their own
+class DenormalGuard {
+    unsigned m_csr;
+    public:
+    DenormalGuard() noexcept : m_csr(_mm_getcsr()) { _mm_setcsr(m_csr | 0x8040); }
+    ~DenormalGuard() { _mm_setcsr(m_csr); }
+    DenormalGuard(const DenormalGuard&) = delete;
+    DenormalGuard& operator=(const DenormalGuard&) = delete;
+};
+
+//--------------------------------------------------------
+
 inline double clamp4tan(double val)
 {
     constexpr double maxVal = PI * 0.5 - 0.001;
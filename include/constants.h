@@ -11,10 +11,6 @@ static const double epsilon = std::numeric_limits<double>::epsilon();
 
 namespace audio_tools
 {
-static double SAMPLE_RATE = 44100.0;
-
-static double BUFFER_SIZE = 512.0;
-
 static constexpr double SMOOTHING = 0.4;
 }
 
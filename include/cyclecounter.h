@@ -0,0 +1,27 @@
+#ifndef CYCLECOUNTER_H
+#define CYCLECOUNTER_H
+
+#include <chrono>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// cheapest monotonic tick source: the TSC on x86, steady_clock nanoseconds elsewhere
+inline uint64_t readCycleCounter() noexcept
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+// ticks per second of readCycleCounter(), measured once per process (takes ~20 ms the first time)
+double cycleCounterFrequency() noexcept;
+
+#endif // CYCLECOUNTER_H
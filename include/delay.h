@@ -1,35 +1,66 @@
 #ifndef DELAY_H
 #define DELAY_H
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include "constants.h"
 #include <cstring>
 
+// The two delay lines live in storage handed over by the owner (see
+// Modulation's arena), storageFloats() says how much they need.
+//
+// Nothing clears the lines as a whole. mHistory counts how far behind the
+// write head a read may go and find either samples written since the last
+// flush or zeros; it grows by one with every sample written, and a read that
+// would reach past it first zeroes the gap (extendHistory). A flush only
+// sets it to 0, and the storage doesn't need clearing when it's handed over.
 class DelayFractional
 {
-    std:: unique_ptr<std::vector<float>> delayBuffer[2];
+public:
+    static constexpr int MAX_BLOCK = 64;    // longest processBlock() call
+    // processBlock() goes sample by sample when the feedback path closes
+    // within fewer samples than this
+    static constexpr int MIN_RUN = 4;
+private:
+    float* delayBuffer[2];
     typedef struct {float mWet, mDry, mFb;} DCoeffs;
     DCoeffs dCoeffs;
     size_t mReadIndex[2], mWriteIndex[2];
+    size_t mHistory[2];
     size_t delay_buff_size, delay_buff_mask;
     float delayFraction[2];
     float extFB;
-    static size_t ms2samples(double, float&) noexcept;
+    float samplesPerMs;
+    size_t ms2samples(double, float&) const noexcept;
     template<typename Width>
     static Width findNextPow2(Width v) noexcept;
     float linearInterp(float, float, float&);
+    float hermiteInterp(size_t, float, int) const noexcept;
     void updateIndices(int) noexcept;
+    void ensureHistory(size_t, int) noexcept;
+    void extendHistory(size_t, int) noexcept;
+    template <bool CUBIC>
     void calculateYn(float, float&, int) noexcept;
 public:
-    DelayFractional(double);
+    explicit DelayFractional(double);
+    static size_t storageFloats(double sr) noexcept;
+    void setStorage(float*) noexcept;
+    template <bool CUBIC = false, bool FEEDBACK = true, bool WET_ONLY = false>
     void updateDelay(float*, int) noexcept;
+    template <bool FEEDBACK = true, bool WET_ONLY = false>
+    void processBlock(const float*, float*, const float*, int, int) noexcept;
     void updateDelayCrossFB(float*, int) noexcept;
     void updateDelayExtFB(float*, int) noexcept;
     void setOffset(double, int) noexcept;
     void setDryWet(float) noexcept;
     void setFeedback(float) noexcept;
-    float& getDelayedSample(int ch) const noexcept;
+    float getFeedback() const noexcept;
+    float getDryWet() const noexcept;
+    float currentDelayMs(int) const noexcept;
+    double currentDelaySamples(int) const noexcept;
+    float& getDelayedSample(int ch) noexcept;
     void setExternalFB(float fb) noexcept;
     void flushDelayBuffers() noexcept;
 };
@@ -50,9 +81,34 @@ inline void DelayFractional::setFeedback(float fb) noexcept
     dCoeffs.mFb = fb;
 }
 
-inline size_t DelayFractional::ms2samples(double ms, float& dFraction) noexcept
+inline float DelayFractional::getFeedback() const noexcept
+{
+    return dCoeffs.mFb;
+}
+
+inline float DelayFractional::getDryWet() const noexcept
+{
+    return dCoeffs.mWet;
+}
+
+// the offset the read index was last set to; the write index has moved on by
+// one since, once a sample went through
+inline float DelayFractional::currentDelayMs(int ch) const noexcept
+{
+    const size_t distance = (mWriteIndex[ch] - mReadIndex[ch] - 1) & delay_buff_mask;
+    return (static_cast<float>(distance) + delayFraction[ch]) / samplesPerMs;
+}
+
+// the same in samples, exact, for measurements
+inline double DelayFractional::currentDelaySamples(int ch) const noexcept
 {
-    const float delaySamples = static_cast<float>(audio_tools::SAMPLE_RATE * ms) / 1000.0f;
+    const size_t distance = (mWriteIndex[ch] - mReadIndex[ch] - 1) & delay_buff_mask;
+    return static_cast<double>(distance) + static_cast<double>(delayFraction[ch]);
+}
+
+inline size_t DelayFractional::ms2samples(double ms, float& dFraction) const noexcept
+{
+    const float delaySamples = static_cast<float>(ms) * samplesPerMs;
     const size_t delayIntegral = static_cast<size_t>(delaySamples);
     dFraction = delaySamples - static_cast<float>(delayIntegral);
     return delayIntegral;
@@ -69,9 +125,10 @@ Width DelayFractional::findNextPow2(Width v) noexcept
     return v;
 }
 
-inline float& DelayFractional::getDelayedSample(int ch) const noexcept
+inline float& DelayFractional::getDelayedSample(int ch) noexcept
 {
-    return delayBuffer[ch]->at(mReadIndex[ch]);
+    ensureHistory((mWriteIndex[ch] - mReadIndex[ch]) & delay_buff_mask, ch);
+    return delayBuffer[ch][mReadIndex[ch]];
 }
 
 inline void DelayFractional::setExternalFB(float fb) noexcept
@@ -79,10 +136,18 @@ inline void DelayFractional::setExternalFB(float fb) noexcept
     extFB = fb;
 }
 
+// O(1), the old contents are zeroed as reads get to them
 inline void DelayFractional::flushDelayBuffers() noexcept
 {
-    memset(&delayBuffer[0], 0, sizeof (float) * delay_buff_size);
-    memset(&delayBuffer[1], 0, sizeof (float) * delay_buff_size);
+    memset(mHistory, 0, sizeof (size_t)*2);
+    memset(mWriteIndex, 0, sizeof (size_t)*2);
+}
+
+// make the last `distance` samples behind the write head safe to read
+inline void DelayFractional::ensureHistory(size_t distance, int ch) noexcept
+{
+    if (mHistory[ch] < distance)
+        extendHistory(distance, ch);
 }
 
 inline float DelayFractional::linearInterp(float y0, float y1, float& dFraction)
@@ -90,22 +155,139 @@ inline float DelayFractional::linearInterp(float y0, float y1, float& dFraction)
     return (y0 *(1.0f - dFraction) + (y1 * dFraction));
 }
 
+// read is the older of the two linear points, so the newer neighbour is read + 1
+inline float DelayFractional::hermiteInterp(size_t read, float frac, int ch) const noexcept
+{
+    const float* buf = delayBuffer[ch];
+    const float ym1 = buf[(read + 1) & delay_buff_mask];
+    const float y0 = buf[read];
+    const float y1 = buf[(read - 1) & delay_buff_mask];
+    const float y2 = buf[(read - 2) & delay_buff_mask];
+    const float c1 = 0.5f * (y1 - ym1);
+    const float c2 = ym1 - 2.5f * y0 + 2.0f * y1 - 0.5f * y2;
+    const float c3 = 0.5f * (y2 - ym1) + 1.5f * (y0 - y1);
+    return ((c3 * frac + c2) * frac + c1) * frac + y0;
+}
+
 inline void DelayFractional::updateIndices(int ch) noexcept
 {
 //    mReadIndex[ch] = (mReadIndex[ch] + 1) & delay_buff_mask;
     mWriteIndex[ch] = (mWriteIndex[ch] + 1) & delay_buff_mask;
+    if (mHistory[ch] < delay_buff_size)
+        ++mHistory[ch];
 }
 
+// linear, or 4-point Hermite with CUBIC
+template <bool CUBIC>
 inline void DelayFractional::calculateYn(float xn, float& yn, int ch) noexcept
 {
     if (mWriteIndex[ch] != mReadIndex[ch]) {
-        const size_t readIndex1 = (mReadIndex[ch] - 1) & delay_buff_mask;
-        yn = linearInterp(delayBuffer[ch]->at(mReadIndex[ch]), delayBuffer[ch]->at(readIndex1), delayFraction[ch]);
+        const size_t distance = (mWriteIndex[ch] - mReadIndex[ch]) & delay_buff_mask;
+        ensureHistory(distance + (CUBIC ? 2 : 1), ch);
+        // below 2 samples the newer Hermite point is the one about to be written
+        if (CUBIC && distance >= 2) {
+            yn = hermiteInterp(mReadIndex[ch], delayFraction[ch], ch);
+        }
+        else {
+            const size_t readIndex1 = (mReadIndex[ch] - 1) & delay_buff_mask;
+            yn = linearInterp(delayBuffer[ch][mReadIndex[ch]], delayBuffer[ch][readIndex1], delayFraction[ch]);
+        }
     }
     else {
         yn = xn;
     }
 }
+// FEEDBACK = false and WET_ONLY are for callers that know the feedback is 0
+// and the mix all wet, the coefficients aren't read then
+template <bool CUBIC, bool FEEDBACK, bool WET_ONLY>
+inline void DelayFractional::updateDelay(float* buffer, int ch) noexcept
+{
+    const float xn = *buffer;
+    float yn = 0.0f;
+    calculateYn<CUBIC>(xn, yn, ch);
+    delayBuffer[ch][mWriteIndex[ch]] = FEEDBACK ? xn + yn * dCoeffs.mFb : xn;
+    *buffer = WET_ONLY ? yn : dCoeffs.mDry * xn + dCoeffs.mWet * yn;
+
+    updateIndices(ch);
+}
+
+// setOffset() + updateDelay() for every sample of a block, offsets in ms,
+// with the same results. A sample's output only depends on what was written
+// at least its integral delay ago, so the block goes in runs no longer than
+// the shortest delay in it: all reads of a run first, then all its writes and
+// outputs, each an independent loop. Without feedback the input can be
+// written up front and the whole block is one run. A delay of 0 samples
+// passes the input, as in calculateYn(). in and out may be the same.
+template <bool FEEDBACK, bool WET_ONLY>
+void DelayFractional::processBlock(const float* in, float* out, const float* offsetMs, int n, int ch) noexcept
+{
+    float* const buf = delayBuffer[ch];
+    const size_t write = mWriteIndex[ch];
+    int32_t integral[MAX_BLOCK];
+    float fraction[MAX_BLOCK], yn[MAX_BLOCK];
+    int32_t minDelay = MAX_BLOCK, maxDelay = 0;
+    for (int i = 0; i < n; ++i) {
+        const float delaySamples = offsetMs[i] * samplesPerMs;
+        integral[i] = static_cast<int32_t>(delaySamples);
+        fraction[i] = delaySamples - static_cast<float>(integral[i]);
+    }
+    for (int i = 0; i < n; ++i) {
+        if (integral[i] > 0)
+            minDelay = std::min(minDelay, integral[i]);
+        maxDelay = std::max(maxDelay, integral[i]);
+    }
+
+    if (FEEDBACK && minDelay < MIN_RUN) {
+        for (int i = 0; i < n; ++i) {
+            float sample = in[i];
+            mReadIndex[ch] = (mWriteIndex[ch] - static_cast<size_t>(integral[i])) & delay_buff_mask;
+            delayFraction[ch] = fraction[i];
+            updateDelay<false, FEEDBACK, WET_ONLY>(&sample, ch);
+            out[i] = sample;
+        }
+        return;
+    }
+
+    // from the head as it is now, which is at least as far back as any read reaches
+    ensureHistory(static_cast<size_t>(maxDelay) + 1, ch);
+    // contiguous writes, split where the line wraps
+    auto writeRun = [&](int begin, int end) {
+        const size_t first = (write + static_cast<size_t>(begin)) & delay_buff_mask;
+        const int split = begin + static_cast<int>(std::min<size_t>(static_cast<size_t>(end - begin),
+                                                                    delay_buff_size - first));
+        for (int i = begin; i < split; ++i)
+            buf[first + static_cast<size_t>(i - begin)] = FEEDBACK ? in[i] + yn[i] * dCoeffs.mFb : in[i];
+        for (int i = split; i < end; ++i)
+            buf[i - split] = FEEDBACK ? in[i] + yn[i] * dCoeffs.mFb : in[i];
+    };
+    auto readRun = [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const size_t read = (write + static_cast<size_t>(i - integral[i])) & delay_buff_mask;
+            const float f = fraction[i];
+            const float y = buf[read] * (1.0f - f) + buf[(read - 1) & delay_buff_mask] * f;
+            yn[i] = integral[i] == 0 ? in[i] : y;
+        }
+    };
+    if (FEEDBACK) {
+        for (int begin = 0; begin < n; begin += minDelay) {
+            const int end = std::min(n, begin + minDelay);
+            readRun(begin, end);
+            writeRun(begin, end);
+        }
+    }
+    else {
+        writeRun(0, n);
+        readRun(0, n);
+    }
+    for (int i = 0; i < n; ++i)
+        out[i] = WET_ONLY ? yn[i] : dCoeffs.mDry * in[i] + dCoeffs.mWet * yn[i];
+
+    mWriteIndex[ch] = (write + static_cast<size_t>(n)) & delay_buff_mask;
+    mHistory[ch] = std::min(mHistory[ch] + static_cast<size_t>(n), delay_buff_size);
+    mReadIndex[ch] = (write + static_cast<size_t>(n - 1 - integral[n - 1])) & delay_buff_mask;
+    delayFraction[ch] = fraction[n - 1];
+}
+
 #endif // DELAY_H
 
 
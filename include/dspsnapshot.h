@@ -0,0 +1,52 @@
+#ifndef DSPSNAPSHOT_H
+#define DSPSNAPSHOT_H
+
+#include <atomic>
+#include <cstdint>
+
+// What a display needs of the running DSP, taken by the audio thread once per
+// block from the first channel pair. Plain data, it travels as a binary
+// message attribute.
+struct DspSnapshot
+{
+    float lfoPhase[2];      // fraction of a cycle, left and right
+    float delayMs[2];       // current delay at the read position
+    float inputPeak[2];     // linear, over the block
+    float outputPeak[2];
+    float feedback;
+    uint32_t block;         // blocks processed so far, 0 = nothing taken yet
+};
+
+// One writer and one reader that never wait for each other. The writer fills
+// back() and publish()es it; the reader calls update() and reads front(),
+// which stays the same until the next update() that finds something newer.
+// The third slot is the one in between, swapped atomically with a fresh bit.
+template <typename T>
+class TripleBuffer
+{
+    static constexpr int INDEX_MASK = 0x3;
+    static constexpr int FRESH = 0x4;
+
+    T m_slots[3] {};
+    std::atomic<int> m_middle {1};
+    int m_back = 0;     // writer only
+    int m_front = 2;    // reader only
+public:
+    T& back() noexcept { return m_slots[m_back]; }
+    void publish() noexcept
+    {
+        m_back = m_middle.exchange(m_back | FRESH, std::memory_order_acq_rel) & INDEX_MASK;
+    }
+
+    // true if front() changed
+    bool update() noexcept
+    {
+        if (!(m_middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX_MASK;
+        return true;
+    }
+    const T& front() const noexcept { return m_slots[m_front]; }
+};
+
+#endif // DSPSNAPSHOT_H
@@ -0,0 +1,359 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+#include <cstdint>
+#include <cstring>
+#include <emmintrin.h>
+
+// libm replacements with a fixed error bound, each as a scalar function, an
+// SSE2 __m128 overload doing four lanes with the same arithmetic, and a block
+// form over arrays. Range reduction is done the cheap way, so every function
+// states the input range its bound holds for; bench/fastmath_bench measures
+// the bounds against libm and fails if one is exceeded.
+//
+//   fastExp      float  |x| <= 87     rel err <= 2e-7
+//                double |x| <= 708    rel err <= 1e-15
+//   fastPow10    float  |x| <= 37     rel err <= 2e-7
+//                double |x| <= 307    rel err <= 1e-15
+//   fastSin      float  |x| <= 1e4    abs err <= 2e-7
+//   fastTanh     float  all x         abs err <= 2e-7
+//   fastFloor    float  |x| < 2^31    exact
+//   splitFraction, same as fastFloor, fraction in [0, 1)
+
+namespace audio_tools
+{
+
+namespace fastmath_detail
+{
+// exp: x = k ln2 + r, |r| <= ln2 / 2, ln2 in two parts so k ln2 is exact
+constexpr float LOG2E_F = 1.44269504088896341f;
+constexpr float LN2_HI_F = 0.693359375f;
+constexpr float LN2_LO_F = -2.12194440e-4f;
+constexpr float EXP_MAX_F = 88.0f;               // keeps 2^k normal
+constexpr float EXP_MIN_F = -87.3365447504019f;
+constexpr double LOG2E_D = 1.4426950408889634074;
+constexpr double LN2_HI_D = 6.93147180369123816490e-01;
+constexpr double LN2_LO_D = 1.90821492927058770002e-10;
+constexpr double EXP_MAX_D = 709.0;
+constexpr double EXP_MIN_D = -708.0;
+// pow10: x = k log10(2) + r, then 10^r = e^(r ln10) with |r ln10| <= ln2 / 2
+constexpr float LOG2_10_F = 3.32192809488736234787f;
+constexpr float LOG10_2_HI_F = 3.00781250e-1f;
+constexpr float LOG10_2_LO_F = 2.48745663981195213739e-4f;
+constexpr float LN10_F = 2.30258509299404568402f;
+constexpr double LOG2_10_D = 3.32192809488736234787;
+constexpr double LOG10_2_HI_D = 3.01029995663611771306e-01;
+constexpr double LOG10_2_LO_D = 3.69423907715893078616e-13;
+constexpr double LN10_D = 2.30258509299404568402;
+// sin: x = q pi + r, pi in three parts
+constexpr float INV_PI_F = 0.318309886183790671538f;
+constexpr float PI_A_F = 3.140625f;
+constexpr float PI_B_F = 9.67502593994140625e-4f;
+constexpr float PI_C_F = 1.509957990978376432e-7f;
+// tanh: below this the odd polynomial, above 1 - 2 / (e^2x + 1), past the clamp +-1
+constexpr float TANH_SMALL_F = 0.625f;
+constexpr float TANH_CLAMP_F = 9.0f;
+
+// 2^k for an integer valued float/double k inside the normal range
+inline float exp2Int(float k) noexcept
+{
+    const int32_t bits = (static_cast<int32_t>(k) + 127) << 23;
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+inline double exp2Int(double k) noexcept
+{
+    const int64_t bits = (static_cast<int64_t>(k) + 1023) << 52;
+    double d;
+    memcpy(&d, &bits, sizeof(d));
+    return d;
+}
+
+inline float expPoly(float r) noexcept
+{
+    float y = 1.9875691500e-4f;
+    y = y * r + 1.3981999507e-3f;
+    y = y * r + 8.3334519073e-3f;
+    y = y * r + 4.1665795894e-2f;
+    y = y * r + 1.6666665459e-1f;
+    y = y * r + 5.0000001201e-1f;
+    return y * (r * r) + r + 1.0f;
+}
+
+inline __m128 expPoly(__m128 r) noexcept
+{
+    __m128 y = _mm_set1_ps(1.9875691500e-4f);
+    y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(1.3981999507e-3f));
+    y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(8.3334519073e-3f));
+    y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(4.1665795894e-2f));
+    y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(1.6666665459e-1f));
+    y = _mm_add_ps(_mm_mul_ps(y, r), _mm_set1_ps(5.0000001201e-1f));
+    return _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, _mm_mul_ps(r, r)), r), _mm_set1_ps(1.0f));
+}
+
+// Taylor to r^12 over |r| <= ln2 / 2
+inline double expPoly(double r) noexcept
+{
+    double y = 1.0 / 479001600.0;
+    y = y * r + 1.0 / 39916800.0;
+    y = y * r + 1.0 / 3628800.0;
+    y = y * r + 1.0 / 362880.0;
+    y = y * r + 1.0 / 40320.0;
+    y = y * r + 1.0 / 5040.0;
+    y = y * r + 1.0 / 720.0;
+    y = y * r + 1.0 / 120.0;
+    y = y * r + 1.0 / 24.0;
+    y = y * r + 1.0 / 6.0;
+    y = y * r + 0.5;
+    y = y * r + 1.0;
+    return y * r + 1.0;
+}
+
+inline double roundToInt(double x) noexcept
+{
+    return static_cast<double>(static_cast<int64_t>(x + (x < 0.0 ? -0.5 : 0.5)));
+}
+
+// Taylor to r^11 over |r| <= pi / 2
+inline float sinPoly(float r) noexcept
+{
+    const float r2 = r * r;
+    float y = -2.5052108385e-8f;
+    y = y * r2 + 2.7557319224e-6f;
+    y = y * r2 - 1.9841269841e-4f;
+    y = y * r2 + 8.3333333333e-3f;
+    y = y * r2 - 1.6666666667e-1f;
+    return y * r2 * r + r;
+}
+
+inline __m128 sinPoly(__m128 r) noexcept
+{
+    const __m128 r2 = _mm_mul_ps(r, r);
+    __m128 y = _mm_set1_ps(-2.5052108385e-8f);
+    y = _mm_add_ps(_mm_mul_ps(y, r2), _mm_set1_ps(2.7557319224e-6f));
+    y = _mm_sub_ps(_mm_mul_ps(y, r2), _mm_set1_ps(1.9841269841e-4f));
+    y = _mm_add_ps(_mm_mul_ps(y, r2), _mm_set1_ps(8.3333333333e-3f));
+    y = _mm_sub_ps(_mm_mul_ps(y, r2), _mm_set1_ps(1.6666666667e-1f));
+    return _mm_add_ps(_mm_mul_ps(_mm_mul_ps(y, r2), r), r);
+}
+
+// tanh over |x| < TANH_SMALL_F, where 1 - 2 / (e^2x + 1) cancels
+inline float tanhPoly(float x) noexcept
+{
+    const float z = x * x;
+    float y = -5.70498872745e-3f;
+    y = y * z + 2.06390887954e-2f;
+    y = y * z - 5.37397155531e-2f;
+    y = y * z + 1.33314422036e-1f;
+    y = y * z - 3.33332819422e-1f;
+    return y * z * x + x;
+}
+
+inline __m128 tanhPoly(__m128 x) noexcept
+{
+    const __m128 z = _mm_mul_ps(x, x);
+    __m128 y = _mm_set1_ps(-5.70498872745e-3f);
+    y = _mm_add_ps(_mm_mul_ps(y, z), _mm_set1_ps(2.06390887954e-2f));
+    y = _mm_sub_ps(_mm_mul_ps(y, z), _mm_set1_ps(5.37397155531e-2f));
+    y = _mm_add_ps(_mm_mul_ps(y, z), _mm_set1_ps(1.33314422036e-1f));
+    y = _mm_sub_ps(_mm_mul_ps(y, z), _mm_set1_ps(3.33332819422e-1f));
+    return _mm_add_ps(_mm_mul_ps(_mm_mul_ps(y, z), x), x);
+}
+
+inline __m128 select(__m128 mask, __m128 a, __m128 b) noexcept
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// the block forms, four lanes at a time and the tail through the scalar version
+template <typename Vec, typename Scalar>
+inline void applyBlock(const float* in, float* out, int n, Vec vec, Scalar scalar) noexcept
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(out + i, vec(_mm_loadu_ps(in + i)));
+    for (; i < n; ++i)
+        out[i] = scalar(in[i]);
+}
+} // namespace fastmath_detail
+
+//----------------------------------------------------------
+
+// largest integer not above x; truncation, one lower for negative non-integers
+inline float fastFloor(float x) noexcept
+{
+    const float t = static_cast<float>(static_cast<int32_t>(x));
+    return t > x ? t - 1.0f : t;
+}
+
+inline __m128 fastFloor(__m128 x) noexcept
+{
+    const __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+}
+
+// x = integral + fraction, fraction in [0, 1)
+inline float splitFraction(float x, int32_t& integral) noexcept
+{
+    const float f = fastFloor(x);
+    integral = static_cast<int32_t>(f);
+    return x - f;
+}
+
+inline __m128 splitFraction(__m128 x, __m128i& integral) noexcept
+{
+    const __m128 f = fastFloor(x);
+    integral = _mm_cvttps_epi32(f);
+    return _mm_sub_ps(x, f);
+}
+
+//----------------------------------------------------------
+
+inline float fastExp(float x) noexcept
+{
+    using namespace fastmath_detail;
+    x = x > EXP_MAX_F ? EXP_MAX_F : (x < EXP_MIN_F ? EXP_MIN_F : x);
+    const float k = fastFloor(x * LOG2E_F + 0.5f);
+    const float r = x - k * LN2_HI_F - k * LN2_LO_F;
+    return expPoly(r) * exp2Int(k);
+}
+
+inline __m128 fastExp(__m128 x) noexcept
+{
+    using namespace fastmath_detail;
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(EXP_MIN_F)), _mm_set1_ps(EXP_MAX_F));
+    const __m128 k = fastFloor(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(LOG2E_F)), _mm_set1_ps(0.5f)));
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(LN2_HI_F)));
+    r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(LN2_LO_F)));
+    const __m128i bits = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(k), _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(expPoly(r), _mm_castsi128_ps(bits));
+}
+
+// for the setup paths that want double precision
+inline double fastExp(double x) noexcept
+{
+    using namespace fastmath_detail;
+    x = x > EXP_MAX_D ? EXP_MAX_D : (x < EXP_MIN_D ? EXP_MIN_D : x);
+    const double k = roundToInt(x * LOG2E_D);
+    const double r = (x - k * LN2_HI_D) - k * LN2_LO_D;
+    return expPoly(r) * exp2Int(k);
+}
+
+inline float fastPow10(float x) noexcept
+{
+    using namespace fastmath_detail;
+    constexpr float limit = EXP_MAX_F / LN10_F;
+    x = x > limit ? limit : (x < -limit ? -limit : x);
+    const float k = fastFloor(x * LOG2_10_F + 0.5f);
+    const float r = (x - k * LOG10_2_HI_F) - k * LOG10_2_LO_F;
+    return expPoly(r * LN10_F) * exp2Int(k);
+}
+
+inline __m128 fastPow10(__m128 x) noexcept
+{
+    using namespace fastmath_detail;
+    constexpr float limit = EXP_MAX_F / LN10_F;
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-limit)), _mm_set1_ps(limit));
+    const __m128 k = fastFloor(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(LOG2_10_F)), _mm_set1_ps(0.5f)));
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(k, _mm_set1_ps(LOG10_2_HI_F)));
+    r = _mm_sub_ps(r, _mm_mul_ps(k, _mm_set1_ps(LOG10_2_LO_F)));
+    const __m128i bits = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(k), _mm_set1_epi32(127)), 23);
+    return _mm_mul_ps(expPoly(_mm_mul_ps(r, _mm_set1_ps(LN10_F))), _mm_castsi128_ps(bits));
+}
+
+inline double fastPow10(double x) noexcept
+{
+    using namespace fastmath_detail;
+    constexpr double limit = EXP_MAX_D / LN10_D;
+    x = x > limit ? limit : (x < -limit ? -limit : x);
+    const double k = roundToInt(x * LOG2_10_D);
+    const double r = (x - k * LOG10_2_HI_D) - k * LOG10_2_LO_D;
+    return expPoly(r * LN10_D) * exp2Int(k);
+}
+
+//----------------------------------------------------------
+
+inline float fastSin(float x) noexcept
+{
+    using namespace fastmath_detail;
+    const float q = fastFloor(x * INV_PI_F + 0.5f);
+    const float r = ((x - q * PI_A_F) - q * PI_B_F) - q * PI_C_F;
+    const float s = sinPoly(r);
+    return (static_cast<int32_t>(q) & 1) ? -s : s;
+}
+
+inline __m128 fastSin(__m128 x) noexcept
+{
+    using namespace fastmath_detail;
+    const __m128 q = fastFloor(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(INV_PI_F)), _mm_set1_ps(0.5f)));
+    __m128 r = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(PI_A_F)));
+    r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(PI_B_F)));
+    r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(PI_C_F)));
+    // odd q flips the sign bit
+    const __m128i sign = _mm_slli_epi32(_mm_cvttps_epi32(q), 31);
+    return _mm_xor_ps(sinPoly(r), _mm_castsi128_ps(sign));
+}
+
+//----------------------------------------------------------
+
+inline float fastTanh(float x) noexcept
+{
+    using namespace fastmath_detail;
+    const float a = x < 0.0f ? -x : x;
+    if (a < TANH_SMALL_F)
+        return tanhPoly(x);
+    const float t = a > TANH_CLAMP_F ? 1.0f : 1.0f - 2.0f / (fastExp(2.0f * a) + 1.0f);
+    return x < 0.0f ? -t : t;
+}
+
+inline __m128 fastTanh(__m128 x) noexcept
+{
+    using namespace fastmath_detail;
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 sign = _mm_and_ps(x, signMask);
+    const __m128 a = _mm_min_ps(_mm_andnot_ps(signMask, x), _mm_set1_ps(TANH_CLAMP_F));
+    const __m128 e = fastExp(_mm_add_ps(a, a));
+    const __m128 large = _mm_sub_ps(_mm_set1_ps(1.0f),
+                                    _mm_div_ps(_mm_set1_ps(2.0f), _mm_add_ps(e, _mm_set1_ps(1.0f))));
+    const __m128 small = tanhPoly(x);
+    return select(_mm_cmplt_ps(a, _mm_set1_ps(TANH_SMALL_F)), small, _mm_or_ps(large, sign));
+}
+
+//----------------------------------------------------------
+// block forms, in and out may be the same array
+
+inline void fastExp(const float* in, float* out, int n) noexcept
+{
+    fastmath_detail::applyBlock(in, out, n, [](__m128 v) { return fastExp(v); },
+                                [](float v) { return fastExp(v); });
+}
+
+inline void fastPow10(const float* in, float* out, int n) noexcept
+{
+    fastmath_detail::applyBlock(in, out, n, [](__m128 v) { return fastPow10(v); },
+                                [](float v) { return fastPow10(v); });
+}
+
+inline void fastSin(const float* in, float* out, int n) noexcept
+{
+    fastmath_detail::applyBlock(in, out, n, [](__m128 v) { return fastSin(v); },
+                                [](float v) { return fastSin(v); });
+}
+
+inline void fastTanh(const float* in, float* out, int n) noexcept
+{
+    fastmath_detail::applyBlock(in, out, n, [](__m128 v) { return fastTanh(v); },
+                                [](float v) { return fastTanh(v); });
+}
+
+inline void fastFloor(const float* in, float* out, int n) noexcept
+{
+    fastmath_detail::applyBlock(in, out, n, [](__m128 v) { return fastFloor(v); },
+                                [](float v) { return fastFloor(v); });
+}
+
+} // audio_tools
+
+#endif // FASTMATH_H
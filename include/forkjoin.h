@@ -0,0 +1,58 @@
+#ifndef FORKJOIN_H
+#define FORKJOIN_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fork-join pool for the audio thread. Workers are spawned up front and left
+// to the scheduler unless pinning is asked for; run() publishes a job, works
+// on it together with the workers and returns once every task is done.
+// Nothing is allocated or locked per run: tasks are claimed with a CAS on one
+// word holding the run's generation, task count and next task, workers spin
+// for a while after a run and then park on the generation counter (futex /
+// WaitOnAddress), and the caller only issues a wake-up when some worker is
+// actually parked.
+
+class ForkJoinPool
+{
+public:
+    using Job = void(*)(void* context, int task);
+    static constexpr int MAX_TASKS = 0xFFFF;
+
+    ForkJoinPool(unsigned numWorkers, bool pinThreads);
+    ForkJoinPool(const ForkJoinPool&) = delete;
+    ForkJoinPool& operator=(const ForkJoinPool&) = delete;
+    ~ForkJoinPool();
+
+    unsigned numWorkers() const noexcept { return static_cast<unsigned>(m_threads.size()); }
+    // runs job(context, 0 .. numTasks-1) on the workers and the calling thread
+    void run(Job job, void* context, int numTasks) noexcept;
+
+private:
+    static constexpr int SPIN_COUNT = 4096;
+
+    void workerLoop(unsigned index) noexcept;
+    void work(uint32_t generation) noexcept;
+    void park(uint32_t seen) noexcept;
+    void wakeAll() noexcept;
+
+    // generation << 32 | numTasks << 16 | next task
+    std::atomic<uint64_t> m_work {0};
+    std::atomic<uint32_t> m_generation {0};
+    std::atomic<int> m_pending {0};
+    std::atomic<int> m_parked {0};
+    std::atomic<bool> m_stop {false};
+    Job m_job = nullptr;
+    void* m_context = nullptr;
+    std::vector<std::thread> m_threads;
+#if !defined(__linux__) && !defined(_WIN32)
+    std::mutex m_parkMutex;
+    std::condition_variable m_parkCv;
+#endif
+};
+
+#endif // FORKJOIN_H
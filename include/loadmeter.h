@@ -0,0 +1,72 @@
+#ifndef LOADMETER_H
+#define LOADMETER_H
+
+#include "cyclecounter.h"
+#include <atomic>
+#include <cstdint>
+
+// Per-block DSP load as a percentage of the real-time budget. The audio thread
+// brackets each block with begin()/end(); end() drops the load into a
+// histogram of BIN_PERCENT wide bins. The audio thread is the only writer and
+// never does a read-modify-write, so the counters are plain relaxed atomics
+// and any thread may peek at them with snapshot(). collect() also restarts
+// the window and is meant for the audio thread, which publishes the numbers
+// itself every so often.
+
+class LoadMeter
+{
+public:
+    static constexpr int NUM_BINS = 128;
+    static constexpr float BIN_PERCENT = 2.0f;    // last bin collects everything above 254%
+
+    struct Stats
+    {
+        float mean = 0.0f;      // percent of the budget
+        float p99 = 0.0f;
+        float max = 0.0f;
+        uint32_t blocks = 0;
+    };
+
+    LoadMeter() noexcept;
+    // budget of a full block is maxSamplesPerBlock / sampleRate, shorter blocks get their share of it
+    void prepare(double sampleRate, int32_t maxSamplesPerBlock) noexcept;
+
+    void begin() noexcept { m_start = readCycleCounter(); }
+    void end(int32_t numSamples) noexcept;
+
+    Stats snapshot() const noexcept;
+    Stats collect() noexcept;
+
+    double blockBudgetSeconds() const noexcept { return m_blockBudget; }
+private:
+    std::atomic<uint32_t> m_bins[NUM_BINS];
+    std::atomic<uint32_t> m_blocks;
+    std::atomic<float> m_sum;
+    std::atomic<float> m_max;
+    uint64_t m_start = 0;
+    float m_percentPerTick = 0.0f;      // for a one sample block
+    double m_blockBudget = 0.0;
+
+    template <typename T>
+    static void bump(std::atomic<T>& value, T by) noexcept
+    {
+        value.store(value.load(std::memory_order_relaxed) + by, std::memory_order_relaxed);
+    }
+};
+
+inline void LoadMeter::end(int32_t numSamples) noexcept
+{
+    if (numSamples <= 0)
+        return;
+    const uint64_t elapsed = readCycleCounter() - m_start;
+    const float load = static_cast<float>(elapsed) * m_percentPerTick / static_cast<float>(numSamples);
+    int bin = static_cast<int>(load * (1.0f / BIN_PERCENT));
+    bin = bin < NUM_BINS ? bin : NUM_BINS - 1;
+    bump(m_bins[bin], 1u);
+    bump(m_blocks, 1u);
+    bump(m_sum, load);
+    if (load > m_max.load(std::memory_order_relaxed))
+        m_max.store(load, std::memory_order_relaxed);
+}
+
+#endif // LOADMETER_H
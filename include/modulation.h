@@ -1,50 +1,195 @@
 #ifndef MODULATION_H
 #define MODULATION_H
 
+#include <algorithm>
 #include "delay.h"
 #include "WT_Osc.h"
+#include "arena.h"
+#include "halfband.h"
+#include "quality.h"
+#include "user_lfo.h"
+#include "modulationconst.h"
+
+// LFO engine, picked at build time (MYMODULATION_ANALYTIC_LFO in CMake)
+#ifdef MYMODULATION_ANALYTIC_LFO
+#include "analytic_osc.h"
+typedef AnalyticOsc ModLfo;
+#else
+typedef WT_Osc<1024> ModLfo;
+#endif
 
 enum FxType {FLANGER, CHORUS, VIBRATO};
 union F_I_32 {float f; int32_t i;};
 
-class Modulation
+// plain (not normalized) parameter values, same fields as the processor state
+struct ModulationParams
 {
-    std::unique_ptr<DelayFractional> m_pDelay;
-    std::unique_ptr<WT_Osc<1024>> m_pLFO;
+    double dryWet = Steinberg::MyModulation::ModulationConst::DRY_WET_DEFAULT;
+    double modRate = Steinberg::MyModulation::ModulationConst::RATE_DEFAULT;
+    double modDepth = Steinberg::MyModulation::ModulationConst::DEPTH_DEFAULT;
+    double feedback = Steinberg::MyModulation::ModulationConst::FEEDBACK_DEFAULT;
+    double chorusOffset = Steinberg::MyModulation::ModulationConst::CHRS_OFST_DEFAULT;
+    int waveform = 0;
+    int effectType = 0;
+    double stereoPhase = Steinberg::MyModulation::ModulationConst::STEREO_PHASE_DEFAULT;
+};
+
+// Everything touched per sample sits in the object itself, hot state first
+// and cache line aligned; the delay lines (and the half-band filters when
+// oversampling) come from one arena allocated in the constructor. Wavetables
+// are shared read-only by all instances.
+class alignas(64) Modulation
+{
+    // the plain path's block loops, specialized per effect, waveform, feedback
+    // and control rate (every sample or ramped) and picked whenever one of
+    // those changes
+    template <typename FloatType>
+    struct Kernels
+    {
+        void (*mono)(Modulation&, const FloatType*, FloatType*, int, int);
+        void (*stereo)(Modulation&, const FloatType*, const FloatType*, FloatType*, FloatType*, int);
+    };
+
+    DelayFractional m_delay;
+    ModLfo m_lfo;
     float m_deltaDelayTime, m_chorusOffset, m_modDepth;
     int32_t m_chorusMask = 0x0;
+    Kernels<float> m_kernels32;
+    Kernels<double> m_kernels64;
+    int m_fxType = FLANGER;
+    Waveform m_waveform = Waveform::SINE;
+    // above 1 the offset is computed every m_controlRate samples and ramped in
+    // between; a negative count makes the next evaluation jump instead
+    int32_t m_controlRate = 1;
+    int32_t m_controlCount[2] = {-1, -1};
+    float m_offset[2] = {0.0f, 0.0f};
+    float m_offsetStep[2] = {0.0f, 0.0f};
+    int32_t m_oversampling;
+    bool m_cubic = false;
+    bool m_plain = true;        // linear at host rate (ECO, STANDARD), the kernels do it
+    halfband::Upsampler2x* m_upsamplers = nullptr;
+    halfband::Downsampler2x* m_downsamplers = nullptr;
+    static constexpr float min_delay = 0.01f;
+    DspArena m_arena;
+
+    float delayOffset(float lfoSampleVal) const noexcept;
+    template <FxType FX>
+    float delayOffset(float lfoSampleVal) const noexcept;
+    template <FxType FX, Waveform WF>
+    void rampOffsets(float*, int, const int) noexcept;
+    template <FxType FX, Waveform WF>
+    void rampOffsetsStereo(float*, float*, int) noexcept;
+    template <FxType FX, Waveform WF, bool FEEDBACK, bool RAMP, typename FloatType>
+    static void kernel(Modulation&, const FloatType*, FloatType*, int, int) noexcept;
+    template <FxType FX, Waveform WF, bool FEEDBACK, bool RAMP, typename FloatType>
+    static void stereoKernel(Modulation&, const FloatType*, const FloatType*, FloatType*, FloatType*, int) noexcept;
+    template <typename FloatType, FxType FX, bool FEEDBACK, bool RAMP>
+    static Kernels<FloatType> kernelsFor(Waveform) noexcept;
+    template <typename FloatType, FxType FX>
+    Kernels<FloatType> kernelsFor(bool feedback) const noexcept;
+    template <typename FloatType>
+    Kernels<FloatType> selectKernels() const noexcept;
+    void selectKernels() noexcept;
+    template <typename FloatType>
+    const Kernels<FloatType>& kernels() const noexcept;
+    void rampDelayOffset(const int ch) noexcept;
+    void rampDelayOffsets() noexcept;
+    template <bool CUBIC, bool RAMP>
+    void tick(float*, const int) noexcept;
+    template <bool CUBIC, bool RAMP>
+    void tickStereo(float*, float*) noexcept;
+    template <bool CUBIC, bool RAMP>
+    void processTiered(const float*, float*, int, const int) noexcept;
+    template <bool CUBIC, bool RAMP>
+    void processTieredStereo(const float*, const float*, float*, float*, int) noexcept;
 public:
-    Modulation(const double sr, const double freq);
+    Modulation(const double sr, const double freq, const int oversampling = 1);
     void update(float*, const int) noexcept;
+    void updateStereo(float*, float*) noexcept;
+    template <typename FloatType>
+    void process(const FloatType* in, FloatType* out, int numSamples, const int ch) noexcept;
+    template <typename FloatType>
+    void processStereo(const FloatType* in0, const FloatType* in1,
+                       FloatType* out0, FloatType* out1, int numSamples) noexcept;
     void setEffectType(const int, const double, const double) noexcept;
     void calculateDelayOffset(const int ch) noexcept;
+    void calculateDelayOffsets() noexcept;
     void setDryWet(const float) noexcept;
     void setFeedback(const float) noexcept;
     void setWaveform(const int) noexcept;
+    void setUserTable(const UserLfoTable*) noexcept;
     void setLfoFreq(const double) noexcept;
     void setChorOffset(const double) noexcept;
     void setModDepth(const double modDepth) noexcept;
     void toggleQuadPhase(bool) noexcept;
+    void setStereoPhase(const double degrees) noexcept;
+    void setParams(const ModulationParams&) noexcept;
+    void seekLfo(uint64_t sampleIndex) noexcept;
+    void setQuality(QualityTier) noexcept;
+    // any combination, not just the tiers'; the oversampling is fixed at construction
+    void setQualitySettings(const QualitySettings&) noexcept;
+    int oversampling() const noexcept { return m_oversampling; }
+    // per-instance storage outside the object: delay lines and resampling filters
+    size_t arenaCapacity() const noexcept { return m_arena.capacity(); }
+    void reset() noexcept;
+    float maxDelayMs() const noexcept;
+    float getFeedback() const noexcept;
+    // for displays: LFO position 0..1 and the delay in effect
+    float lfoPhase(const int ch) const noexcept { return static_cast<float>(m_lfo.cyclePosition(ch)); }
+    float currentDelayMs(const int ch) const noexcept { return m_delay.currentDelayMs(ch); }
+    // in host rate samples, exact
+    double currentDelaySamples(const int ch) const noexcept
+    {
+        return m_delay.currentDelaySamples(ch) / static_cast<double>(m_oversampling);
+    }
+
+    // over-aligned, which plain new only honours from C++17 on
+    static void* operator new(size_t size) { return alignedAllocate(size); }
+    static void operator delete(void* p, size_t size) noexcept { alignedFree(p, size); }
 };
 
+template <>
+inline const Modulation::Kernels<float>& Modulation::kernels<float>() const noexcept
+{
+    return m_kernels32;
+}
+
+template <>
+inline const Modulation::Kernels<double>& Modulation::kernels<double>() const noexcept
+{
+    return m_kernels64;
+}
+
 inline void Modulation::setDryWet(const float dw) noexcept
 {
-    m_pDelay->setDryWet(dw);
+    m_delay.setDryWet(dw);
+    selectKernels();
 }
 
 inline void Modulation::setFeedback(const float fb) noexcept
 {
-    m_pDelay->setFeedback(fb);
+    m_delay.setFeedback(fb);
+    selectKernels();
 }
 
 inline void Modulation::setWaveform(const int wf) noexcept
 {
-    m_pLFO->changeWaveform(wf);
+    m_lfo.changeWaveform(wf);
+    // out of range falls back to the sine, like the LFOs do
+    m_waveform = (wf >= static_cast<int>(Waveform::SINE) && wf <= static_cast<int>(Waveform::CUSTOM))
+               ? static_cast<Waveform>(wf) : Waveform::SINE;
+    selectKernels();
+}
+
+// shape for the CUSTOM waveform; the caller keeps it alive and unchanged while in use
+inline void Modulation::setUserTable(const UserLfoTable* table) noexcept
+{
+    m_lfo.setUserTable(table);
 }
 
 inline void Modulation::setLfoFreq(const double f) noexcept
 {
-    m_pLFO->changeFreq(f);
+    m_lfo.changeFreq(f);
 }
 
 inline void Modulation::setChorOffset(const double chrsOffst) noexcept
@@ -59,21 +204,269 @@ inline void Modulation::setModDepth(const double modDepth) noexcept
 
 inline void Modulation::toggleQuadPhase(bool onOff) noexcept
 {
-    onOff ? m_pLFO->setQuadPhase() : m_pLFO->resetPhase();
+    onOff ? m_lfo.setQuadPhase() : m_lfo.resetPhase();
 }
 
-inline void Modulation::calculateDelayOffset(const int ch) noexcept
+// right channel LFO lead in degrees, for the stereo path
+inline void Modulation::setStereoPhase(const double degrees) noexcept
 {
-    float lfoSampleVal = 0.0f;
-    m_pLFO->generateUnipolar(&lfoSampleVal, ch);
+    m_lfo.setStereoPhase(degrees);
+}
 
-    constexpr float min_delay = 0.01f;
+// sampleIndex counts host rate samples
+inline void Modulation::seekLfo(uint64_t sampleIndex) noexcept
+{
+    m_lfo.seek(sampleIndex * static_cast<uint64_t>(m_oversampling));
+    m_controlCount[0] = m_controlCount[1] = -1;
+}
+
+// back to the freshly constructed state, keeping the allocations
+inline void Modulation::reset() noexcept
+{
+    m_delay.flushDelayBuffers();
+    m_lfo.seek(0);
+    m_controlCount[0] = m_controlCount[1] = -1;
+    if (m_oversampling > 1) {
+        for (int ch = 0; ch < 2; ++ch) {
+            m_upsamplers[ch].reset();
+            m_downsamplers[ch].reset();
+        }
+    }
+}
 
+// longest offset the LFO can reach with the current settings
+inline float Modulation::maxDelayMs() const noexcept
+{
+    F_I_32 fi32;
+    fi32.f = m_chorusOffset;
+    fi32.i &= m_chorusMask;
+    return fi32.f + m_modDepth * m_deltaDelayTime + min_delay;
+}
+
+inline float Modulation::getFeedback() const noexcept
+{
+    return m_delay.getFeedback();
+}
+
+inline float Modulation::delayOffset(float lfoSampleVal) const noexcept
+{
     F_I_32 fi32;
     fi32.f = m_chorusOffset;
     fi32.i &= m_chorusMask;
     fi32.f += m_modDepth * lfoSampleVal * m_deltaDelayTime + min_delay;
-    m_pDelay->setOffset(static_cast<double>(fi32.f), ch);
+    return fi32.f;
+}
+
+// delayOffset() with the effect's constants folded in, same arithmetic
+template <FxType FX>
+inline float Modulation::delayOffset(float lfoSampleVal) const noexcept
+{
+    if (FX == CHORUS)
+        return m_chorusOffset + (m_modDepth * lfoSampleVal * 25.0f + min_delay);
+    return m_modDepth * lfoSampleVal * 7.0f + min_delay;
+}
+
+inline void Modulation::calculateDelayOffset(const int ch) noexcept
+{
+    float lfoSampleVal = 0.0f;
+    m_lfo.generateUnipolar(&lfoSampleVal, ch);
+    m_delay.setOffset(static_cast<double>(delayOffset(lfoSampleVal)), ch);
+}
+
+// both channels from a single LFO evaluation
+inline void Modulation::calculateDelayOffsets() noexcept
+{
+    float lfo[2];
+    m_lfo.generateStereoUnipolar(&lfo[0], &lfo[1]);
+    m_delay.setOffset(static_cast<double>(delayOffset(lfo[0])), 0);
+    m_delay.setOffset(static_cast<double>(delayOffset(lfo[1])), 1);
+}
+
+// the LFO runs one control period ahead, so the ramp meets its exact values at
+// every control point
+inline void Modulation::rampDelayOffset(const int ch) noexcept
+{
+    if (m_controlCount[ch] <= 0) {
+        const uint64_t skip = static_cast<uint64_t>(m_controlRate - 1);
+        float lfoSampleVal = 0.0f;
+        if (m_controlCount[ch] < 0) {
+            m_lfo.generateUnipolar(&lfoSampleVal, ch);
+            m_lfo.skip(skip, ch);
+            m_offset[ch] = delayOffset(lfoSampleVal);
+        }
+        m_lfo.generateUnipolar(&lfoSampleVal, ch);
+        m_lfo.skip(skip, ch);
+        m_offsetStep[ch] = (delayOffset(lfoSampleVal) - m_offset[ch]) / static_cast<float>(m_controlRate);
+        m_controlCount[ch] = m_controlRate;
+    }
+    --m_controlCount[ch];
+    m_delay.setOffset(static_cast<double>(m_offset[ch]), ch);
+    m_offset[ch] += m_offsetStep[ch];
+}
+
+// rampDelayOffset() for both channels off the linked LFO, the counts move together
+inline void Modulation::rampDelayOffsets() noexcept
+{
+    if (m_controlCount[0] <= 0) {
+        const uint64_t skip = static_cast<uint64_t>(m_controlRate - 1);
+        float lfo[2];
+        if (m_controlCount[0] < 0) {
+            m_lfo.generateStereoUnipolar(&lfo[0], &lfo[1]);
+            m_lfo.skipStereo(skip);
+            m_offset[0] = delayOffset(lfo[0]);
+            m_offset[1] = delayOffset(lfo[1]);
+        }
+        m_lfo.generateStereoUnipolar(&lfo[0], &lfo[1]);
+        m_lfo.skipStereo(skip);
+        const float scale = 1.0f / static_cast<float>(m_controlRate);
+        m_offsetStep[0] = (delayOffset(lfo[0]) - m_offset[0]) * scale;
+        m_offsetStep[1] = (delayOffset(lfo[1]) - m_offset[1]) * scale;
+        m_controlCount[0] = m_controlRate;
+    }
+    m_controlCount[1] = --m_controlCount[0];
+    for (int ch = 0; ch < 2; ++ch) {
+        m_delay.setOffset(static_cast<double>(m_offset[ch]), ch);
+        m_offset[ch] += m_offsetStep[ch];
+    }
+}
+
+// per sample, inline so the channel loops don't pay a call for it.
+// Only the STANDARD tier at host rate, process() handles all of them
+inline void Modulation::update(float* buffer, const int ch) noexcept
+{
+    calculateDelayOffset(ch);
+    m_delay.updateDelay(buffer, ch);
+}
+
+// update() for a channel pair sharing one LFO evaluation
+inline void Modulation::updateStereo(float* left, float* right) noexcept
+{
+    calculateDelayOffsets();
+    m_delay.updateDelay(left, 0);
+    m_delay.updateDelay(right, 1);
+}
+
+// one sample at the delay's rate
+template <bool CUBIC, bool RAMP>
+inline void Modulation::tick(float* buffer, const int ch) noexcept
+{
+    if (RAMP)
+        rampDelayOffset(ch);
+    else
+        calculateDelayOffset(ch);
+    m_delay.updateDelay<CUBIC>(buffer, ch);
+}
+
+template <bool CUBIC, bool RAMP>
+inline void Modulation::tickStereo(float* left, float* right) noexcept
+{
+    if (RAMP)
+        rampDelayOffsets();
+    else
+        calculateDelayOffsets();
+    m_delay.updateDelay<CUBIC>(left, 0);
+    m_delay.updateDelay<CUBIC>(right, 1);
+}
+
+template <bool CUBIC, bool RAMP>
+void Modulation::processTiered(const float* in, float* out, int numSamples, const int ch) noexcept
+{
+    if (m_oversampling == 1) {
+        for (int i = 0; i < numSamples; ++i) {
+            float buffer = in[i];
+            tick<CUBIC, RAMP>(&buffer, ch);
+            out[i] = buffer;
+        }
+        return;
+    }
+    for (int i = 0; i < numSamples; ++i) {
+        float up[2];
+        m_upsamplers[ch].process(in[i], up[0], up[1]);
+        tick<CUBIC, RAMP>(&up[0], ch);
+        tick<CUBIC, RAMP>(&up[1], ch);
+        out[i] = m_downsamplers[ch].process(up[0], up[1]);
+    }
+}
+
+template <bool CUBIC, bool RAMP>
+void Modulation::processTieredStereo(const float* in0, const float* in1, float* out0, float* out1,
+                                     int numSamples) noexcept
+{
+    if (m_oversampling == 1) {
+        for (int i = 0; i < numSamples; ++i) {
+            float left = in0[i], right = in1[i];
+            tickStereo<CUBIC, RAMP>(&left, &right);
+            out0[i] = left;
+            out1[i] = right;
+        }
+        return;
+    }
+    for (int i = 0; i < numSamples; ++i) {
+        float up0[2], up1[2];
+        m_upsamplers[0].process(in0[i], up0[0], up0[1]);
+        m_upsamplers[1].process(in1[i], up1[0], up1[1]);
+        tickStereo<CUBIC, RAMP>(&up0[0], &up1[0]);
+        tickStereo<CUBIC, RAMP>(&up0[1], &up1[1]);
+        out0[i] = m_downsamplers[0].process(up0[0], up0[1]);
+        out1[i] = m_downsamplers[1].process(up1[0], up1[1]);
+    }
+}
+
+// a block of one channel, the tier is looked at once per call; in and out may be the same
+template <typename FloatType>
+inline void Modulation::process(const FloatType* in, FloatType* out, int numSamples, const int ch) noexcept
+{
+    if (m_plain) {
+        kernels<FloatType>().mono(*this, in, out, numSamples, ch);
+        return;
+    }
+    // other tiers in float sub-blocks, one loop per interpolation / control rate pair
+    float block[64];
+    for (int offset = 0; offset < numSamples; offset += 64) {
+        const int n = std::min(64, numSamples - offset);
+        for (int i = 0; i < n; ++i)
+            block[i] = static_cast<float>(in[offset + i]);
+        if (m_cubic)
+            m_controlRate == 1 ? processTiered<true, false>(block, block, n, ch)
+                               : processTiered<true, true>(block, block, n, ch);
+        else
+            m_controlRate == 1 ? processTiered<false, false>(block, block, n, ch)
+                               : processTiered<false, true>(block, block, n, ch);
+        for (int i = 0; i < n; ++i)
+            out[offset + i] = static_cast<FloatType>(block[i]);
+    }
+}
+
+// a block of a channel pair with the LFO linked across it: one phase, the right
+// channel reads it at the stereo phase offset. Keep to either this or
+// process() per channel for a given object, the analytic LFO only keeps one
+// of the two in step
+template <typename FloatType>
+inline void Modulation::processStereo(const FloatType* in0, const FloatType* in1,
+                                      FloatType* out0, FloatType* out1, int numSamples) noexcept
+{
+    if (m_plain) {
+        kernels<FloatType>().stereo(*this, in0, in1, out0, out1, numSamples);
+        return;
+    }
+    float block0[64], block1[64];
+    for (int offset = 0; offset < numSamples; offset += 64) {
+        const int n = std::min(64, numSamples - offset);
+        for (int i = 0; i < n; ++i) {
+            block0[i] = static_cast<float>(in0[offset + i]);
+            block1[i] = static_cast<float>(in1[offset + i]);
+        }
+        if (m_cubic)
+            m_controlRate == 1 ? processTieredStereo<true, false>(block0, block1, block0, block1, n)
+                               : processTieredStereo<true, true>(block0, block1, block0, block1, n);
+        else
+            m_controlRate == 1 ? processTieredStereo<false, false>(block0, block1, block0, block1, n)
+                               : processTieredStereo<false, true>(block0, block1, block0, block1, n);
+        for (int i = 0; i < n; ++i) {
+            out0[offset + i] = static_cast<FloatType>(block0[i]);
+            out1[offset + i] = static_cast<FloatType>(block1[i]);
+        }
+    }
 }
 
 #endif // MODULATION_H
@@ -0,0 +1,272 @@
+#ifndef MODULATION_PACK_H
+#define MODULATION_PACK_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "modulation.h"
+
+// LANES independent effect instances in structure-of-arrays form, for hosts that
+// run many copies of the effect (one per channel strip etc.). Every lane has its
+// own parameters, LFO phase and delay buffer, and the per-sample work of all
+// lanes is one loop over contiguous per-lane arrays, so the compiler can keep
+// the lanes in SIMD registers instead of stepping through LANES separate
+// Modulation objects. The delay lines are interleaved by lane, so the write of
+// all lanes at the shared write index is a single contiguous store.
+//
+// A lane produces the same output as a Modulation with the same settings,
+// up to floating point contraction done by the compiler; bench/pack_bench.cpp
+// checks it.
+
+template <size_t LANES, size_t SIZE = 1024u>
+class ModulationPack
+{
+    static_assert((LANES & (LANES - 1)) == 0, "LANES must be a power of two");
+    static constexpr size_t size_mask = SIZE - 1;
+    static constexpr uint64_t phase_mask = (static_cast<uint64_t>(SIZE) << 32) - 1;
+    static constexpr float min_delay = 0.01f;
+    static constexpr int NUM_CHANNELS = 2;
+
+    // per lane state, one entry per lane. No over-alignment, so the pack can be
+    // created with plain new under C++14
+    float m_wet[LANES], m_dry[LANES], m_fb[LANES];
+    float m_chorusOffset[LANES], m_modDepth[LANES], m_deltaDelayTime[LANES];
+    int32_t m_chorusMask[LANES];
+    uint32_t m_tableOffset[LANES];
+    uint64_t m_incr[LANES];
+    uint64_t m_stereoOffset[LANES];     // channel 1 phase lead
+    uint64_t m_phase[NUM_CHANNELS][LANES];
+
+    float m_tables[Steinberg::MyModulation::ModulationConst::NUM_LFO_SHAPES][SIZE];
+    std::vector<float> m_delayBuffer[NUM_CHANNELS];   // delay_buff_size * LANES, lane-interleaved
+    size_t m_writeIndex[NUM_CHANNELS];
+    size_t delay_buff_size, delay_buff_mask;
+    double m_sampleRate;
+    float m_samplesPerMs;
+public:
+    static constexpr size_t lanes = LANES;
+
+    explicit ModulationPack(double sr);
+    // buffers[lane][ch], processed in place like Modulation::update, numChannels 1 or 2
+    void process(float* const* const* buffers, int numChannels, int numSamples) noexcept;
+
+    void setParams(size_t lane, const ModulationParams&) noexcept;
+    void setDryWet(size_t lane, float) noexcept;
+    void setFeedback(size_t lane, float) noexcept;
+    void setModDepth(size_t lane, double) noexcept;
+    void setChorOffset(size_t lane, double) noexcept;
+    void setEffectType(size_t lane, int, double, double) noexcept;
+    void setWaveform(size_t lane, int) noexcept;
+    void setUserTable(const UserLfoTable&) noexcept;
+    void setLfoFreq(size_t lane, double) noexcept;
+    void setStereoPhase(size_t lane, double degrees) noexcept;
+    void seekLfo(size_t lane, uint64_t sampleIndex) noexcept;
+    void resetLane(size_t lane) noexcept;
+};
+
+template <size_t LANES, size_t SIZE>
+ModulationPack<LANES, SIZE>::ModulationPack(double sr) : m_sampleRate(sr),
+                                                         m_samplesPerMs(static_cast<float>(sr) / 1000.0f)
+{
+    WTables<SIZE> tables;
+    tables.fill();
+    memcpy(m_tables[static_cast<int>(Waveform::SINE)], tables.Sin.data(), sizeof(float) * SIZE);
+    memcpy(m_tables[static_cast<int>(Waveform::SAW)], tables.Saw.data(), sizeof(float) * SIZE);
+    memcpy(m_tables[static_cast<int>(Waveform::TRIANGLE)], tables.Tri.data(), sizeof(float) * SIZE);
+    memcpy(m_tables[static_cast<int>(Waveform::SQUARE)], tables.Sqr.data(), sizeof(float) * SIZE);
+    memcpy(m_tables[static_cast<int>(Waveform::CUSTOM)], tables.Sin.data(), sizeof(float) * SIZE);
+
+    // same length as DelayFractional: next power of two above 2 sec
+    delay_buff_size = 1;
+    while (delay_buff_size < static_cast<size_t>(sr * 2.0))
+        delay_buff_size <<= 1;
+    delay_buff_mask = delay_buff_size - 1;
+    for (int ch = 0; ch < NUM_CHANNELS; ++ch) {
+        m_delayBuffer[ch].assign(delay_buff_size * LANES, 0.0f);
+        m_writeIndex[ch] = 0;
+    }
+
+    memset(m_phase, 0, sizeof(m_phase));
+    memset(m_stereoOffset, 0, sizeof(m_stereoOffset));
+    const ModulationParams defaults;
+    for (size_t lane = 0; lane < LANES; ++lane)
+        setParams(lane, defaults);
+}
+
+template <size_t LANES, size_t SIZE>
+void ModulationPack<LANES, SIZE>::process(float* const* const* buffers, int numChannels, int numSamples) noexcept
+{
+    constexpr float frac_scale = 1.0f / 16777216.0f;    // 2^-24, as in WT_Osc::generate
+    const float* const tables = m_tables[0];
+
+    for (int ch = 0; ch < numChannels; ++ch) {
+        float* const buffer = m_delayBuffer[ch].data();
+        uint64_t* const phase = m_phase[ch];
+        size_t w = m_writeIndex[ch];
+
+        for (int i = 0; i < numSamples; ++i) {
+            alignas(64) float x[LANES], y[LANES];
+            for (size_t l = 0; l < LANES; ++l)
+                x[l] = buffers[l][ch][i];
+
+            // reads only: LFO, delay offset and the interpolated delayed sample of every lane
+            for (size_t l = 0; l < LANES; ++l) {
+                const size_t readIndex = static_cast<size_t>(phase[l] >> 32);
+                const float fraction = static_cast<float>((phase[l] >> 8) & 0xFFFFFF) * frac_scale;
+                const float* table = tables + m_tableOffset[l];
+                const float lfo = (table[readIndex] * (1.0f - fraction)
+                                   + table[(readIndex + 1) & size_mask] * fraction) * 0.5f + 0.5f;
+                phase[l] = (phase[l] + m_incr[l]) & phase_mask;
+
+                F_I_32 fi32;
+                fi32.f = m_chorusOffset[l];
+                fi32.i &= m_chorusMask[l];
+                fi32.f += m_modDepth[l] * lfo * m_deltaDelayTime[l] + min_delay;
+
+                const float delaySamples = fi32.f * m_samplesPerMs;
+                const size_t delayIntegral = static_cast<size_t>(delaySamples);
+                const float dFraction = delaySamples - static_cast<float>(delayIntegral);
+                const size_t r0 = (w - delayIntegral) & delay_buff_mask;
+                const size_t r1 = (r0 - 1) & delay_buff_mask;
+                const float interp = buffer[r0 * LANES + l] * (1.0f - dFraction)
+                                   + buffer[r1 * LANES + l] * dFraction;
+                y[l] = delayIntegral ? interp : x[l];
+            }
+
+            // writes only: one contiguous row of the interleaved delay line
+            float* const row = buffer + w * LANES;
+            for (size_t l = 0; l < LANES; ++l) {
+                row[l] = x[l] + y[l] * m_fb[l];
+                x[l] = m_dry[l] * x[l] + m_wet[l] * y[l];
+            }
+            for (size_t l = 0; l < LANES; ++l)
+                buffers[l][ch][i] = x[l];
+
+            w = (w + 1) & delay_buff_mask;
+        }
+        m_writeIndex[ch] = w;
+    }
+}
+
+template <size_t LANES, size_t SIZE>
+void ModulationPack<LANES, SIZE>::setParams(size_t lane, const ModulationParams& p) noexcept
+{
+    setDryWet(lane, static_cast<float>(p.dryWet));
+    setFeedback(lane, static_cast<float>(p.feedback));
+    setModDepth(lane, p.modDepth);
+    setChorOffset(lane, p.chorusOffset);
+    setEffectType(lane, p.effectType, p.dryWet, p.feedback);
+    setWaveform(lane, p.waveform);
+    setLfoFreq(lane, p.modRate);
+    setStereoPhase(lane, p.stereoPhase);
+}
+
+template <size_t LANES, size_t SIZE>
+inline void ModulationPack<LANES, SIZE>::setDryWet(size_t lane, float dw) noexcept
+{
+    m_wet[lane] = dw;
+    m_dry[lane] = 1.0f - dw;
+}
+
+template <size_t LANES, size_t SIZE>
+inline void ModulationPack<LANES, SIZE>::setFeedback(size_t lane, float fb) noexcept
+{
+    m_fb[lane] = fb;
+}
+
+template <size_t LANES, size_t SIZE>
+inline void ModulationPack<LANES, SIZE>::setModDepth(size_t lane, double modDepth) noexcept
+{
+    m_modDepth[lane] = static_cast<float>(modDepth);
+}
+
+template <size_t LANES, size_t SIZE>
+inline void ModulationPack<LANES, SIZE>::setChorOffset(size_t lane, double chrsOffst) noexcept
+{
+    m_chorusOffset[lane] = static_cast<float>(chrsOffst);
+}
+
+// mirrors Modulation::setEffectType
+template <size_t LANES, size_t SIZE>
+void ModulationPack<LANES, SIZE>::setEffectType(size_t lane, int fxT, double dw, double fb) noexcept
+{
+    switch (fxT) {
+    case CHORUS:
+        m_deltaDelayTime[lane] = 25.0f;
+        m_chorusMask[lane] = ~0x0;
+        setDryWet(lane, static_cast<float>(dw));
+        setFeedback(lane, static_cast<float>(fb));
+        break;
+    case VIBRATO:
+        m_deltaDelayTime[lane] = 7.0f;
+        m_chorusMask[lane] = 0x0;
+        setDryWet(lane, 1.0f);
+        setFeedback(lane, 0.0f);
+        break;
+    case FLANGER:
+        setDryWet(lane, static_cast<float>(dw));
+        setFeedback(lane, static_cast<float>(fb));
+        // fall through
+    default:
+        m_deltaDelayTime[lane] = 7.0f;
+        m_chorusMask[lane] = 0x0;
+    }
+}
+
+template <size_t LANES, size_t SIZE>
+inline void ModulationPack<LANES, SIZE>::setWaveform(size_t lane, int wf) noexcept
+{
+    if (wf < 0 || wf >= Steinberg::MyModulation::ModulationConst::NUM_LFO_SHAPES)
+        wf = static_cast<int>(Waveform::SINE);
+    m_tableOffset[lane] = static_cast<uint32_t>(wf) * SIZE;
+}
+
+// one custom shape for all lanes, copied in; not while process() runs
+template <size_t LANES, size_t SIZE>
+inline void ModulationPack<LANES, SIZE>::setUserTable(const UserLfoTable& table) noexcept
+{
+    static_assert(SIZE == USER_LFO_SIZE, "custom shapes come at the wavetable size");
+    memcpy(m_tables[static_cast<int>(Waveform::CUSTOM)], table.data(), sizeof(float) * SIZE);
+}
+
+template <size_t LANES, size_t SIZE>
+inline void ModulationPack<LANES, SIZE>::setLfoFreq(size_t lane, double freq) noexcept
+{
+    m_incr[lane] = static_cast<uint64_t>(static_cast<double>(SIZE) * freq / m_sampleRate * 4294967296.0);
+}
+
+// mirrors WT_Osc::setStereoPhase
+template <size_t LANES, size_t SIZE>
+inline void ModulationPack<LANES, SIZE>::setStereoPhase(size_t lane, double degrees) noexcept
+{
+    const double cycles = degrees / 360.0 - std::floor(degrees / 360.0);
+    m_stereoOffset[lane] = static_cast<uint64_t>(cycles * static_cast<double>(SIZE) * 4294967296.0) & phase_mask;
+    m_phase[1][lane] = (m_phase[0][lane] + m_stereoOffset[lane]) & phase_mask;
+}
+
+template <size_t LANES, size_t SIZE>
+inline void ModulationPack<LANES, SIZE>::seekLfo(size_t lane, uint64_t sampleIndex) noexcept
+{
+    m_phase[0][lane] = (sampleIndex * m_incr[lane]) & phase_mask;
+    m_phase[1][lane] = (m_phase[0][lane] + m_stereoOffset[lane]) & phase_mask;
+}
+
+// clears one lane's history, the shared write index keeps running
+template <size_t LANES, size_t SIZE>
+void ModulationPack<LANES, SIZE>::resetLane(size_t lane) noexcept
+{
+    for (int ch = 0; ch < NUM_CHANNELS; ++ch) {
+        float* buffer = m_delayBuffer[ch].data();
+        for (size_t i = 0; i < delay_buff_size; ++i)
+            buffer[i * LANES + lane] = 0.0f;
+    }
+    seekLfo(lane, 0);
+}
+
+// the common widths are compiled once into modulation_dsp
+extern template class ModulationPack<4>;
+extern template class ModulationPack<8>;
+extern template class ModulationPack<16>;
+
+#endif // MODULATION_PACK_H
@@ -0,0 +1,39 @@
+#ifndef MODULATIONCONST_H
+#define MODULATIONCONST_H
+
+// parameter ranges shared by the plug-in and the SDK-free tools
+
+namespace Steinberg {
+namespace MyModulation {
+
+namespace ModulationConst
+{
+    static constexpr double DRY_WET_MIN = 0.0;
+    static constexpr double DRY_WET_MAX = 1.0;
+    static constexpr double DRY_WET_DEFAULT = 0.5;
+    static constexpr double FEEDBACK_MIN = -0.95;
+    static constexpr double FEEDBACK_MAX = 0.95;
+    static constexpr double FEEDBACK_DEFAULT = 0.4;
+    static constexpr double DEPTH_MIN = 0.0;
+    static constexpr double DEPTH_MAX = 1.0;
+    static constexpr double DEPTH_DEFAULT = 0.5;
+    static constexpr double RATE_MIN = 0.02;
+    static constexpr double RATE_MAX = 5.0;
+    static constexpr double RATE_DEFAULT = 0.18;
+    static constexpr double CHRS_OFST_MIN = 5.0;
+    static constexpr double CHRS_OFST_MAX = 35.0;
+    static constexpr double CHRS_OFST_DEFAULT = 5.0;
+    static constexpr double STEREO_PHASE_MIN = 0.0;     // degrees the right LFO leads the left
+    static constexpr double STEREO_PHASE_MAX = 180.0;
+    static constexpr double STEREO_PHASE_DEFAULT = 0.0;
+    static constexpr int	NUM_WAVEFORMS = 4;    // sine, saw, triangle, square: the waveform list
+    static constexpr int	NUM_LFO_SHAPES = 5;   // the waveforms and the custom shape, in the engine
+    static constexpr int	NUM_FX_TYPES = 3;
+    static constexpr double LOAD_METER_MAX = 200.0;    // percent of the block budget
+    static constexpr int    NUM_SNAPSHOTS = 4;
+};
+
+} // namespace MyModulation
+} // namespace Steinberg
+
+#endif // MODULATIONCONST_H
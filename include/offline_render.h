@@ -0,0 +1,38 @@
+#ifndef OFFLINE_RENDER_H
+#define OFFLINE_RENDER_H
+
+#include <cstddef>
+#include "modulation.h"
+
+// Offline (bounce) rendering of whole files with fixed parameters.
+//
+// renderParallel() splits the input into chunks and renders them on a thread pool.
+// Every chunk starts from a fresh Modulation, seeks the LFO to the chunk's first
+// sample and runs a pre-roll long enough for the feedback tail of everything
+// before it to decay below tailThreshold. The stitched result then differs from
+// renderSerial() by at most tailThreshold * peak(|input|), and the first chunk
+// (as well as any render with zero feedback) is bit-identical.
+
+namespace offline_render
+{
+
+struct RenderOptions
+{
+    size_t chunkSize = 1u << 20;     // samples, raised to at least 4 * pre-roll
+    unsigned numThreads = 0;         // 0 - one per hardware thread
+    float tailThreshold = 1.0e-6f;   // -120 dB, relative to the input peak
+};
+
+size_t prerollSamples(const Modulation&, double sampleRate, float tailThreshold) noexcept;
+
+// in/out hold numChannels non-interleaved buffers of numSamples each,
+// channels are processed in pairs, the same way the plug-in sees a stereo bus
+void renderSerial(const float* const* in, float* const* out, int numChannels,
+                  size_t numSamples, double sampleRate, const ModulationParams&);
+void renderParallel(const float* const* in, float* const* out, int numChannels,
+                    size_t numSamples, double sampleRate, const ModulationParams&,
+                    const RenderOptions& = RenderOptions());
+
+}   // offline_render
+
+#endif // OFFLINE_RENDER_H
@@ -39,6 +39,8 @@
 #include "public.sdk/source/vst/vsteditcontroller.h"
 #include "public.sdk/samples/vst/common/logscale.h"
 #include "../include/plugids.h"
+#include "../include/user_lfo.h"
+#include "../include/dspsnapshot.h"
 #include <memory>
 //#include "vstgui4/vstgui/plugin-bindings/vst3editor.h"
 
@@ -64,8 +66,23 @@ public:
 	//---from EditController-----
 //    IPlugView* PLUGIN_API createView (const char* name) SMTG_OVERRIDE;
     tresult PLUGIN_API setComponentState (IBStream* state) SMTG_OVERRIDE;
+    tresult PLUGIN_API notify (Vst::IMessage* message) SMTG_OVERRIDE;
     //------------------------------------------------------
     tresult PLUGIN_API setParamNormalizedFromFile(Vst::ParamID tag, Vst::ParamValue value);
+
+    // custom LFO shape for the processor: points drawn over one cycle, or a text file of them
+    tresult sendUserLfo(const float* points, size_t count);
+    tresult importUserLfo(const char* path);
+    const UserLfoTable& userLfo() const { return mUserLfo; }
+
+    // for the editor, on the UI thread: the newest DSP snapshot the processor
+    // sent, all zero before the first one
+    const DspSnapshot& dspSnapshot();
+private:
+    UserLfoTable mUserLfo;
+    // notify() normally runs on the UI thread, but a host may deliver from
+    // elsewhere, so snapshots cross over the same way they left the audio thread
+    TripleBuffer<DspSnapshot> mDspSnapshots;
 };
 
 //------------------------------------------------------------------------
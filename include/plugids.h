@@ -37,6 +37,7 @@
 #pragma once
 
 #include "public.sdk/source/vst/vstparameters.h"
+#include "modulationconst.h"
 
 namespace Steinberg {
 namespace MyModulation {
@@ -53,30 +54,38 @@ enum MyModulationParams : Vst::ParamID
 
     kParamEffectTypeID = 107,
 
-    kBypassID = 108
-};
+    kBypassID = 108,
 
-namespace ModulationConst
-{
-    static constexpr double DRY_WET_MIN = 0.0;
-    static constexpr double DRY_WET_MAX = 1.0;
-    static constexpr double DRY_WET_DEFAULT = 0.5;
-    static constexpr double FEEDBACK_MIN = -0.95;
-    static constexpr double FEEDBACK_MAX = 0.95;
-    static constexpr double FEEDBACK_DEFAULT = 0.4;
-    static constexpr double DEPTH_MIN = 0.0;
-    static constexpr double DEPTH_MAX = 1.0;
-    static constexpr double DEPTH_DEFAULT = 0.5;
-    static constexpr double RATE_MIN = 0.02;
-    static constexpr double RATE_MAX = 5.0;
-    static constexpr double RATE_DEFAULT = 0.18;
-    static constexpr double CHRS_OFST_MIN = 5.0;
-    static constexpr double CHRS_OFST_MAX = 35.0;
-    static constexpr double CHRS_OFST_DEFAULT = 5.0;
-    static constexpr int	NUM_WAVEFORMS = 4;
-    static constexpr int	NUM_FX_TYPES = 3;
+    // read-only meters, sent back through outputParameterChanges
+    kDspLoadMeanID = 109,
+    kDspLoadP99ID = 110,
+    kDspLoadMaxID = 111,
+
+    // snapshot slots: morph position over all slots, store current settings into a slot
+    kSnapshotMorphID = 112,
+    kSnapshotStoreID = 113,
+
+    // quality tier (Auto picks from the process mode), realtime load governor,
+    // and the tier actually running, read-only
+    kQualityID = 114,
+    kGovernorID = 115,
+    kQualityActiveID = 116,
+
+    // degrees the right channel's LFO leads the left, both run off one phase
+    kStereoPhaseID = 117,
+
+    // the LFO plays the user shape instead of the waveform; a separate switch
+    // keeps the waveform list, and with it automation of it, as it was
+    kCustomLfoID = 118
 };
 
+// controller -> processor: a custom LFO shape, USER_LFO_SIZE floats in one binary attribute
+static const char* const kUserLfoMessageID = "UserLfoTable";
+static const char* const kUserLfoTableAttr = "table";
+
+// processor -> controller at display rate: one DspSnapshot in a binary attribute
+static const char* const kDspSnapshotMessageID = "DspSnapshot";
+static const char* const kDspSnapshotAttr = "snapshot";
 
 // HERE you have to define new unique class ids: for processor and for controller
 // you can use GUID creator tools like https://www.guidgenerator.com/
@@ -39,21 +39,36 @@
 #include "public.sdk/source/vst/vstaudioeffect.h"
 #include "modulation.h"
 #include "audiotools.h"
+#include "forkjoin.h"
+#include "loadmeter.h"
+#include "dspsnapshot.h"
+#include "base/source/timer.h"
+#ifdef MYMODULATION_TRACE
+#include "trace.h"
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <functional>
 #include <cassert>
 #include <memory>
+#include <mutex>
+#include <vector>
 #include "public.sdk/samples/vst/common/logscale.h"
 
 namespace Steinberg {
 namespace MyModulation {
 
 //-----------------------------------------------------------------------------
-class PlugProcessor : public Vst::AudioEffect
+class PlugProcessor : public Vst::AudioEffect, public ITimerCallback
 {
 public:
 	PlugProcessor ();
 
 	tresult PLUGIN_API initialize (FUnknown* context) SMTG_OVERRIDE;
+	tresult PLUGIN_API terminate () SMTG_OVERRIDE;
+	tresult PLUGIN_API connect (Vst::IConnectionPoint* other) SMTG_OVERRIDE;
+	tresult PLUGIN_API disconnect (Vst::IConnectionPoint* other) SMTG_OVERRIDE;
 	tresult PLUGIN_API setBusArrangements (Vst::SpeakerArrangement* inputs, int32 numIns,
 	                                       Vst::SpeakerArrangement* outputs, int32 numOuts) SMTG_OVERRIDE;
     tresult PLUGIN_API canProcessSampleSize(int32 symbolicSampleSize) SMTG_OVERRIDE;
@@ -61,6 +76,7 @@ public:
 	tresult PLUGIN_API setupProcessing (Vst::ProcessSetup& setup) SMTG_OVERRIDE;
 	tresult PLUGIN_API setActive (TBool state) SMTG_OVERRIDE;
 	tresult PLUGIN_API process (Vst::ProcessData& data) SMTG_OVERRIDE;
+	tresult PLUGIN_API notify (Vst::IMessage* message) SMTG_OVERRIDE;
 
 //------------------------------------------------------------------------
 	tresult PLUGIN_API setState (IBStream* state) SMTG_OVERRIDE;
@@ -73,13 +89,32 @@ public:
 
     template<typename FloatType>
     void processAudio(FloatType* in, FloatType* out, int numSamples, int ch);
+    template<typename FloatType>
+    void processAudioPair(FloatType* in0, FloatType* in1, FloatType* out0, FloatType* out1,
+                          int numSamples, int firstCh);
+
+    // wall time of setActive(true); reallocations counts the activations that had to rebuild the DSP
+    struct ActivationStats
+    {
+        double lastMs = 0.0;
+        double maxMs = 0.0;
+        uint32 count = 0;
+        uint32 reallocations = 0;
+    };
+    const ActivationStats& activationStats() const noexcept { return m_activationStats; }
 
 protected:
    //--------------------------
-    std::unique_ptr<Modulation> m_pMod;
+    std::vector<std::unique_ptr<Modulation>> m_mods;    // one per channel pair
+    double m_dspSampleRate = 0.0;                       // m_mods were built for this rate
+    int32 m_numChannels = 0;                            // output bus width, cached by setActive
     Vst::ParamValue mDryWet, mModRate, mModDepth,
                     mFeedback, mChorusOffset;
     int8 mWaveform, mEffectType;
+    bool mCustomLfo = false;                            // plays the user shape instead of mWaveform
+    int8 mQuality = 0;                                  // 0 = auto, then QualityTier + 1
+    bool mGovernor = false;
+    Vst::ParamValue mStereoPhase = ModulationConst::STEREO_PHASE_DEFAULT;
     bool mBypass;
     bool m_isSampleSize64;
     //----------------------------
@@ -89,6 +124,91 @@ private:
     typedef  void(*BypassFunc)(Vst::ProcessData& data, int32 numChannels);
     ProcFunc procFunc;
     BypassFunc bypassFunc;
+    ActivationStats m_activationStats;
+    ModulationParams currentParams() const noexcept;
+    int lfoShape() const noexcept { return mCustomLfo ? static_cast<int>(Waveform::CUSTOM) : mWaveform; }
+
+    // opt-in (MYMODULATION_PARALLEL_CHANNELS): channel pairs of wide buses on a worker pool
+    std::unique_ptr<ForkJoinPool> m_pool;
+    Vst::ProcessData* m_forkData = nullptr;
+    int32 m_forkChannels = 0;
+    static void processPairTask(void* context, int pair);
+
+    // DSP load, published as output parameters every LOAD_PUBLISH_SECONDS of audio
+    LoadMeter m_loadMeter;
+    int32 m_loadPublishSamples = 0;
+    int32 m_loadPublishCountdown = 0;
+    void updateLoad(Vst::IParameterChanges* outParams) noexcept;
+
+    // quality tier: the selected one, stepped down by the governor while a
+    // realtime host keeps the block time over budget
+    int m_governorSteps = 0;
+    int m_governorCalmWindows = 0;
+    QualityTier selectedTier() const noexcept;
+    QualityTier activeTier() const noexcept;
+    QualitySettings runningSettings(QualityTier tier) const noexcept;
+    void stepGovernor(int steps) noexcept;
+    void applyQuality() noexcept;
+    void governLoad(const LoadMeter::Stats& stats) noexcept;
+
+#ifdef MYMODULATION_TRACE
+    std::unique_ptr<TraceRecorder> m_trace;
+#endif
+
+    // snapshot slots, morphed through the smoothers in CONTROL_BLOCK sized sub-blocks;
+    // everything is fixed size, the audio thread never allocates or reactivates for a scene change
+    enum SmoothedParam {SMOOTH_DRY_WET, SMOOTH_RATE, SMOOTH_DEPTH, SMOOTH_FEEDBACK, SMOOTH_CHORUS_OFFSET, NUM_SMOOTHED};
+    static Vst::ParamValue PlugProcessor::* const smoothedMembers[NUM_SMOOTHED];
+    ModulationParams m_snapshots[ModulationConst::NUM_SNAPSHOTS];
+    int32 m_snapshotsStored = 0;    // bit per slot, morphing skips slots never stored
+    Vst::ParamValue mMorph = 0.0;
+    double m_morphTarget[NUM_SMOOTHED];
+    audio_tools::ParamSmoothing<double> m_smoothers[NUM_SMOOTHED];
+    bool m_smoothing = false;
+    void storeSnapshot(int slot) noexcept;
+    void morphTo(Vst::ParamValue morph) noexcept;
+    void setDirect(SmoothedParam which, double value) noexcept;
+    void stepSmoothing() noexcept;
+
+    Vst::ProcessData m_subData;
+    Vst::AudioBusBuffers m_subInput, m_subOutput;
+    std::vector<float*> m_subIn32, m_subOut32;
+    std::vector<double*> m_subIn64, m_subOut64;
+    Vst::ProcessData& subBlock(Vst::ProcessData& data, int32 offset, int32 numSamples) noexcept;
+    void renderBlock(Vst::ProcessData& data, int32 numChannels) noexcept;
+
+    // custom LFO shape, double buffered. Writers (messages, setState) fill the
+    // back table under the mutex and publish it; the audio thread adopts it at
+    // the start of a block with a single CAS on m_userTableState, which holds
+    // the front index and the published flag together
+    static constexpr int USER_TABLE_FRONT = 0x1;
+    static constexpr int USER_TABLE_PENDING = 0x2;
+    UserLfoTable m_userTables[2];
+    std::atomic<int> m_userTableState {0};
+    std::mutex m_userTableMutex;
+    void publishUserTable(const UserLfoTable& table);
+    void adoptUserTable() noexcept;
+
+    // display data: the audio thread publishes a snapshot per block into the
+    // triple buffer, a timer on the UI thread forwards the newest to the
+    // controller while connected and active. Nothing on the audio thread
+    // waits or sends
+    TripleBuffer<DspSnapshot> m_dspSnapshots;
+    uint32 m_snapshotBlocks = 0;
+    bool m_peerConnected = false;
+    bool m_active = false;
+    IPtr<Timer> m_snapshotTimer;
+    void takeDspSnapshot(const float inputPeak[2], const float outputPeak[2]) noexcept;
+    void sendDspSnapshot();
+    void onTimer(Timer* timer) SMTG_OVERRIDE;
+    void updateSnapshotSender();
+
+    template <typename Setter, typename... Args>
+    void setAll(Setter setter, Args... args) noexcept
+    {
+        for (auto& mod : m_mods)
+            ((*mod).*setter)(args...);
+    }
 
 //    void bypassed32(Vst::ProcessData& data, int32 numChannels);
 //    void bypassed64(Vst::ProcessData& data, int32 numChannels);
@@ -124,6 +244,19 @@ inline void bypassed64(Vst::ProcessData& data, int32 numChannels)
     }
 }
 
+// linear peak of each of the first two channels over the block
+template <typename FloatType>
+inline void blockPeaks(FloatType** buffers, int32 numChannels, int32 numSamples, float peak[2]) noexcept
+{
+    for (int32 channel = 0; channel < std::min<int32>(numChannels, 2); channel++)
+    {
+        FloatType p = 0;
+        for (int32 sample = 0; sample < numSamples; sample++)
+            p = std::max(p, std::fabs(buffers[channel][sample]));
+        peak[channel] = static_cast<float>(p);
+    }
+}
+
 //------------------------------------------------------------------------
 } // namespace
 } // namespace Steinberg
@@ -0,0 +1,91 @@
+#ifndef PLUGSTATE_H
+#define PLUGSTATE_H
+
+#include "pluginterfaces/base/ibstream.h"
+#include "modulationconst.h"
+#include "user_lfo.h"
+#include <cstddef>
+#include <type_traits>
+
+namespace Steinberg {
+namespace MyModulation {
+
+// Everything getState saves, in one fixed layout shared by the processor
+// (getState/setState) and the controller (setComponentState). On the stream
+// it's a PlugStateHeader followed by the PlugState bytes, little endian, so
+// a current state loads with one read and one copy.
+//
+// Fields are only ever appended. The header says how many bytes of PlugState
+// follow: a reader copies the part it knows of a newer state and ignores the
+// rest, and whatever an older state doesn't have keeps its default. Neither
+// needs per-field parsing. Version 1 is the unversioned stream written before
+// this format, read field by field and migrated. Version 3 gave the reserved
+// word its meaning; in older states it's inferred from the slots' contents.
+// Up to version 3 the custom shape was a fifth waveform, version 4 has a
+// switch for it and snapshots keep the engine's shape index, custom included.
+
+struct PlugStateSnapshot
+{
+    double dryWet, modRate, modDepth, feedback, chorusOffset;
+    int32 waveform, effectType;
+};
+
+struct PlugState
+{
+    // version 2
+    double dryWet, modRate, modDepth, feedback, chorusOffset;
+    double morph;
+    double stereoPhase;
+    int32 waveform, effectType;
+    int32 bypass;
+    int32 quality;                  // 0 = auto, then QualityTier + 1
+    int32 governor;
+    int32 snapshotsStored;          // version 3: bit i set once slot i was stored
+    PlugStateSnapshot snapshots[ModulationConst::NUM_SNAPSHOTS];
+    UserLfoTable userLfo;
+    // version 4
+    int32 customLfo;                // the user shape instead of the waveform
+    int32 reserved;                 // zero, keeps the size a multiple of 8
+    // later versions append here
+};
+
+struct PlugStateHeader
+{
+    uint64 magic;                   // a NaN, where version 1 starts with its dry/wet value
+    uint32 version;
+    uint32 size;                    // bytes of PlugState that follow
+};
+
+static_assert(std::is_trivially_copyable<PlugState>::value && std::is_standard_layout<PlugState>::value,
+              "the state is copied as bytes");
+static_assert(sizeof(PlugStateSnapshot) == 48 && offsetof(PlugState, snapshots) == 80
+              && sizeof(PlugState) == 80 + 48 * ModulationConst::NUM_SNAPSHOTS + 4 * USER_LFO_SIZE + 8,
+              "the layout is fixed, fields may only be appended");
+static_assert(sizeof(PlugStateHeader) == 16, "no padding in the header");
+
+namespace plug_state
+{
+
+static constexpr uint64 MAGIC = 0x7ff84d4d4f445354ull;     // quiet NaN with "MMODST" in the payload
+static constexpr uint32 VERSION = 4;
+
+void setDefaults(PlugState& state) noexcept;
+
+// any version, sanitized; false if the stream holds neither format or is cut
+// short, and then state is not to be used
+bool read(IBStream* stream, PlugState& state);
+bool write(IBStream* stream, const PlugState& state);
+
+// the bytes of a whole version 1 stream; sections it didn't have yet keep their defaults.
+// A custom shape is resampled through a temporary, which may throw std::bad_alloc
+bool migrateV1(const uint8* data, size_t size, PlugState& state);
+
+// everything into its parameter range, NaNs to defaults
+void sanitize(PlugState& state) noexcept;
+
+} // namespace plug_state
+
+} // namespace MyModulation
+} // namespace Steinberg
+
+#endif // PLUGSTATE_H
@@ -0,0 +1,43 @@
+#ifndef QUALITY_H
+#define QUALITY_H
+
+// Quality tiers, cheapest first:
+//   ECO       linear interpolation, LFO evaluated every 16 samples and ramped
+//   STANDARD  linear interpolation, LFO every sample (the original engine)
+//   HIGH      4-point Hermite interpolation, LFO every sample
+//   ULTRA     as HIGH, with delay and LFO running at twice the sample rate
+// Interpolation and control rate can change at any time, the oversampling
+// factor is fixed when a Modulation is built.
+
+enum class QualityTier {ECO, STANDARD, HIGH, ULTRA};
+static constexpr int NUM_QUALITY_TIERS = 4;
+
+struct QualitySettings
+{
+    int interpolationOrder;     // 1 or 3
+    int lfoControlRate;         // samples per LFO evaluation
+    int oversampling;           // 1 or 2
+};
+
+inline QualitySettings qualitySettings(QualityTier tier) noexcept
+{
+    switch (tier) {
+    case QualityTier::ECO:
+        return {1, 16, 1};
+    case QualityTier::HIGH:
+        return {3, 1, 1};
+    case QualityTier::ULTRA:
+        return {3, 1, 2};
+    default:    // STANDARD
+        return {1, 1, 1};
+    }
+}
+
+inline QualityTier clampTier(int tier) noexcept
+{
+    return tier <= 0 ? QualityTier::ECO
+         : tier >= NUM_QUALITY_TIERS - 1 ? QualityTier::ULTRA
+         : static_cast<QualityTier>(tier);
+}
+
+#endif // QUALITY_H
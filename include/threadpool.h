@@ -0,0 +1,53 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool for the offline tools. Every worker owns a deque, takes
+// its own work from the back and steals from the front of the others when idle.
+// Tasks get the index of the worker running them, so callers can keep
+// per-worker state (one Modulation per worker etc.) without locking.
+
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void(unsigned worker)>;
+
+    explicit WorkStealingPool(unsigned numWorkers = 0);   // 0 - one per hardware thread
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+    ~WorkStealingPool();
+
+    unsigned size() const noexcept { return static_cast<unsigned>(m_queues.size()); }
+    void submit(Task);
+    void wait();    // blocks until every submitted task has finished
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    bool popOwn(unsigned worker, Task&);
+    bool steal(unsigned worker, Task&);
+    void run(unsigned worker);
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_wake, m_done;
+    std::atomic<size_t> m_queued {0};
+    size_t m_pending = 0;    // guarded by m_mutex
+    unsigned m_nextQueue = 0;
+    bool m_stop = false;
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,103 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "cyclecounter.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Real-time trace: process() pushes fixed size events into a single producer /
+// single consumer ring, a background thread drains it into a binary file every
+// few milliseconds. When the ring is full events are dropped and counted, the
+// audio thread never waits. tools/trace2json turns the file into Chrome trace
+// JSON. The plug-in only records with MYMODULATION_TRACE defined.
+//
+// File layout (native endianness): TraceFileHeader, then TraceEvents until EOF.
+
+enum class TraceType : uint16_t
+{
+    BLOCK_BEGIN,    // id = channels, value = samples
+    BLOCK_END,
+    PARAM,          // id = parameter id, value = normalized value
+    BYPASS,         // value = 0 / 1
+    EFFECT_TYPE,    // value = FxType
+    DROPPED         // written by the drain thread, value = events lost since the last one
+};
+
+struct TraceEvent
+{
+    uint64_t ticks;     // readCycleCounter()
+    float value;
+    TraceType type;
+    uint16_t id;
+};
+
+struct TraceFileHeader
+{
+    char magic[4];          // "MDTR"
+    uint32_t version;
+    double ticksPerSecond;
+    uint64_t startTicks;
+};
+
+static constexpr uint32_t TRACE_FILE_VERSION = 1;
+
+class TraceRecorder
+{
+public:
+    static constexpr size_t CAPACITY = 1 << 14;     // events, power of two
+
+    TraceRecorder() noexcept;
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+    ~TraceRecorder();
+
+    // opens the file and starts draining, false if the file can't be created
+    bool start(const std::string& path);
+    void stop();
+    bool running() const noexcept { return m_file != nullptr; }
+
+    void record(TraceType type, uint16_t id, float value) noexcept;
+
+    // $MYMODULATION_TRACE_DIR (or the temp directory)/modtrace-<pid>-<n>.mdtr
+    static std::string defaultPath();
+private:
+    TraceEvent m_ring[CAPACITY];
+    // producer and consumer indices on their own cache lines
+    char m_pad0[64];
+    std::atomic<size_t> m_head;     // written by the audio thread
+    char m_pad1[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> m_tail;     // written by the drain thread
+    char m_pad2[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<uint32_t> m_dropped;
+
+    FILE* m_file = nullptr;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_stopSignal;
+    bool m_stop = false;
+
+    void drainLoop();
+    void drain();
+};
+
+inline void TraceRecorder::record(TraceType type, uint16_t id, float value) noexcept
+{
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) >= CAPACITY) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    TraceEvent& e = m_ring[head & (CAPACITY - 1)];
+    e.ticks = readCycleCounter();
+    e.value = value;
+    e.type = type;
+    e.id = id;
+    m_head.store(head + 1, std::memory_order_release);
+}
+
+#endif // TRACE_H
@@ -0,0 +1,32 @@
+#ifndef USER_LFO_H
+#define USER_LFO_H
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+// User drawn LFO shapes: one cycle in USER_LFO_SIZE points, bipolar [-1, 1],
+// the resolution of the built-in wavetables. Whatever the source (a curve from
+// an editor, a file), it's resampled to this before it gets near the DSP.
+
+static constexpr size_t USER_LFO_SIZE = 1024;
+typedef std::array<float, USER_LFO_SIZE> UserLfoTable;
+
+namespace user_lfo
+{
+
+// count >= 2 points spread evenly over one cycle (the last one doesn't repeat
+// the first), linearly resampled and scaled down if they go beyond [-1, 1]
+bool resample(const float* points, size_t count, UserLfoTable& table) noexcept;
+
+// text file of numbers separated by whitespace or commas, '#' to end of line is a comment
+bool loadFile(const char* path, std::vector<float>& points);
+
+void fillSine(UserLfoTable& table) noexcept;
+
+// sine, for oscillators that haven't been given a table yet
+const UserLfoTable& defaultTable() noexcept;
+
+} // namespace user_lfo
+
+#endif // USER_LFO_H
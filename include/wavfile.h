@@ -0,0 +1,103 @@
+#ifndef WAVFILE_H
+#define WAVFILE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Streaming WAV/RF64 reader/writer for the offline tools, no SDK dependency.
+// Samples are exchanged as non-interleaved float buffers and memory use is
+// constant regardless of file length:
+//  - WavReader maps a sliding window of the file, decodes straight from the
+//    mapping into the caller's buffers and asks the OS to read the next window
+//    ahead while the current one is being processed.
+//  - WavWriter encodes into one of two fixed buffers while a background thread
+//    writes the other, and upgrades the header to RF64 past 4 GB.
+
+enum class SampleFormat {PCM16, PCM24, PCM32, FLOAT32, FLOAT64};
+
+class WavReader
+{
+    static constexpr size_t WINDOW_SIZE = 16u << 20;
+#if defined(_WIN32)
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#else
+    int m_fd = -1;
+#endif
+    const uint8_t* m_window = nullptr;
+    uint64_t m_windowOffset = 0, m_windowSize = 0;
+    uint64_t m_fileSize = 0, m_dataOffset = 0, m_position = 0;
+    bool m_prefetched = false;
+    SampleFormat m_format = SampleFormat::PCM16;
+    int m_numChannels = 0;
+    double m_sampleRate = 0.0;
+    uint64_t m_numFrames = 0, m_framesLeft = 0;
+    size_t m_frameBytes = 0;
+
+    bool mapWindow(uint64_t offset) noexcept;
+    void unmapWindow() noexcept;
+    void prefetch(uint64_t offset, uint64_t size) noexcept;
+    bool parseHeader() noexcept;
+public:
+    WavReader() = default;
+    WavReader(const WavReader&) = delete;
+    WavReader& operator=(const WavReader&) = delete;
+    ~WavReader() { close(); }
+    bool open(const std::string& path);
+    void close() noexcept;
+    // returns the number of frames read, 0 at the end of the data chunk
+    size_t read(float* const* dst, size_t maxFrames);
+    int numChannels() const noexcept { return m_numChannels; }
+    double sampleRate() const noexcept { return m_sampleRate; }
+    uint64_t numFrames() const noexcept { return m_numFrames; }
+    SampleFormat format() const noexcept { return m_format; }
+};
+
+class WavWriter
+{
+    static constexpr size_t BUFFER_SIZE = 1u << 20;
+    FILE* m_file = nullptr;
+    SampleFormat m_format = SampleFormat::FLOAT32;
+    int m_numChannels = 0;
+    uint64_t m_numFrames = 0;
+    size_t m_frameBytes = 0;
+
+    std::vector<uint8_t> m_buffers[2];
+    size_t m_fill = 0;          // bytes encoded into m_buffers[m_current]
+    int m_current = 0;
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    size_t m_pending = 0;       // bytes of m_buffers[m_current ^ 1] not yet on disk
+    bool m_stop = false;
+    bool m_ioError = false;
+
+    void flushBuffer();
+    void writerThread();
+public:
+    WavWriter() = default;
+    WavWriter(const WavWriter&) = delete;
+    WavWriter& operator=(const WavWriter&) = delete;
+    ~WavWriter() { close(); }
+    bool open(const std::string& path, int numChannels, double sampleRate,
+              SampleFormat format = SampleFormat::FLOAT32);
+    bool write(const float* const* src, size_t numFrames);
+    // flushes and patches the chunk sizes, returns false if anything failed to hit the disk
+    bool close() noexcept;
+    uint64_t numFrames() const noexcept { return m_numFrames; }
+};
+
+size_t bytesPerSample(SampleFormat) noexcept;
+// converts interleaved raw samples to non-interleaved floats and back,
+// offset is in frames into the float buffers
+void decodeSamples(const uint8_t* src, SampleFormat, int numChannels, float* const* dst,
+                   size_t offset, size_t numFrames) noexcept;
+void encodeSamples(const float* const* src, SampleFormat, int numChannels, uint8_t* dst,
+                   size_t offset, size_t numFrames) noexcept;
+
+#endif // WAVFILE_H
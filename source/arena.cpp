@@ -0,0 +1,193 @@
+#include "../include/arena.h"
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+void* alignedAllocate(size_t bytes)
+{
+#ifdef MYMODULATION_SLAB_POOL
+    return SlabPool::instance().allocate(bytes);
+#else
+    void* p = nullptr;
+#if defined(_WIN32)
+    p = _aligned_malloc(DspArena::roundUp(bytes), DspArena::ALIGNMENT);
+#else
+    if (posix_memalign(&p, DspArena::ALIGNMENT, DspArena::roundUp(bytes)) != 0)
+        p = nullptr;
+#endif
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+#endif
+}
+
+void alignedFree(void* p, size_t bytes) noexcept
+{
+    if (!p)
+        return;
+#ifdef MYMODULATION_SLAB_POOL
+    SlabPool::instance().deallocate(p, bytes);
+#elif defined(_WIN32)
+    (void)bytes;
+    _aligned_free(p);
+#else
+    (void)bytes;
+    free(p);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+DspArena::DspArena(size_t bytes) : m_capacity(roundUp(bytes))
+{
+    m_data = static_cast<char*>(alignedAllocate(m_capacity));
+}
+
+DspArena::DspArena(DspArena&& other) noexcept : m_data(other.m_data),
+                                                m_capacity(other.m_capacity),
+                                                m_used(other.m_used)
+{
+    other.m_data = nullptr;
+    other.m_capacity = other.m_used = 0;
+}
+
+DspArena& DspArena::operator=(DspArena&& other) noexcept
+{
+    if (this != &other) {
+        alignedFree(m_data, m_capacity);
+        m_data = other.m_data;
+        m_capacity = other.m_capacity;
+        m_used = other.m_used;
+        other.m_data = nullptr;
+        other.m_capacity = other.m_used = 0;
+    }
+    return *this;
+}
+
+DspArena::~DspArena()
+{
+    alignedFree(m_data, m_capacity);
+}
+
+//-----------------------------------------------------------------------------
+SlabPool& SlabPool::instance()
+{
+    static SlabPool pool;
+    return pool;
+}
+
+int SlabPool::sizeClass(size_t bytes) noexcept
+{
+    int c = 0;
+    size_t size = MIN_BLOCK;
+    while (size < bytes && c < NUM_CLASSES - 1) {
+        size <<= 1;
+        ++c;
+    }
+    return c;
+}
+
+// huge pages first, then transparent huge pages (Linux), then plain pages
+void* SlabPool::map(size_t bytes)
+{
+#if defined(_WIN32)
+    const SIZE_T large = GetLargePageMinimum();
+    if (large && bytes % large == 0) {
+        void* p = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (p) {
+            m_stats.hugePages = true;
+            return p;
+        }
+    }
+    return VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+#if defined(MAP_HUGETLB)
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        m_stats.hugePages = true;
+        return p;
+    }
+#endif
+    p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+        return nullptr;
+#if defined(MADV_HUGEPAGE)
+    if (madvise(p, bytes, MADV_HUGEPAGE) == 0)
+        m_stats.hugePages = true;
+#endif
+    return p;
+#endif
+}
+
+void* SlabPool::allocate(size_t bytes)
+{
+    const int c = sizeClass(bytes);
+    const size_t size = MIN_BLOCK << c;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.liveBytes += size;
+    if (!m_free[c].empty()) {
+        void* p = m_free[c].back();
+        m_free[c].pop_back();
+        return p;
+    }
+    void* p = nullptr;
+    if (size >= SLAB_SIZE / 4) {
+        // big blocks get a mapping of their own
+        p = map(size);
+        if (p)
+            m_stats.slabBytes += size;
+    }
+    else {
+        if (!m_slab || m_slabUsed + size > SLAB_SIZE) {
+            // what's left of the old slab is cut into free blocks
+            while (m_slab && SLAB_SIZE - m_slabUsed >= MIN_BLOCK) {
+                int rest = sizeClass(SLAB_SIZE - m_slabUsed);
+                if ((MIN_BLOCK << rest) > SLAB_SIZE - m_slabUsed)
+                    --rest;
+                m_free[rest].push_back(m_slab + m_slabUsed);
+                m_slabUsed += MIN_BLOCK << rest;
+            }
+            m_slab = static_cast<char*>(map(SLAB_SIZE));
+            m_slabUsed = 0;
+            if (m_slab)
+                m_stats.slabBytes += SLAB_SIZE;
+        }
+        if (m_slab) {
+            // every size class is a multiple of 64 and slabs start page aligned
+            p = m_slab + m_slabUsed;
+            m_slabUsed += size;
+        }
+    }
+    if (!p) {
+        m_stats.liveBytes -= size;
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void SlabPool::deallocate(void* p, size_t bytes) noexcept
+{
+    if (!p)
+        return;
+    const int c = sizeClass(bytes);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.liveBytes -= MIN_BLOCK << c;
+    try {
+        m_free[c].push_back(p);
+    }
+    catch (...) {
+        // the block is lost to the pool, but nothing breaks
+    }
+}
+
+SlabPool::Stats SlabPool::stats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
@@ -0,0 +1,29 @@
+#include "../include/cyclecounter.h"
+
+namespace
+{
+
+double calibrate() noexcept
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    using clock = std::chrono::steady_clock;
+    const clock::time_point t0 = clock::now();
+    const uint64_t c0 = readCycleCounter();
+    clock::time_point t1;
+    do {
+        t1 = clock::now();
+    } while (t1 - t0 < std::chrono::milliseconds(20));
+    const uint64_t c1 = readCycleCounter();
+    return static_cast<double>(c1 - c0) / std::chrono::duration<double>(t1 - t0).count();
+#else
+    return 1e9;
+#endif
+}
+
+} // namespace
+
+double cycleCounterFrequency() noexcept
+{
+    static const double frequency = calibrate();
+    return frequency;
+}
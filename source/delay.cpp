@@ -1,33 +1,52 @@
 #include "../include/delay.h"
 
-DelayFractional::DelayFractional(double sr) : extFB(0.0f)
+DelayFractional::DelayFractional(double sr) : extFB(0.0f),
+                                              samplesPerMs(static_cast<float>(sr) / 1000.0f)
 {
-    delay_buff_size = findNextPow2(static_cast<size_t>(sr*2.0));	// sr*2 = 2 sec
+    delay_buff_size = storageFloats(sr) / 2;
     delay_buff_mask = delay_buff_size - 1;
-    delayBuffer[0] = std::make_unique<std::vector<float>>(delay_buff_size);
-    delayBuffer[1] = std::make_unique<std::vector<float>>(delay_buff_size);
+    delayBuffer[0] = delayBuffer[1] = nullptr;
     memset(&dCoeffs, 0, sizeof(DCoeffs));
     memset(mWriteIndex, 0, sizeof (size_t)*2);
+    memset(mReadIndex, 0, sizeof (size_t)*2);
+    memset(mHistory, 0, sizeof (size_t)*2);
     memset(delayFraction, 0, sizeof (float)*2);
 }
 
-void DelayFractional::updateDelay(float* buffer, int ch) noexcept
+// both channels, next power of two above 2 sec each
+size_t DelayFractional::storageFloats(double sr) noexcept
 {
-    const float xn = *buffer;
-    float yn = 0.0f;
-    calculateYn(xn, yn, ch);
-    delayBuffer[ch]->at(mWriteIndex[ch]) = xn + yn * dCoeffs.mFb;
-    *buffer = dCoeffs.mDry * xn + dCoeffs.mWet * yn;
+    return 2 * findNextPow2(static_cast<size_t>(sr*2.0));
+}
 
-    updateIndices(ch);
+void DelayFractional::setStorage(float* storage) noexcept
+{
+    delayBuffer[0] = storage;
+    delayBuffer[1] = storage + delay_buff_size;
+    flushDelayBuffers();
+}
+
+// zeroes the distances mHistory + 1 .. needed behind the write head, the
+// oldest stretch a read is about to reach; each sample at most once per flush
+void DelayFractional::extendHistory(size_t needed, int ch) noexcept
+{
+    needed = std::min(needed, delay_buff_size);
+    if (needed <= mHistory[ch])
+        return;
+    const size_t count = needed - mHistory[ch];
+    const size_t first = (mWriteIndex[ch] - needed) & delay_buff_mask;
+    const size_t head = std::min(count, delay_buff_size - first);
+    memset(delayBuffer[ch] + first, 0, sizeof (float) * head);
+    memset(delayBuffer[ch], 0, sizeof (float) * (count - head));
+    mHistory[ch] = needed;
 }
 
 void DelayFractional::updateDelayCrossFB(float* buffer, int ch) noexcept
 {
     const float xn = *buffer;
     float yn = 0.0f;
-    calculateYn(xn, yn, ch);
-    delayBuffer[ch ^ 0x1]->at(mWriteIndex[ch ^ 0x1]) = xn + yn * dCoeffs.mFb;
+    calculateYn<false>(xn, yn, ch);
+    delayBuffer[ch ^ 0x1][mWriteIndex[ch ^ 0x1]] = xn + yn * dCoeffs.mFb;
     *buffer = dCoeffs.mDry * xn + dCoeffs.mWet * yn;
 
     updateIndices(ch);
@@ -37,8 +56,8 @@ void DelayFractional::updateDelayExtFB(float* buffer, int ch) noexcept
 {
     const float xn = *buffer;
     float yn = 0.0f;
-    calculateYn(xn, yn, ch);
-    delayBuffer[ch]->at(mWriteIndex[ch]) = xn + extFB;
+    calculateYn<false>(xn, yn, ch);
+    delayBuffer[ch][mWriteIndex[ch]] = xn + extFB;
     *buffer = dCoeffs.mDry * xn + dCoeffs.mWet * yn;
 
     updateIndices(ch);
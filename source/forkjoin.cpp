@@ -0,0 +1,147 @@
+#include "../include/forkjoin.h"
+#include <algorithm>
+
+#if defined(__linux__)
+#include <climits>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#pragma comment(lib, "Synchronization.lib")
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define CPU_RELAX() _mm_pause()
+#else
+#define CPU_RELAX() std::this_thread::yield()
+#endif
+
+namespace
+{
+
+void pinToCore(std::thread& t, unsigned core) noexcept
+{
+#if defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(core, &set);
+    pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+#elif defined(_WIN32)
+    SetThreadAffinityMask(t.native_handle(), static_cast<DWORD_PTR>(1) << core);
+#else
+    (void)t; (void)core;    // no hard affinity on macOS
+#endif
+}
+
+// cores are handed out round robin across all pools in the process, so
+// instances don't all pin their workers to the same few; nothing is known
+// about where the host's own threads run
+std::atomic<unsigned> nextCore {0};
+
+}   // namespace
+
+ForkJoinPool::ForkJoinPool(unsigned numWorkers, bool pinThreads)
+{
+    const unsigned numCores = std::max(1u, std::thread::hardware_concurrency());
+    m_threads.reserve(numWorkers);
+    for (unsigned i = 0; i < numWorkers; ++i) {
+        m_threads.emplace_back(&ForkJoinPool::workerLoop, this, i);
+        if (pinThreads && numCores > 1)
+            pinToCore(m_threads.back(), nextCore.fetch_add(1, std::memory_order_relaxed) % numCores);
+    }
+}
+
+ForkJoinPool::~ForkJoinPool()
+{
+    m_stop.store(true);
+    m_generation.fetch_add(1);
+    wakeAll();
+    for (auto& t : m_threads)
+        t.join();
+}
+
+void ForkJoinPool::run(Job job, void* context, int numTasks) noexcept
+{
+    if (numTasks <= 0)
+        return;
+    numTasks = std::min(numTasks, MAX_TASKS);
+    m_job = job;
+    m_context = context;
+    m_pending.store(numTasks, std::memory_order_relaxed);
+
+    const uint32_t generation = m_generation.load(std::memory_order_relaxed) + 1;
+    m_work.store((static_cast<uint64_t>(generation) << 32) | (static_cast<uint64_t>(numTasks) << 16),
+                 std::memory_order_release);
+    m_generation.store(generation);
+    if (m_parked.load() > 0)
+        wakeAll();
+
+    work(generation);
+    while (m_pending.load(std::memory_order_acquire) > 0)
+        CPU_RELAX();
+}
+
+void ForkJoinPool::work(uint32_t generation) noexcept
+{
+    uint64_t w = m_work.load(std::memory_order_acquire);
+    for (;;) {
+        const int numTasks = static_cast<int>((w >> 16) & 0xFFFF);
+        const int task = static_cast<int>(w & 0xFFFF);
+        if (static_cast<uint32_t>(w >> 32) != generation || task >= numTasks)
+            return;
+        if (!m_work.compare_exchange_weak(w, w + 1, std::memory_order_acq_rel))
+            continue;
+        // the job can't change while one of its tasks is still pending
+        m_job(m_context, task);
+        m_pending.fetch_sub(1, std::memory_order_acq_rel);
+        w = m_work.load(std::memory_order_acquire);
+    }
+}
+
+void ForkJoinPool::workerLoop(unsigned) noexcept
+{
+    uint32_t seen = m_generation.load();
+    while (!m_stop.load(std::memory_order_relaxed)) {
+        uint32_t current = m_generation.load(std::memory_order_acquire);
+        for (int spin = 0; current == seen && spin < SPIN_COUNT; ++spin) {
+            CPU_RELAX();
+            current = m_generation.load(std::memory_order_acquire);
+        }
+        if (current == seen) {
+            park(seen);
+            continue;
+        }
+        seen = current;
+        work(current);
+    }
+}
+
+void ForkJoinPool::park(uint32_t seen) noexcept
+{
+    m_parked.fetch_add(1);
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_generation), FUTEX_WAIT_PRIVATE, seen, nullptr, nullptr, 0);
+#elif defined(_WIN32)
+    WaitOnAddress(&m_generation, &seen, sizeof(seen), INFINITE);
+#else
+    std::unique_lock<std::mutex> lock(m_parkMutex);
+    m_parkCv.wait(lock, [&] { return m_generation.load() != seen; });
+#endif
+    m_parked.fetch_sub(1);
+}
+
+void ForkJoinPool::wakeAll() noexcept
+{
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_generation), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+#elif defined(_WIN32)
+    WakeByAddressAll(&m_generation);
+#else
+    { std::lock_guard<std::mutex> lock(m_parkMutex); }
+    m_parkCv.notify_all();
+#endif
+}
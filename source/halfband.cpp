@@ -0,0 +1,93 @@
+#include "../include/halfband.h"
+#include <cmath>
+
+namespace halfband
+{
+
+namespace
+{
+
+constexpr double transition = 0.04;
+constexpr double pi = 3.14159265358979323846;
+
+double accNum(double q, int order, int c)
+{
+    double acc = 0.0, term;
+    int i = 0, sign = 1;
+    do {
+        term = std::pow(q, i * (i + 1)) * std::sin((i * 2 + 1) * c * pi / order) * sign;
+        acc += term;
+        sign = -sign;
+        ++i;
+    } while (std::fabs(term) > 1e-100);
+    return acc;
+}
+
+double accDen(double q, int order, int c)
+{
+    double acc = 0.0, term;
+    int i = 1, sign = -1;
+    do {
+        term = std::pow(q, i * i) * std::cos(i * 2 * c * pi / order) * sign;
+        acc += term;
+        sign = -sign;
+        ++i;
+    } while (std::fabs(term) > 1e-100);
+    return acc;
+}
+
+struct Design
+{
+    double coefs[NUM_COEFS];
+
+    Design() noexcept
+    {
+        double k = std::tan((1.0 - transition * 2.0) * pi / 4.0);
+        k *= k;
+        const double kksqrt = std::pow(1.0 - k * k, 0.25);
+        const double e = 0.5 * (1.0 - kksqrt) / (1.0 + kksqrt);
+        const double e4 = e * e * e * e;
+        const double q = e * (1.0 + e4 * (2.0 + e4 * (15.0 + 150.0 * e4)));
+        const int order = NUM_COEFS * 2 + 1;
+        for (int i = 0; i < NUM_COEFS; ++i) {
+            const double ww = accNum(q, order, i + 1) * std::pow(q, 0.25) / (accDen(q, order, i + 1) + 0.5);
+            const double wwsq = ww * ww;
+            const double x = std::sqrt((1.0 - wwsq * k) * (1.0 - wwsq / k)) / (1.0 + wwsq);
+            coefs[i] = (1.0 - x) / (1.0 + x);
+        }
+    }
+};
+
+} // namespace
+
+const double* coefficients() noexcept
+{
+    static const Design design;
+    return design.coefs;
+}
+
+Upsampler2x::Upsampler2x() noexcept
+{
+    for (int i = 0; i < NUM_COEFS; ++i)
+        c[i] = static_cast<float>(coefficients()[i]);
+}
+
+void Upsampler2x::reset() noexcept
+{
+    for (int i = 0; i < NUM_COEFS; ++i)
+        x[i] = y[i] = 0.0f;
+}
+
+Downsampler2x::Downsampler2x() noexcept
+{
+    for (int i = 0; i < NUM_COEFS; ++i)
+        c[i] = static_cast<float>(coefficients()[i]);
+}
+
+void Downsampler2x::reset() noexcept
+{
+    for (int i = 0; i < NUM_COEFS; ++i)
+        x[i] = y[i] = 0.0f;
+}
+
+} // namespace halfband
@@ -0,0 +1,49 @@
+#include "../include/loadmeter.h"
+
+LoadMeter::LoadMeter() noexcept : m_blocks(0), m_sum(0.0f), m_max(0.0f)
+{
+    for (int i = 0; i < NUM_BINS; ++i)
+        m_bins[i].store(0, std::memory_order_relaxed);
+}
+
+void LoadMeter::prepare(double sampleRate, int32_t maxSamplesPerBlock) noexcept
+{
+    // 100% = one sample period worth of ticks per sample
+    m_percentPerTick = static_cast<float>(100.0 * sampleRate / cycleCounterFrequency());
+    m_blockBudget = maxSamplesPerBlock / sampleRate;
+    collect();
+}
+
+LoadMeter::Stats LoadMeter::snapshot() const noexcept
+{
+    Stats stats;
+    stats.blocks = m_blocks.load(std::memory_order_relaxed);
+    if (stats.blocks == 0)
+        return stats;
+    stats.mean = m_sum.load(std::memory_order_relaxed) / static_cast<float>(stats.blocks);
+    stats.max = m_max.load(std::memory_order_relaxed);
+
+    // upper edge of the bin holding the 99th percentile, capped by the real max
+    const uint32_t rank = stats.blocks - stats.blocks / 100;
+    uint32_t count = 0;
+    int bin = 0;
+    for (; bin < NUM_BINS - 1; ++bin) {
+        count += m_bins[bin].load(std::memory_order_relaxed);
+        if (count >= rank)
+            break;
+    }
+    const float edge = (bin + 1) * BIN_PERCENT;
+    stats.p99 = edge < stats.max ? edge : stats.max;
+    return stats;
+}
+
+LoadMeter::Stats LoadMeter::collect() noexcept
+{
+    const Stats stats = snapshot();
+    for (int i = 0; i < NUM_BINS; ++i)
+        m_bins[i].store(0, std::memory_order_relaxed);
+    m_blocks.store(0, std::memory_order_relaxed);
+    m_sum.store(0.0f, std::memory_order_relaxed);
+    m_max.store(0.0f, std::memory_order_relaxed);
+    return stats;
+}
@@ -1,15 +1,38 @@
 #include "../include/modulation.h"
+#include <new>
 
-Modulation::Modulation(const double sr, const double freq)
+namespace
 {
-    m_pDelay = std::make_unique<DelayFractional>(sr);
-    m_pLFO = std::make_unique<WT_Osc<1024>>(freq);
+
+size_t arenaBytes(double dspRate, int oversampling)
+{
+    size_t bytes = DspArena::roundUp(DelayFractional::storageFloats(dspRate) * sizeof(float));
+    if (oversampling > 1)
+        bytes += DspArena::roundUp(2 * sizeof(halfband::Upsampler2x))
+               + DspArena::roundUp(2 * sizeof(halfband::Downsampler2x));
+    return bytes;
 }
 
-void Modulation::update(float* buffer, const int ch) noexcept
+} // namespace
+
+// delay and LFO run at sr * oversampling, update() still takes host rate samples
+Modulation::Modulation(const double sr, const double freq, const int oversampling) :
+    m_delay(sr * (oversampling > 1 ? 2 : 1)),
+    m_lfo(freq, sr * (oversampling > 1 ? 2 : 1)),
+    m_oversampling(oversampling > 1 ? 2 : 1),
+    m_arena(arenaBytes(sr * m_oversampling, m_oversampling))
 {
-    calculateDelayOffset(ch);
-    m_pDelay->updateDelay(buffer, ch);
+    selectKernels();
+    m_delay.setStorage(m_arena.allocate<float>(DelayFractional::storageFloats(sr * m_oversampling)));
+    if (m_oversampling > 1) {
+        m_upsamplers = m_arena.allocate<halfband::Upsampler2x>(2);
+        m_downsamplers = m_arena.allocate<halfband::Downsampler2x>(2);
+        for (int ch = 0; ch < 2; ++ch) {
+            new (&m_upsamplers[ch]) halfband::Upsampler2x();
+            new (&m_downsamplers[ch]) halfband::Downsampler2x();
+        }
+        m_plain = false;
+    }
 }
 
 void Modulation::setEffectType(const int fxT, const double dw, const double fb) noexcept
@@ -18,24 +41,238 @@ void Modulation::setEffectType(const int fxT, const double dw, const double fb)
         case FLANGER :
         m_deltaDelayTime = 7.0f;
         m_chorusMask = 0x0;
-        m_pDelay->setDryWet(static_cast<float>(dw));
-        m_pDelay->setFeedback(static_cast<float>(fb));
+        m_delay.setDryWet(static_cast<float>(dw));
+        m_delay.setFeedback(static_cast<float>(fb));
         break;
         case CHORUS:
             m_deltaDelayTime = 25.0f;
             m_chorusMask = ~0x0;
-            m_pDelay->setDryWet(static_cast<float>(dw));
-            m_pDelay->setFeedback(static_cast<float>(fb));
+            m_delay.setDryWet(static_cast<float>(dw));
+            m_delay.setFeedback(static_cast<float>(fb));
             break;
         case VIBRATO :
         m_deltaDelayTime = 7.0f;
-        m_pDelay->setDryWet(1.0f);
-        m_pDelay->setFeedback(0.0f);
+        m_delay.setDryWet(1.0f);
+        m_delay.setFeedback(0.0f);
         m_chorusMask = 0x0;
         break;
     default:
         m_deltaDelayTime = 7.0f;
         m_chorusMask = 0x0;
     }
+    m_fxType = fxT;
+    selectKernels();
 }
 
+// rampDelayOffset() for a run of samples: the LFO and the step only at the
+// control points, the offsets in between are the same running sum
+template <FxType FX, Waveform WF>
+inline void Modulation::rampOffsets(float* offsets, int numSamples, const int ch) noexcept
+{
+    const uint64_t skip = static_cast<uint64_t>(m_controlRate - 1);
+    for (int i = 0; i < numSamples;) {
+        if (m_controlCount[ch] <= 0) {
+            float lfo;
+            if (m_controlCount[ch] < 0) {
+                m_lfo.generateUnipolar<WF>(&lfo, ch);
+                m_lfo.skip(skip, ch);
+                m_offset[ch] = delayOffset<FX>(lfo);
+            }
+            m_lfo.generateUnipolar<WF>(&lfo, ch);
+            m_lfo.skip(skip, ch);
+            m_offsetStep[ch] = (delayOffset<FX>(lfo) - m_offset[ch]) / static_cast<float>(m_controlRate);
+            m_controlCount[ch] = m_controlRate;
+        }
+        const int n = std::min(m_controlCount[ch], numSamples - i);
+        float offset = m_offset[ch];
+        const float step = m_offsetStep[ch];
+        for (int j = 0; j < n; ++j) {
+            offsets[i + j] = offset;
+            offset += step;
+        }
+        m_offset[ch] = offset;
+        m_controlCount[ch] -= n;
+        i += n;
+    }
+}
+
+template <FxType FX, Waveform WF>
+inline void Modulation::rampOffsetsStereo(float* offsets0, float* offsets1, int numSamples) noexcept
+{
+    const uint64_t skip = static_cast<uint64_t>(m_controlRate - 1);
+    for (int i = 0; i < numSamples;) {
+        if (m_controlCount[0] <= 0) {
+            float lfo[2];
+            if (m_controlCount[0] < 0) {
+                m_lfo.generateStereoUnipolar<WF>(&lfo[0], &lfo[1]);
+                m_lfo.skipStereo(skip);
+                m_offset[0] = delayOffset<FX>(lfo[0]);
+                m_offset[1] = delayOffset<FX>(lfo[1]);
+            }
+            m_lfo.generateStereoUnipolar<WF>(&lfo[0], &lfo[1]);
+            m_lfo.skipStereo(skip);
+            const float scale = 1.0f / static_cast<float>(m_controlRate);
+            m_offsetStep[0] = (delayOffset<FX>(lfo[0]) - m_offset[0]) * scale;
+            m_offsetStep[1] = (delayOffset<FX>(lfo[1]) - m_offset[1]) * scale;
+            m_controlCount[0] = m_controlRate;
+        }
+        const int n = std::min(m_controlCount[0], numSamples - i);
+        float offset0 = m_offset[0], offset1 = m_offset[1];
+        const float step0 = m_offsetStep[0], step1 = m_offsetStep[1];
+        for (int j = 0; j < n; ++j) {
+            offsets0[i + j] = offset0;
+            offsets1[i + j] = offset1;
+            offset0 += step0;
+            offset1 += step1;
+        }
+        m_offset[0] = offset0;
+        m_offset[1] = offset1;
+        m_controlCount[1] = m_controlCount[0] -= n;
+        i += n;
+    }
+}
+
+// nothing in the loops depends on a setting that isn't a template parameter
+// or a plain coefficient. The LFO runs ahead over a sub-block (or the ramp
+// fills it in, evaluating it every m_controlRate samples), then the delay
+// takes the sub-block in one go
+template <FxType FX, Waveform WF, bool FEEDBACK, bool RAMP, typename FloatType>
+void Modulation::kernel(Modulation& m, const FloatType* in, FloatType* out, int numSamples, const int ch) noexcept
+{
+    constexpr int BLOCK = DelayFractional::MAX_BLOCK;
+    constexpr bool WET_ONLY = FX == VIBRATO;
+    float offsets[BLOCK], block[BLOCK];
+    for (int offset = 0; offset < numSamples; offset += BLOCK) {
+        const int n = std::min(BLOCK, numSamples - offset);
+        if (RAMP) {
+            m.rampOffsets<FX, WF>(offsets, n, ch);
+        } else {
+            for (int i = 0; i < n; ++i) {
+                float lfo;
+                m.m_lfo.generateUnipolar<WF>(&lfo, ch);
+                offsets[i] = m.delayOffset<FX>(lfo);
+            }
+        }
+        for (int i = 0; i < n; ++i)
+            block[i] = static_cast<float>(in[offset + i]);
+        m.m_delay.processBlock<FEEDBACK, WET_ONLY>(block, block, offsets, n, ch);
+        for (int i = 0; i < n; ++i)
+            out[offset + i] = static_cast<FloatType>(block[i]);
+    }
+}
+
+template <FxType FX, Waveform WF, bool FEEDBACK, bool RAMP, typename FloatType>
+void Modulation::stereoKernel(Modulation& m, const FloatType* in0, const FloatType* in1,
+                              FloatType* out0, FloatType* out1, int numSamples) noexcept
+{
+    constexpr int BLOCK = DelayFractional::MAX_BLOCK;
+    constexpr bool WET_ONLY = FX == VIBRATO;
+    float offsets0[BLOCK], offsets1[BLOCK], block0[BLOCK], block1[BLOCK];
+    for (int offset = 0; offset < numSamples; offset += BLOCK) {
+        const int n = std::min(BLOCK, numSamples - offset);
+        if (RAMP) {
+            m.rampOffsetsStereo<FX, WF>(offsets0, offsets1, n);
+        } else {
+            for (int i = 0; i < n; ++i) {
+                float lfo[2];
+                m.m_lfo.generateStereoUnipolar<WF>(&lfo[0], &lfo[1]);
+                offsets0[i] = m.delayOffset<FX>(lfo[0]);
+                offsets1[i] = m.delayOffset<FX>(lfo[1]);
+            }
+        }
+        for (int i = 0; i < n; ++i) {
+            block0[i] = static_cast<float>(in0[offset + i]);
+            block1[i] = static_cast<float>(in1[offset + i]);
+        }
+        m.m_delay.processBlock<FEEDBACK, WET_ONLY>(block0, block0, offsets0, n, 0);
+        m.m_delay.processBlock<FEEDBACK, WET_ONLY>(block1, block1, offsets1, n, 1);
+        for (int i = 0; i < n; ++i) {
+            out0[offset + i] = static_cast<FloatType>(block0[i]);
+            out1[offset + i] = static_cast<FloatType>(block1[i]);
+        }
+    }
+}
+
+template <typename FloatType, FxType FX, bool FEEDBACK, bool RAMP>
+Modulation::Kernels<FloatType> Modulation::kernelsFor(Waveform wf) noexcept
+{
+    static const Kernels<FloatType> byWaveform[] = {
+        {kernel<FX, Waveform::SINE, FEEDBACK, RAMP, FloatType>,
+         stereoKernel<FX, Waveform::SINE, FEEDBACK, RAMP, FloatType>},
+        {kernel<FX, Waveform::SAW, FEEDBACK, RAMP, FloatType>,
+         stereoKernel<FX, Waveform::SAW, FEEDBACK, RAMP, FloatType>},
+        {kernel<FX, Waveform::TRIANGLE, FEEDBACK, RAMP, FloatType>,
+         stereoKernel<FX, Waveform::TRIANGLE, FEEDBACK, RAMP, FloatType>},
+        {kernel<FX, Waveform::SQUARE, FEEDBACK, RAMP, FloatType>,
+         stereoKernel<FX, Waveform::SQUARE, FEEDBACK, RAMP, FloatType>},
+        {kernel<FX, Waveform::CUSTOM, FEEDBACK, RAMP, FloatType>,
+         stereoKernel<FX, Waveform::CUSTOM, FEEDBACK, RAMP, FloatType>},
+    };
+    return byWaveform[static_cast<int>(wf)];
+}
+
+template <typename FloatType, FxType FX>
+Modulation::Kernels<FloatType> Modulation::kernelsFor(bool feedback) const noexcept
+{
+    if (m_controlRate > 1)
+        return feedback ? kernelsFor<FloatType, FX, true, true>(m_waveform)
+                        : kernelsFor<FloatType, FX, false, true>(m_waveform);
+    return feedback ? kernelsFor<FloatType, FX, true, false>(m_waveform)
+                    : kernelsFor<FloatType, FX, false, false>(m_waveform);
+}
+
+// The vibrato kernel folds in an all wet mix without feedback. That's what
+// setEffectType() sets, but the processor may still move either afterwards,
+// and then the flanger kernel (same offsets) does the job.
+template <typename FloatType>
+Modulation::Kernels<FloatType> Modulation::selectKernels() const noexcept
+{
+    const bool feedback = m_delay.getFeedback() != 0.0f;
+    if (m_fxType == CHORUS)
+        return kernelsFor<FloatType, CHORUS>(feedback);
+    if (m_fxType == VIBRATO && !feedback && m_delay.getDryWet() == 1.0f)
+        return kernelsFor<FloatType, VIBRATO>(false);
+    return kernelsFor<FloatType, FLANGER>(feedback);
+}
+
+void Modulation::selectKernels() noexcept
+{
+    m_kernels32 = selectKernels<float>();
+    m_kernels64 = selectKernels<double>();
+}
+
+void Modulation::setQuality(QualityTier tier) noexcept
+{
+    setQualitySettings(qualitySettings(tier));
+}
+
+void Modulation::setQualitySettings(const QualitySettings& q) noexcept
+{
+    const int32_t controlRate = std::max(q.lfoControlRate, 1);
+    m_cubic = q.interpolationOrder >= 3;
+    if (controlRate != m_controlRate) {
+        // the ramp keeps the LFO m_controlRate + count samples ahead; the phase
+        // arithmetic wraps, so skipping by the negated lead steps it back
+        if (m_controlRate > 1) {
+            for (int ch = 0; ch < 2; ++ch)
+                if (m_controlCount[ch] >= 0)
+                    m_lfo.skip(static_cast<uint64_t>(0) - static_cast<uint64_t>(m_controlRate + m_controlCount[ch]), ch);
+        }
+        m_controlRate = controlRate;
+        m_controlCount[0] = m_controlCount[1] = -1;
+        selectKernels();
+    }
+    m_plain = !m_cubic && m_oversampling == 1;
+}
+
+void Modulation::setParams(const ModulationParams& p) noexcept
+{
+    setDryWet(static_cast<float>(p.dryWet));
+    setFeedback(static_cast<float>(p.feedback));
+    setModDepth(p.modDepth);
+    setChorOffset(p.chorusOffset);
+    setEffectType(p.effectType, p.dryWet, p.feedback);
+    setWaveform(p.waveform);
+    setLfoFreq(p.modRate);
+    setStereoPhase(p.stereoPhase);
+}
@@ -0,0 +1,5 @@
+#include "../include/modulation_pack.h"
+
+template class ModulationPack<4>;
+template class ModulationPack<8>;
+template class ModulationPack<16>;
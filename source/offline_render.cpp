@@ -0,0 +1,96 @@
+#include "../include/offline_render.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+namespace offline_render
+{
+
+namespace
+{
+
+void renderRange(const float* const* in, float* const* out, int numChannels,
+                 size_t from, size_t start, size_t end,
+                 double sampleRate, const ModulationParams& params)
+{
+    for (int group = 0; group < numChannels; group += 2) {
+        Modulation mod(sampleRate, params.modRate);
+        mod.setParams(params);
+        mod.seekLfo(from);
+        const int groupChannels = std::min(2, numChannels - group);
+        for (int ch = 0; ch < groupChannels; ++ch) {
+            const float* src = in[group + ch];
+            float* dst = out[group + ch];
+            for (size_t i = from; i < start; ++i) {     // pre-roll, output discarded
+                float buffer = src[i];
+                mod.update(&buffer, ch);
+            }
+            for (size_t i = start; i < end; ++i) {
+                float buffer = src[i];
+                mod.update(&buffer, ch);
+                dst[i] = buffer;
+            }
+        }
+    }
+}
+
+}   // namespace
+
+size_t prerollSamples(const Modulation& mod, double sampleRate, float tailThreshold) noexcept
+{
+    // one extra sample for the interpolation, another for rounding
+    const size_t window = static_cast<size_t>(std::ceil(mod.maxDelayMs() * sampleRate * 0.001)) + 2;
+    const double fb = std::fabs(static_cast<double>(mod.getFeedback()));
+    if (fb < epsilon)
+        return window;
+    // every window the feedback path decays by |fb|, the history it starts from
+    // can be as loud as peak / (1 - |fb|)
+    const double passes = std::ceil(std::log(tailThreshold * (1.0 - fb)) / std::log(fb));
+    return window * (static_cast<size_t>(std::max(passes, 0.0)) + 1);
+}
+
+void renderSerial(const float* const* in, float* const* out, int numChannels,
+                  size_t numSamples, double sampleRate, const ModulationParams& params)
+{
+    renderRange(in, out, numChannels, 0, 0, numSamples, sampleRate, params);
+}
+
+void renderParallel(const float* const* in, float* const* out, int numChannels,
+                    size_t numSamples, double sampleRate, const ModulationParams& params,
+                    const RenderOptions& options)
+{
+    Modulation probe(sampleRate, params.modRate);
+    probe.setParams(params);
+    const size_t preroll = prerollSamples(probe, sampleRate, options.tailThreshold);
+    const size_t chunkSize = std::max(options.chunkSize, preroll * 4);
+    const size_t numChunks = (numSamples + chunkSize - 1) / chunkSize;
+
+    unsigned numThreads = options.numThreads ? options.numThreads : std::thread::hardware_concurrency();
+    numThreads = static_cast<unsigned>(std::min<size_t>(std::max(numThreads, 1u), numChunks));
+    if (numThreads <= 1) {
+        renderSerial(in, out, numChannels, numSamples, sampleRate, params);
+        return;
+    }
+
+    std::atomic<size_t> nextChunk(0);
+    auto worker = [&]() {
+        for (size_t c = nextChunk++; c < numChunks; c = nextChunk++) {
+            const size_t start = c * chunkSize;
+            const size_t end = std::min(start + chunkSize, numSamples);
+            const size_t from = start > preroll ? start - preroll : 0;
+            renderRange(in, out, numChannels, from, start, end, sampleRate, params);
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(numThreads - 1);
+    for (unsigned t = 1; t < numThreads; ++t)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& t : pool)
+        t.join();
+}
+
+}   // offline_render
@@ -35,10 +35,12 @@
 //-----------------------------------------------------------------------------
 
 #include "../include/plugcontroller.h"
+#include "../include/plugstate.h"
 
 #include "base/source/fstreamer.h"
 #include "pluginterfaces/base/ibstream.h"
 #include "pluginterfaces/base/ustring.h"
+#include <vector>
 
 namespace Steinberg {
 namespace MyModulation {
@@ -49,6 +51,8 @@ tresult PLUGIN_API PlugController::initialize (FUnknown* context)
 	tresult result = EditController::initialize (context);
 	if (result == kResultTrue)
     {
+        user_lfo::fillSine(mUserLfo);
+
         //---Create Parameters------------
         Vst::Parameter* param;
 
@@ -113,6 +117,68 @@ tresult PLUGIN_API PlugController::initialize (FUnknown* context)
         parameters.addParameter (STR16 ("Bypass"), nullptr, 1, 0,
                                  Vst::ParameterInfo::kCanAutomate | Vst::ParameterInfo::kIsBypass,
                                  MyModulationParams::kBypassID);
+        //---------------------------------
+        param = new Vst::RangeParameter(USTRING("Snapshot Morph"), MyModulationParams::kSnapshotMorphID,
+                                        USTRING(""), 0.0, 1.0, 0.0);
+        param->setPrecision(2);
+        parameters.addParameter(param);
+        //---------------------------------
+        param = new Vst::StringListParameter(USTRING("Store Snapshot"), MyModulationParams::kSnapshotStoreID,
+                                             nullptr, Vst::ParameterInfo::kIsList);
+        strParam = static_cast<Vst::StringListParameter*>(param);
+        strParam->appendString(USTRING("-"));	// 0
+        for (int slot = 0; slot < ModulationConst::NUM_SNAPSHOTS; ++slot) {
+            const char name[2] = {static_cast<char>('A' + slot), '\0'};
+            strParam->appendString(USTRING(name));
+        }
+        parameters.addParameter(param);
+        //---------------------------------
+        param = new Vst::StringListParameter(USTRING("Quality"), MyModulationParams::kQualityID,
+                                             nullptr, Vst::ParameterInfo::kIsList);
+        strParam = static_cast<Vst::StringListParameter*>(param);
+        strParam->appendString(USTRING("Auto"));	// 0
+        strParam->appendString(USTRING("Eco"));  // 1
+        strParam->appendString(USTRING("Standard")); // 2
+        strParam->appendString(USTRING("High")); // 3
+        strParam->appendString(USTRING("Ultra")); // 4
+        parameters.addParameter(param);
+        //---------------------------------
+        parameters.addParameter (STR16 ("CPU Governor"), nullptr, 1, 0,
+                                 Vst::ParameterInfo::kCanAutomate,
+                                 MyModulationParams::kGovernorID);
+        //---------------------------------
+        param = new Vst::StringListParameter(USTRING("Active Quality"), MyModulationParams::kQualityActiveID,
+                                             nullptr, Vst::ParameterInfo::kIsReadOnly | Vst::ParameterInfo::kIsList);
+        strParam = static_cast<Vst::StringListParameter*>(param);
+        strParam->appendString(USTRING("Eco"));	// 0
+        strParam->appendString(USTRING("Standard"));  // 1
+        strParam->appendString(USTRING("High")); // 2
+        strParam->appendString(USTRING("Ultra")); // 3
+        parameters.addParameter(param);
+        //---------------------------------
+        param = new Vst::RangeParameter(USTRING("Stereo Phase"), MyModulationParams::kStereoPhaseID,
+                                    USTRING("deg"), ModulationConst::STEREO_PHASE_MIN,
+                                                       ModulationConst::STEREO_PHASE_MAX,
+                                                       ModulationConst::STEREO_PHASE_DEFAULT);
+
+        param->setPrecision(0);
+        parameters.addParameter(param);
+        //---------------------------------
+        parameters.addParameter (STR16 ("Custom LFO"), nullptr, 1, 0,
+                                 Vst::ParameterInfo::kCanAutomate,
+                                 MyModulationParams::kCustomLfoID);
+        //---------------------------------
+        const Vst::ParamID loadIDs[] = {MyModulationParams::kDspLoadMeanID,
+                                        MyModulationParams::kDspLoadP99ID,
+                                        MyModulationParams::kDspLoadMaxID};
+        const char16* loadTitles[] = {STR16("DSP Load"), STR16("DSP Load p99"), STR16("DSP Load Max")};
+        for (int i = 0; i < 3; ++i) {
+            param = new Vst::RangeParameter(loadTitles[i], loadIDs[i], USTRING("%"), 0.0,
+                                            ModulationConst::LOAD_METER_MAX, 0.0, 0,
+                                            Vst::ParameterInfo::kIsReadOnly);
+            param->setPrecision(1);
+            parameters.addParameter(param);
+        }
     }
     return kResultTrue;
 }
@@ -137,52 +203,76 @@ tresult PLUGIN_API PlugController::setComponentState (IBStream* state)
     if (!state)
         return kResultFalse;
 
-    IBStreamer streamer (state, kLittleEndian);
-
-    double savedParam = 0.0;
-
-    // dry/wet
-    if (streamer.readDouble (savedParam) == false)
+    // the processor's own layout, whichever version it was saved in
+    PlugState saved;
+    if (!plug_state::read(state, saved))
         return kResultFalse;
-    setParamNormalizedFromFile(MyModulationParams::kParamDryWetID, savedParam);
 
-    // rate
-    if (streamer.readDouble (savedParam) == false)
-        return kResultFalse;
-    setParamNormalizedFromFile(MyModulationParams::kParamModulationRateID, savedParam);
-
-    // depth
-    if (streamer.readDouble (savedParam) == false)
-        return kResultFalse;
-    setParamNormalizedFromFile(MyModulationParams::kParamModulationDepthID, savedParam);
+    setParamNormalizedFromFile(MyModulationParams::kParamDryWetID, saved.dryWet);
+    setParamNormalizedFromFile(MyModulationParams::kParamModulationRateID, saved.modRate);
+    setParamNormalizedFromFile(MyModulationParams::kParamModulationDepthID, saved.modDepth);
+    setParamNormalizedFromFile(MyModulationParams::kParamModWaveformID, saved.waveform);
+    setParamNormalizedFromFile(MyModulationParams::kParamFeedbackID, saved.feedback);
+    setParamNormalizedFromFile(MyModulationParams::kParamChorusOffsetID, saved.chorusOffset);
+    setParamNormalizedFromFile(MyModulationParams::kParamEffectTypeID, saved.effectType);
+    setParamNormalized (MyModulationParams::kBypassID, saved.bypass ? 1 : 0);
+    setParamNormalizedFromFile(MyModulationParams::kSnapshotMorphID, saved.morph);
+    setParamNormalizedFromFile(MyModulationParams::kQualityID, saved.quality);
+    setParamNormalized (MyModulationParams::kGovernorID, saved.governor ? 1 : 0);
+    setParamNormalizedFromFile(MyModulationParams::kStereoPhaseID, saved.stereoPhase);
+    setParamNormalized (MyModulationParams::kCustomLfoID, saved.customLfo ? 1 : 0);
+    mUserLfo = saved.userLfo;
 
-    // depth
-    if (streamer.readDouble (savedParam) == false)
-        return kResultFalse;
-    setParamNormalizedFromFile(MyModulationParams::kParamModWaveformID, savedParam);
+    return kResultOk;
+}
 
-    // feedback
-    if (streamer.readDouble (savedParam) == false)
-        return kResultFalse;
-    setParamNormalizedFromFile(MyModulationParams::kParamFeedbackID, savedParam);
+tresult PLUGIN_API PlugController::notify (Vst::IMessage* message)
+{
+    if (!message)
+        return kInvalidArgument;
+    if (strcmp(message->getMessageID(), kDspSnapshotMessageID) == 0) {
+        const void* data = nullptr;
+        uint32 size = 0;
+        if (message->getAttributes()->getBinary(kDspSnapshotAttr, data, size) != kResultOk
+            || size != sizeof(DspSnapshot))
+            return kResultFalse;
+        memcpy(&mDspSnapshots.back(), data, sizeof(DspSnapshot));
+        mDspSnapshots.publish();
+        return kResultOk;
+    }
+    return EditController::notify(message);
+}
 
-    // feedback
-    if (streamer.readDouble (savedParam) == false)
-        return kResultFalse;
-    setParamNormalizedFromFile(MyModulationParams::kParamChorusOffsetID, savedParam);
+const DspSnapshot& PlugController::dspSnapshot()
+{
+    mDspSnapshots.update();
+    return mDspSnapshots.front();
+}
 
-    // feedback
-    if (streamer.readDouble (savedParam) == false)
+// resampled here so the processor gets a table of the final size
+tresult PlugController::sendUserLfo(const float* points, size_t count)
+{
+    UserLfoTable table;
+    if (!user_lfo::resample(points, count, table))
+        return kInvalidArgument;
+    IPtr<Vst::IMessage> message = owned(allocateMessage());
+    if (!message)
         return kResultFalse;
-    setParamNormalizedFromFile(MyModulationParams::kParamEffectTypeID, savedParam);
+    message->setMessageID(kUserLfoMessageID);
+    message->getAttributes()->setBinary(kUserLfoTableAttr, table.data(),
+                                        static_cast<uint32>(sizeof(UserLfoTable)));
+    const tresult result = sendMessage(message);
+    if (result == kResultOk)
+        mUserLfo = table;
+    return result;
+}
 
-    // bypass
-    int32 bypassState;
-    if (streamer.readInt32 (bypassState) == false)
+tresult PlugController::importUserLfo(const char* path)
+{
+    std::vector<float> points;
+    if (!user_lfo::loadFile(path, points))
         return kResultFalse;
-    setParamNormalized (MyModulationParams::kBypassID, bypassState ? 1 : 0);
-
-    return kResultOk;
+    return sendUserLfo(points.data(), points.size());
 }
 
 tresult PlugController::setParamNormalizedFromFile(Vst::ParamID tag, Vst::ParamValue value)
@@ -36,21 +36,63 @@
 
 #include "../include/plugprocessor.h"
 #include "../include/plugids.h"
+#include "../include/plugstate.h"
 
 #include "base/source/fstreamer.h"
 #include "pluginterfaces/base/ibstream.h"
 #include "pluginterfaces/base/ustring.h"
 #include "base/source/fstreamer.h"
 #include "pluginterfaces/vst/ivstparameterchanges.h"
+#include <chrono>
 
 namespace Steinberg {
 namespace MyModulation {
 
 void processAudio32(Vst::ProcessData &data, int32 numChannels, PlugProcessor* processor);
 void processAudio64(Vst::ProcessData &data, int32 numChannels, PlugProcessor* processor);
+void processChannels32(Vst::ProcessData &data, int32 first, int32 last, PlugProcessor* processor);
+void processChannels64(Vst::ProcessData &data, int32 first, int32 last, PlugProcessor* processor);
+
+#ifdef MYMODULATION_PARALLEL_CHANNELS
+static constexpr bool PARALLEL_CHANNELS = true;
+#else
+static constexpr bool PARALLEL_CHANNELS = false;
+#endif
+// pinned workers pile up on the same cores once a few instances run, the
+// scheduler places them better unless the machine is set up for it
+#ifdef MYMODULATION_PIN_WORKERS
+static constexpr bool PIN_WORKERS = true;
+#else
+static constexpr bool PIN_WORKERS = false;
+#endif
+// below this many samples per block (all channels together) the fork-join costs more than it saves
+static constexpr int32 PARALLEL_MIN_SAMPLES = 512;
+static constexpr int32 PARALLEL_MIN_BLOCK = 8;
+static constexpr double LOAD_PUBLISH_SECONDS = 0.25;
+// while morphing, the smoothers step once per CONTROL_BLOCK samples
+static constexpr int32 CONTROL_BLOCK = 32;
+static constexpr double SNAPSHOT_SMOOTHING_MS = 30.0;
+// governor, on the p99 block time of each load window in percent of the block
+// period: step a tier down above the first, back up after RECOVER_WINDOWS
+// windows in a row below the second
+static constexpr float GOVERNOR_STEP_DOWN_PERCENT = 25.0f;
+static constexpr float GOVERNOR_STEP_UP_PERCENT = 10.0f;
+static constexpr int GOVERNOR_RECOVER_WINDOWS = 8;
+// DSP snapshots go to the controller this often
+static constexpr double SNAPSHOT_SEND_HZ = 30.0;
+
+#ifdef MYMODULATION_TRACE
+#define TRACE_EVENT(type, id, value) m_trace->record(TraceType::type, static_cast<uint16_t>(id), static_cast<float>(value))
+#else
+#define TRACE_EVENT(type, id, value) ((void)0)
+#endif
+Vst::ParamValue PlugProcessor::* const PlugProcessor::smoothedMembers[NUM_SMOOTHED] = {
+    &PlugProcessor::mDryWet, &PlugProcessor::mModRate, &PlugProcessor::mModDepth,
+    &PlugProcessor::mFeedback, &PlugProcessor::mChorusOffset
+};
+
 //-----------------------------------------------------------------------------
-PlugProcessor::PlugProcessor () : m_pMod(nullptr),
-                                  mDryWet(ModulationConst::DRY_WET_DEFAULT),
+PlugProcessor::PlugProcessor () : mDryWet(ModulationConst::DRY_WET_DEFAULT),
                                   mModRate(ModulationConst::RATE_DEFAULT),
                                   mModDepth(ModulationConst::DEPTH_DEFAULT),
                                   mFeedback(ModulationConst::FEEDBACK_DEFAULT),
@@ -61,6 +103,13 @@ PlugProcessor::PlugProcessor () : m_pMod(nullptr),
 {
 	// register its editor class
     setControllerClass (MyControllerUID);
+    for (int i = 0; i < NUM_SMOOTHED; ++i)
+        m_morphTarget[i] = this->*smoothedMembers[i];
+    user_lfo::fillSine(m_userTables[0]);
+    user_lfo::fillSine(m_userTables[1]);
+#ifdef MYMODULATION_TRACE
+    m_trace = std::make_unique<TraceRecorder>();
+#endif
 }
 
 //-----------------------------------------------------------------------------
@@ -79,6 +128,30 @@ tresult PLUGIN_API PlugProcessor::initialize (FUnknown* context)
 	return kResultTrue;
 }
 
+//-----------------------------------------------------------------------------
+tresult PLUGIN_API PlugProcessor::terminate ()
+{
+    m_active = false;
+    updateSnapshotSender();
+    return AudioEffect::terminate();
+}
+
+// the timer only runs while there's a peer, and is stopped before it goes away
+tresult PLUGIN_API PlugProcessor::connect (Vst::IConnectionPoint* other)
+{
+    const tresult result = AudioEffect::connect(other);
+    m_peerConnected = (result == kResultTrue);
+    updateSnapshotSender();
+    return result;
+}
+
+tresult PLUGIN_API PlugProcessor::disconnect (Vst::IConnectionPoint* other)
+{
+    m_peerConnected = false;
+    updateSnapshotSender();
+    return AudioEffect::disconnect(other);
+}
+
 //-----------------------------------------------------------------------------
 tresult PLUGIN_API PlugProcessor::setBusArrangements (Vst::SpeakerArrangement* inputs,
                                                             int32 numIns,
@@ -105,9 +178,13 @@ tresult PLUGIN_API PlugProcessor::setupProcessing (Vst::ProcessSetup& setup)
 {
 	// here you get, with setup, information about:
 	// sampleRate, processMode, maximum number of samples per audio block
-    audio_tools::SAMPLE_RATE = setup.sampleRate;
-    audio_tools::BUFFER_SIZE = setup.maxSamplesPerBlock;
-	return AudioEffect::setupProcessing (setup);
+    m_loadMeter.prepare(setup.sampleRate, setup.maxSamplesPerBlock);
+    m_loadPublishSamples = static_cast<int32>(setup.sampleRate * LOAD_PUBLISH_SECONDS);
+    m_loadPublishCountdown = m_loadPublishSamples;
+    for (int i = 0; i < NUM_SMOOTHED; ++i)
+        m_smoothers[i] = audio_tools::ParamSmoothing<double>(setup.sampleRate / CONTROL_BLOCK,
+                                                             SNAPSHOT_SMOOTHING_MS, this->*smoothedMembers[i]);
+    return AudioEffect::setupProcessing (setup);
 }
 
 //-----------------------------------------------------------------------------
@@ -122,14 +199,49 @@ tresult PLUGIN_API PlugProcessor::setActive (TBool state)
 
     if (state) // Initialize
 	{
-		// Allocate Memory Here
-        m_pMod = std::make_unique<Modulation>(audio_tools::SAMPLE_RATE, mModRate);
-        m_pMod->setDryWet(static_cast<float>(mDryWet));
-        m_pMod->setFeedback(static_cast<float>(mFeedback));
-        m_pMod->setModDepth(mModDepth);
-        m_pMod->setChorOffset(mChorusOffset);
-        m_pMod->setEffectType(mEffectType, mDryWet, mFeedback);
-        m_pMod->setWaveform(mWaveform);
+        const auto activationStart = std::chrono::steady_clock::now();
+        const size_t numPairs = static_cast<size_t>(numChannels + 1) / 2;
+
+        // a glide cut off by the deactivation lands on its target
+        if (m_smoothing) {
+            for (int i = 0; i < NUM_SMOOTHED; ++i)
+                this->*smoothedMembers[i] = m_morphTarget[i];
+            m_smoothing = false;
+        }
+
+        // the oversampling factor is fixed per activation, the rest of the tier can change any time
+        const int oversampling = qualitySettings(selectedTier()).oversampling;
+        if (m_mods.size() == numPairs && m_dspSampleRate == processSetup.sampleRate
+            && m_mods.front()->oversampling() == oversampling) {
+            // same configuration, keep the buffers and only clear the state
+            for (auto& mod : m_mods)
+                mod->reset();
+        }
+        else {
+            // Allocate Memory Here
+            m_mods.clear();
+            for (size_t pair = 0; pair < numPairs; ++pair)
+                m_mods.push_back(std::make_unique<Modulation>(processSetup.sampleRate, mModRate, oversampling));
+            m_dspSampleRate = processSetup.sampleRate;
+            ++m_activationStats.reallocations;
+        }
+        setAll(&Modulation::setParams, currentParams());
+        setAll(&Modulation::setUserTable, &m_userTables[m_userTableState.load(std::memory_order_acquire) & USER_TABLE_FRONT]);
+        m_governorSteps = 0;
+        m_governorCalmWindows = 0;
+        applyQuality();
+        m_numChannels = numChannels;
+        m_subIn32.assign(numChannels, nullptr);
+        m_subOut32.assign(numChannels, nullptr);
+        m_subIn64.assign(numChannels, nullptr);
+        m_subOut64.assign(numChannels, nullptr);
+
+        const unsigned numCores = std::thread::hardware_concurrency();
+        const unsigned numWorkers = std::min<unsigned>(numPairs - 1, numCores > 1 ? numCores - 1 : 0);
+        if (!PARALLEL_CHANNELS || numWorkers == 0)
+            m_pool.reset();
+        else if (!m_pool || m_pool->numWorkers() != numWorkers)
+            m_pool = std::make_unique<ForkJoinPool>(numWorkers, PIN_WORKERS);
 
         m_isSampleSize64 = (processSetup.symbolicSampleSize == Vst::kSample64);
         if (processSetup.symbolicSampleSize == Vst::kSample64) {
@@ -140,17 +252,40 @@ tresult PLUGIN_API PlugProcessor::setActive (TBool state)
             bypassFunc = bypassed32;
             procFunc = processAudio32;
         }
+
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                                     - activationStart).count();
+        m_activationStats.lastMs = ms;
+        m_activationStats.maxMs = std::max(m_activationStats.maxMs, ms);
+        ++m_activationStats.count;
     }
 	else // Release
 	{
-		// Free Memory if still allocated
+		// buffers are kept for the next activation
 	}
+#ifdef MYMODULATION_TRACE
+    if (state)
+        m_trace->start(TraceRecorder::defaultPath());
+    else
+        m_trace->stop();
+#endif
+    m_active = (state != 0);
+    updateSnapshotSender();
 	return AudioEffect::setActive (state);
 }
 
 //-----------------------------------------------------------------------------
 tresult PLUGIN_API PlugProcessor::process (Vst::ProcessData& data)
 {
+    m_loadMeter.begin();
+    const audio_tools::DenormalGuard denormalGuard;
+    adoptUserTable();
+    TRACE_EVENT(BLOCK_BEGIN, data.numOutputs > 0 ? data.outputs[0].numChannels : 0, data.numSamples);
+#ifdef MYMODULATION_TRACE
+    const bool prevBypass = mBypass;
+    const int8 prevEffectType = mEffectType;
+#endif
+
 	//--- Read inputs parameter changes-----------
 	if (data.inputParameterChanges)
 	{
@@ -164,62 +299,126 @@ tresult PLUGIN_API PlugProcessor::process (Vst::ProcessData& data)
 				Vst::ParamValue value;
 				int32 sampleOffset;
 				int32 numPoints = paramQueue->getPointCount ();
+#ifdef MYMODULATION_TRACE
+                if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) == kResultTrue)
+                    TRACE_EVENT(PARAM, paramQueue->getParameterId (), value);
+#endif
 				switch (paramQueue->getParameterId ())
 				{
                     case MyModulationParams::kParamDryWetID :
-						if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
-						    kResultTrue)
+                        if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
+                            kResultTrue) {
                             mDryWet = audio_tools::scaleRange<double>(ModulationConst::DRY_WET_MAX,
                                                                       ModulationConst::DRY_WET_MIN,
                                                                       value);
-                            m_pMod->setDryWet(static_cast<float>(mDryWet));
+                            setAll(&Modulation::setDryWet, static_cast<float>(mDryWet));
+                            setDirect(SMOOTH_DRY_WET, mDryWet);
+                        }
                         break;
                     case MyModulationParams::kParamModulationRateID :
                         if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
-                            kResultTrue)
+                            kResultTrue) {
                             mModRate = audio_tools::scaleRange<double>(ModulationConst::RATE_MAX,
                                                                       ModulationConst::RATE_MIN,
                                                                       value);
-                            m_pMod->setLfoFreq(mModRate);
+                            setAll(&Modulation::setLfoFreq, mModRate);
+                            setDirect(SMOOTH_RATE, mModRate);
+                        }
                         break;
                     case MyModulationParams::kParamModulationDepthID :
                         if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
-                            kResultTrue)
+                            kResultTrue) {
                             mModDepth = audio_tools::scaleRange<double>(ModulationConst::DEPTH_MAX,
                                                                       ModulationConst::DEPTH_MIN,
                                                                       value);
-                            m_pMod->setModDepth(mModDepth);
+                            setAll(&Modulation::setModDepth, mModDepth);
+                            setDirect(SMOOTH_DEPTH, mModDepth);
+                        }
                         break;
                     case MyModulationParams::kParamModWaveformID :
-                    if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
-                            kResultTrue)
-                        mWaveform = std::min<int8>(static_cast<int8>(ModulationConst::NUM_WAVEFORMS * value),
-                                                      ModulationConst::NUM_WAVEFORMS - 1);
-                        m_pMod->setWaveform(mWaveform);
-                    break;
+                        if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
+                            kResultTrue) {
+                            mWaveform = std::min<int8>(static_cast<int8>(ModulationConst::NUM_WAVEFORMS * value),
+                                                          ModulationConst::NUM_WAVEFORMS - 1);
+                            setAll(&Modulation::setWaveform, lfoShape());
+                        }
+                        break;
                     case MyModulationParams::kParamFeedbackID :
                         if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
-                            kResultTrue)
+                            kResultTrue) {
                             mFeedback = audio_tools::scaleRange<double>(ModulationConst::FEEDBACK_MAX,
                                                                       ModulationConst::FEEDBACK_MIN,
                                                                       value);
-                            m_pMod->setFeedback(static_cast<float>(mFeedback));
+                            setAll(&Modulation::setFeedback, static_cast<float>(mFeedback));
+                            setDirect(SMOOTH_FEEDBACK, mFeedback);
+                        }
                         break;
                     case MyModulationParams::kParamChorusOffsetID :
                         if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
-                            kResultTrue)
+                            kResultTrue) {
                             mChorusOffset = audio_tools::scaleRange<double>(ModulationConst::CHRS_OFST_MAX,
                                                                       ModulationConst::CHRS_OFST_MIN,
                                                                       value);
-                            m_pMod->setChorOffset(mChorusOffset);
+                            setAll(&Modulation::setChorOffset, mChorusOffset);
+                            setDirect(SMOOTH_CHORUS_OFFSET, mChorusOffset);
+                        }
                         break;
                     case MyModulationParams::kParamEffectTypeID :
-                    if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
+                        if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
+                            kResultTrue) {
+                            mEffectType = std::min<int8>(static_cast<int8>(ModulationConst::NUM_FX_TYPES * value),
+                                                          ModulationConst::NUM_FX_TYPES - 1);
+                            setAll(&Modulation::setEffectType, static_cast<int>(mEffectType), mDryWet, mFeedback);
+                        }
+                        break;
+                    case MyModulationParams::kSnapshotMorphID :
+                        if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
                             kResultTrue)
-                        mEffectType = std::min<int8>(static_cast<int8>(ModulationConst::NUM_FX_TYPES * value),
-                                                      ModulationConst::NUM_FX_TYPES - 1);
-                        m_pMod->setEffectType(mEffectType, mDryWet, mFeedback);
-                    break;
+                            morphTo(value);
+                        break;
+                    case MyModulationParams::kSnapshotStoreID :
+                        // list "-", slot 1..N: storing happens on the change to a slot
+                        if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
+                            kResultTrue)
+                            storeSnapshot(std::min<int>(static_cast<int>(value * ModulationConst::NUM_SNAPSHOTS + 0.5),
+                                                        ModulationConst::NUM_SNAPSHOTS) - 1);
+                        break;
+                    case MyModulationParams::kQualityID :
+                        // list Auto, Eco .. Ultra; oversampling follows on the next activation
+                        if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
+                            kResultTrue) {
+                            mQuality = std::min<int8>(static_cast<int8>(value * NUM_QUALITY_TIERS + 0.5),
+                                                      NUM_QUALITY_TIERS);
+                            m_governorSteps = 0;
+                            applyQuality();
+                        }
+                        break;
+                    case MyModulationParams::kGovernorID :
+                        if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
+                            kResultTrue) {
+                            mGovernor = (value > 0.5);
+                            if (!mGovernor && m_governorSteps > 0) {
+                                m_governorSteps = 0;
+                                applyQuality();
+                            }
+                        }
+                        break;
+                    case MyModulationParams::kStereoPhaseID :
+                        if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
+                            kResultTrue) {
+                            mStereoPhase = audio_tools::scaleRange<double>(ModulationConst::STEREO_PHASE_MAX,
+                                                                           ModulationConst::STEREO_PHASE_MIN,
+                                                                           value);
+                            setAll(&Modulation::setStereoPhase, mStereoPhase);
+                        }
+                        break;
+                    case MyModulationParams::kCustomLfoID :
+                        if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
+                            kResultTrue) {
+                            mCustomLfo = (value > 0.5);
+                            setAll(&Modulation::setWaveform, lfoShape());
+                        }
+                        break;
                     case MyModulationParams::kBypassID :
 						if (paramQueue->getPoint (numPoints - 1, sampleOffset, value) ==
 						    kResultTrue)
@@ -230,77 +429,438 @@ tresult PLUGIN_API PlugProcessor::process (Vst::ProcessData& data)
 		}
 	}
 
+#ifdef MYMODULATION_TRACE
+    if (mBypass != prevBypass)
+        TRACE_EVENT(BYPASS, 0, mBypass ? 1 : 0);
+    if (mEffectType != prevEffectType)
+        TRACE_EVENT(EFFECT_TYPE, 0, mEffectType);
+#endif
+
 	//--- Process Audio---------------------
 	//--- ----------------------------------
 	if (data.numInputs == 0 || data.numOutputs == 0)
 	{
 		// nothing to do
+        TRACE_EVENT(BLOCK_END, 0, 0);
 		return kResultOk;
     }
 
     if (data.numSamples > 0)
     {
-        Vst::SpeakerArrangement arr;
-        getBusArrangement (Vst::kOutput, 0, arr);
-        int32 numChannels = Vst::SpeakerArr::getChannelCount (arr);
+        // layout cached by setActive, the host's buffers can only be narrower
+        const int32 numChannels = std::min(m_numChannels, data.outputs[0].numChannels);
+        // input before it's processed, the host may have handed the same buffers for both
+        float inputPeak[2] = {0.0f, 0.0f}, outputPeak[2] = {0.0f, 0.0f};
+        if (m_isSampleSize64)
+            blockPeaks(data.inputs[0].channelBuffers64, numChannels, data.numSamples, inputPeak);
+        else
+            blockPeaks(data.inputs[0].channelBuffers32, numChannels, data.numSamples, inputPeak);
 
         if(mBypass){
             bypassFunc(data, numChannels);
+            if (m_smoothing) {
+                for (int i = 0; i < NUM_SMOOTHED; ++i)
+                    m_smoothers[i].reset(m_morphTarget[i]);
+                stepSmoothing();
+            }
+        }
+        else if (!m_smoothing)
+        {
+            renderBlock(data, numChannels);
         }
         else
         {
-            // Process Algorithm
-            procFunc(data, numChannels, this);
+            for (int32 offset = 0; offset < data.numSamples; offset += CONTROL_BLOCK) {
+                if (m_smoothing)
+                    stepSmoothing();
+                const int32 n = std::min(CONTROL_BLOCK, data.numSamples - offset);
+                renderBlock(subBlock(data, offset, n), numChannels);
+            }
+        }
+
+        if (m_isSampleSize64)
+            blockPeaks(data.outputs[0].channelBuffers64, numChannels, data.numSamples, outputPeak);
+        else
+            blockPeaks(data.outputs[0].channelBuffers32, numChannels, data.numSamples, outputPeak);
+        takeDspSnapshot(inputPeak, outputPeak);
+
+        m_loadMeter.end(data.numSamples);
+        m_loadPublishCountdown -= data.numSamples;
+        if (m_loadPublishCountdown <= 0) {
+            updateLoad(data.outputParameterChanges);
+            m_loadPublishCountdown = m_loadPublishSamples;
         }
     }
+    TRACE_EVENT(BLOCK_END, 0, 0);
 	return kResultOk;
 }
 
+void PlugProcessor::renderBlock(Vst::ProcessData& data, int32 numChannels) noexcept
+{
+    if (m_pool && numChannels > 2 && data.numSamples >= PARALLEL_MIN_BLOCK
+        && data.numSamples * numChannels >= PARALLEL_MIN_SAMPLES)
+    {
+        m_forkData = &data;
+        m_forkChannels = numChannels;
+        m_pool->run(processPairTask, this, (numChannels + 1) / 2);
+    }
+    else
+    {
+        // Process Algorithm
+        procFunc(data, numChannels, this);
+    }
+}
+
+// the same block seen from offset on, through preallocated channel pointer arrays
+Vst::ProcessData& PlugProcessor::subBlock(Vst::ProcessData& data, int32 offset, int32 numSamples) noexcept
+{
+    m_subData = data;
+    m_subData.numSamples = numSamples;
+    m_subInput = data.inputs[0];
+    m_subOutput = data.outputs[0];
+    const int32 numChannels = std::min<int32>(data.outputs[0].numChannels, static_cast<int32>(m_subOut32.size()));
+    if (m_isSampleSize64) {
+        for (int32 ch = 0; ch < numChannels; ++ch) {
+            m_subIn64[ch] = data.inputs[0].channelBuffers64[ch] + offset;
+            m_subOut64[ch] = data.outputs[0].channelBuffers64[ch] + offset;
+        }
+        m_subInput.channelBuffers64 = m_subIn64.data();
+        m_subOutput.channelBuffers64 = m_subOut64.data();
+    }
+    else {
+        for (int32 ch = 0; ch < numChannels; ++ch) {
+            m_subIn32[ch] = data.inputs[0].channelBuffers32[ch] + offset;
+            m_subOut32[ch] = data.outputs[0].channelBuffers32[ch] + offset;
+        }
+        m_subInput.channelBuffers32 = m_subIn32.data();
+        m_subOutput.channelBuffers32 = m_subOut32.data();
+    }
+    m_subData.inputs = &m_subInput;
+    m_subData.outputs = &m_subOutput;
+    return m_subData;
+}
+
+ModulationParams PlugProcessor::currentParams() const noexcept
+{
+    ModulationParams p;
+    p.dryWet = mDryWet;
+    p.modRate = mModRate;
+    p.modDepth = mModDepth;
+    p.feedback = mFeedback;
+    p.chorusOffset = mChorusOffset;
+    p.waveform = lfoShape();
+    p.effectType = mEffectType;
+    p.stereoPhase = mStereoPhase;
+    return p;
+}
+
+void PlugProcessor::storeSnapshot(int slot) noexcept
+{
+    if (slot < 0 || slot >= ModulationConst::NUM_SNAPSHOTS)
+        return;
+    m_snapshots[slot] = currentParams();
+    m_snapshotsStored |= 1 << slot;
+}
+
+// morph spans the stored slots: 0 = first, 1 = last. Continuous parameters
+// are interpolated and glide there through the smoothers, waveform and effect
+// type switch at the midpoint between two slots. Slots never stored are
+// skipped, with none stored the current settings stay as they are.
+void PlugProcessor::morphTo(Vst::ParamValue morph) noexcept
+{
+    mMorph = morph;
+    int slots[ModulationConst::NUM_SNAPSHOTS];
+    int numStored = 0;
+    for (int i = 0; i < ModulationConst::NUM_SNAPSHOTS; ++i)
+        if (m_snapshotsStored & (1 << i))
+            slots[numStored++] = i;
+    if (numStored == 0)
+        return;
+    const double pos = std::min(std::max(morph, 0.0), 1.0) * (numStored - 1);
+    const int lo = std::min(static_cast<int>(pos), std::max(numStored - 2, 0));
+    const double t = numStored > 1 ? pos - lo : 0.0;
+    const ModulationParams& a = m_snapshots[slots[lo]];
+    const ModulationParams& b = m_snapshots[slots[std::min(lo + 1, numStored - 1)]];
+    m_morphTarget[SMOOTH_DRY_WET] = a.dryWet + (b.dryWet - a.dryWet) * t;
+    m_morphTarget[SMOOTH_RATE] = a.modRate + (b.modRate - a.modRate) * t;
+    m_morphTarget[SMOOTH_DEPTH] = a.modDepth + (b.modDepth - a.modDepth) * t;
+    m_morphTarget[SMOOTH_FEEDBACK] = a.feedback + (b.feedback - a.feedback) * t;
+    m_morphTarget[SMOOTH_CHORUS_OFFSET] = a.chorusOffset + (b.chorusOffset - a.chorusOffset) * t;
+
+    const ModulationParams& nearest = t < 0.5 ? a : b;
+    if (nearest.waveform != lfoShape()) {
+        // slots keep the engine's shape, the custom one switches instead of replacing the waveform
+        mCustomLfo = nearest.waveform == static_cast<int>(Waveform::CUSTOM);
+        if (!mCustomLfo)
+            mWaveform = static_cast<int8>(nearest.waveform);
+        setAll(&Modulation::setWaveform, lfoShape());
+    }
+    if (nearest.effectType != mEffectType) {
+        mEffectType = static_cast<int8>(nearest.effectType);
+        setAll(&Modulation::setEffectType, static_cast<int>(mEffectType), mDryWet, mFeedback);
+    }
+
+    if (!m_smoothing)
+        for (int i = 0; i < NUM_SMOOTHED; ++i)
+            m_smoothers[i].reset(this->*smoothedMembers[i]);
+    m_smoothing = true;
+}
+
+// a host change of a single parameter overrides the morph for that parameter
+void PlugProcessor::setDirect(SmoothedParam which, double value) noexcept
+{
+    m_morphTarget[which] = value;
+    m_smoothers[which].reset(value);
+}
+
+void PlugProcessor::stepSmoothing() noexcept
+{
+    bool settled = true;
+    for (int i = 0; i < NUM_SMOOTHED; ++i) {
+        double v = m_smoothers[i].smoothParam(m_morphTarget[i]);
+        if (std::fabs(v - m_morphTarget[i]) > 1e-6 * (1.0 + std::fabs(m_morphTarget[i])))
+            settled = false;
+        else
+            m_smoothers[i].reset(v = m_morphTarget[i]);
+        this->*smoothedMembers[i] = v;
+    }
+    m_smoothing = !settled;
+
+    setAll(&Modulation::setLfoFreq, mModRate);
+    setAll(&Modulation::setModDepth, mModDepth);
+    setAll(&Modulation::setChorOffset, mChorusOffset);
+    // vibrato pins dry/wet and feedback
+    if (mEffectType != VIBRATO) {
+        setAll(&Modulation::setDryWet, static_cast<float>(mDryWet));
+        setAll(&Modulation::setFeedback, static_cast<float>(mFeedback));
+    }
+}
+
+// message thread (or setState): never blocks the audio thread, at worst waits for another writer
+void PlugProcessor::publishUserTable(const UserLfoTable& table)
+{
+    std::lock_guard<std::mutex> lock(m_userTableMutex);
+    // take a published table back if the audio thread hasn't adopted it yet
+    int state = m_userTableState.load(std::memory_order_acquire);
+    while ((state & USER_TABLE_PENDING)
+           && !m_userTableState.compare_exchange_weak(state, state & ~USER_TABLE_PENDING,
+                                                      std::memory_order_acq_rel, std::memory_order_acquire)) {}
+    m_userTables[(state & USER_TABLE_FRONT) ^ 1] = table;
+    m_userTableState.fetch_or(USER_TABLE_PENDING, std::memory_order_release);
+}
+
+// audio thread, once per block before anything reads the LFOs; the old front
+// isn't read after this, so it's free for the next writer
+void PlugProcessor::adoptUserTable() noexcept
+{
+    int state = m_userTableState.load(std::memory_order_acquire);
+    if (!(state & USER_TABLE_PENDING))
+        return;
+    const int front = (state & USER_TABLE_FRONT) ^ 1;
+    if (m_userTableState.compare_exchange_strong(state, front, std::memory_order_acq_rel, std::memory_order_relaxed))
+        setAll(&Modulation::setUserTable, &m_userTables[front]);
+}
+
+tresult PLUGIN_API PlugProcessor::notify (Vst::IMessage* message)
+{
+    if (!message)
+        return kInvalidArgument;
+    if (strcmp(message->getMessageID(), kUserLfoMessageID) == 0) {
+        // any number of points, checked and resampled here rather than trusted
+        const void* data = nullptr;
+        uint32 size = 0;
+        if (message->getAttributes()->getBinary(kUserLfoTableAttr, data, size) != kResultOk
+            || size % sizeof(float) != 0)
+            return kResultFalse;
+        std::vector<float> points(size / sizeof(float));
+        memcpy(points.data(), data, size);
+        UserLfoTable table;
+        if (!user_lfo::resample(points.data(), points.size(), table))
+            return kResultFalse;
+        publishUserTable(table);
+        return kResultOk;
+    }
+    return AudioEffect::notify(message);
+}
+
+// audio thread, after the block; the first pair is what a display shows
+void PlugProcessor::takeDspSnapshot(const float inputPeak[2], const float outputPeak[2]) noexcept
+{
+    const Modulation& mod = *m_mods.front();
+    DspSnapshot& snapshot = m_dspSnapshots.back();
+    for (int ch = 0; ch < 2; ++ch) {
+        snapshot.lfoPhase[ch] = mod.lfoPhase(ch);
+        snapshot.delayMs[ch] = mod.currentDelayMs(ch);
+        snapshot.inputPeak[ch] = inputPeak[ch];
+        snapshot.outputPeak[ch] = outputPeak[ch];
+    }
+    snapshot.feedback = mod.getFeedback();
+    snapshot.block = ++m_snapshotBlocks;
+    m_dspSnapshots.publish();
+}
+
+// UI thread, only the newest snapshot goes out and only if there is one
+void PlugProcessor::sendDspSnapshot()
+{
+    if (!m_dspSnapshots.update())
+        return;
+    IPtr<Vst::IMessage> message = owned(allocateMessage());
+    if (!message)
+        return;
+    message->setMessageID(kDspSnapshotMessageID);
+    message->getAttributes()->setBinary(kDspSnapshotAttr, &m_dspSnapshots.front(),
+                                        static_cast<uint32>(sizeof(DspSnapshot)));
+    sendMessage(message);
+}
+
+void PlugProcessor::onTimer(Timer* /*timer*/)
+{
+    sendDspSnapshot();
+}
+
+// called from connect/disconnect/setActive/terminate, all on the UI thread, so
+// the timer fires there too. Without a timer (no run loop) the display stays idle
+void PlugProcessor::updateSnapshotSender()
+{
+    if (m_peerConnected && m_active) {
+        if (!m_snapshotTimer)
+            m_snapshotTimer = owned(Timer::create(this, static_cast<uint32>(1000.0 / SNAPSHOT_SEND_HZ)));
+    } else if (m_snapshotTimer) {
+        m_snapshotTimer->stop();
+        m_snapshotTimer = nullptr;
+    }
+}
+
+// once per load window: feed the governor, then publish if the host takes output parameters
+void PlugProcessor::updateLoad(Vst::IParameterChanges* outParams) noexcept
+{
+    const LoadMeter::Stats stats = m_loadMeter.collect();
+    if (stats.blocks == 0)
+        return;
+    governLoad(stats);
+    if (!outParams)
+        return;
+    const Vst::ParamID ids[] = {kDspLoadMeanID, kDspLoadP99ID, kDspLoadMaxID, kQualityActiveID};
+    const double values[] = {stats.mean / ModulationConst::LOAD_METER_MAX,
+                             stats.p99 / ModulationConst::LOAD_METER_MAX,
+                             stats.max / ModulationConst::LOAD_METER_MAX,
+                             static_cast<double>(activeTier()) / (NUM_QUALITY_TIERS - 1)};
+    for (int i = 0; i < 4; ++i) {
+        int32 index = 0;
+        Vst::IParamValueQueue* queue = outParams->addParameterData(ids[i], index);
+        if (queue)
+            queue->addPoint(0, std::min(values[i], 1.0), index);
+    }
+}
+
+// Auto: offline renders get the best tier, realtime the original engine
+QualityTier PlugProcessor::selectedTier() const noexcept
+{
+    if (mQuality == 0)
+        return processSetup.processMode == Vst::kOffline ? QualityTier::ULTRA : QualityTier::STANDARD;
+    return clampTier(mQuality - 1);
+}
+
+QualityTier PlugProcessor::activeTier() const noexcept
+{
+    return clampTier(static_cast<int>(selectedTier()) - m_governorSteps);
+}
+
+// what a tier runs as here: the oversampling stays as activated
+QualitySettings PlugProcessor::runningSettings(QualityTier tier) const noexcept
+{
+    QualitySettings q = qualitySettings(tier);
+    if (!m_mods.empty())
+        q.oversampling = m_mods.front()->oversampling();
+    return q;
+}
+
+// one tier down (+1) or up (-1), to the next one that runs differently: for
+// an instance activated at 2x HIGH runs like ULTRA, so stepping down from
+// ULTRA goes straight to STANDARD and stepping up from there to ULTRA
+void PlugProcessor::stepGovernor(int step) noexcept
+{
+    auto runsLike = [this](QualityTier a, QualityTier b) {
+        const QualitySettings qa = runningSettings(a), qb = runningSettings(b);
+        return qa.interpolationOrder == qb.interpolationOrder && qa.lfoControlRate == qb.lfoControlRate
+               && qa.oversampling == qb.oversampling;
+    };
+    const QualityTier from = activeTier();
+    do
+        m_governorSteps += step;
+    while ((step > 0 ? activeTier() != QualityTier::ECO : m_governorSteps > 0) && runsLike(activeTier(), from));
+    // the top of a group that runs alike is what's reported
+    while (step < 0 && m_governorSteps > 0
+           && runsLike(clampTier(static_cast<int>(activeTier()) + 1), activeTier()))
+        --m_governorSteps;
+    applyQuality();
+}
+
+void PlugProcessor::applyQuality() noexcept
+{
+    setAll(&Modulation::setQuality, activeTier());
+}
+
+// realtime only, an offline render has all the time it needs
+void PlugProcessor::governLoad(const LoadMeter::Stats& stats) noexcept
+{
+    if (!mGovernor || processSetup.processMode == Vst::kOffline)
+        return;
+    if (stats.p99 > GOVERNOR_STEP_DOWN_PERCENT) {
+        m_governorCalmWindows = 0;
+        if (activeTier() != QualityTier::ECO)
+            stepGovernor(1);
+    }
+    else if (stats.p99 < GOVERNOR_STEP_UP_PERCENT && m_governorSteps > 0) {
+        if (++m_governorCalmWindows >= GOVERNOR_RECOVER_WINDOWS) {
+            m_governorCalmWindows = 0;
+            stepGovernor(-1);
+        }
+    }
+    else {
+        m_governorCalmWindows = 0;
+    }
+}
+
 //------------------------------------------------------------------------
 tresult PLUGIN_API PlugProcessor::setState (IBStream* state)
 {
-	if (!state)
-		return kResultFalse;
-
 	// called when we load a preset or project, the model has to be reloaded
+    PlugState saved;
+    if (!plug_state::read(state, saved))
+        return kResultFalse;
 
-	IBStreamer streamer (state, kLittleEndian);
+    mDryWet = saved.dryWet;
+    mModRate = saved.modRate;
+    mModDepth = saved.modDepth;
+    mWaveform = static_cast<int8>(saved.waveform);
+    mCustomLfo = saved.customLfo != 0;
+    mFeedback = saved.feedback;
+    mChorusOffset = saved.chorusOffset;
+    mEffectType = static_cast<int8>(saved.effectType);
+    mBypass = saved.bypass != 0;
+
+    mMorph = saved.morph;
+    for (int i = 0; i < ModulationConst::NUM_SNAPSHOTS; ++i) {
+        const PlugStateSnapshot& s = saved.snapshots[i];
+        ModulationParams& p = m_snapshots[i];
+        p.dryWet = s.dryWet;
+        p.modRate = s.modRate;
+        p.modDepth = s.modDepth;
+        p.feedback = s.feedback;
+        p.chorusOffset = s.chorusOffset;
+        p.waveform = s.waveform;
+        p.effectType = s.effectType;
+    }
+    m_snapshotsStored = saved.snapshotsStored;
+    for (int i = 0; i < NUM_SMOOTHED; ++i)
+        m_morphTarget[i] = this->*smoothedMembers[i];
+    m_smoothing = false;
 
-    double savedParam = 0.0;
-// dry/wet
-    if (streamer.readDouble(savedParam) == false)
-		return kResultFalse;
-    mDryWet = savedParam;
-// rate
-    if (streamer.readDouble(savedParam) == false)
-        return kResultFalse;
-    mModRate = savedParam;
-// rate
-    if (streamer.readDouble(savedParam) == false)
-        return kResultFalse;
-    mModDepth = savedParam;
-// Waveform type
-    int8 savedParam8 = 0;
-    if (streamer.readInt8(savedParam8) == false)
-        return kResultFalse;
-    mWaveform = savedParam8;
-// feedback
-    if (streamer.readDouble(savedParam) == false)
-        return kResultFalse;
-    mFeedback = savedParam;
-// chorusOffset
-    if (streamer.readDouble(savedParam) == false)
-        return kResultFalse;
-    mChorusOffset = savedParam;
-// Effect type
-    if (streamer.readInt8(savedParam8) == false)
-        return kResultFalse;
-    mEffectType = savedParam8;
-// bypass
-	int32 bypassState;
-	if (streamer.readInt32 (bypassState) == false)
-		return kResultFalse;
-    mBypass = bypassState;
+    mQuality = static_cast<int8>(saved.quality);
+    mGovernor = saved.governor != 0;
+    publishUserTable(saved.userLfo);
+    mStereoPhase = saved.stereoPhase;
 
     return kResultOk;
 }
@@ -309,55 +869,114 @@ tresult PLUGIN_API PlugProcessor::setState (IBStream* state)
 tresult PLUGIN_API PlugProcessor::getState (IBStream* state)
 {
 	// here we need to save the model (preset or project)
+    PlugState saved {};
+    saved.dryWet = mDryWet;
+    saved.modRate = mModRate;
+    saved.modDepth = mModDepth;
+    saved.feedback = mFeedback;
+    saved.chorusOffset = mChorusOffset;
+    saved.morph = mMorph;
+    saved.stereoPhase = mStereoPhase;
+    saved.waveform = mWaveform;
+    saved.customLfo = mCustomLfo ? 1 : 0;
+    saved.effectType = mEffectType;
+    saved.bypass = mBypass ? 1 : 0;
+    saved.quality = mQuality;
+    saved.governor = mGovernor ? 1 : 0;
+    saved.snapshotsStored = m_snapshotsStored;
+    for (int i = 0; i < ModulationConst::NUM_SNAPSHOTS; ++i) {
+        const ModulationParams& p = m_snapshots[i];
+        PlugStateSnapshot& s = saved.snapshots[i];
+        s.dryWet = p.dryWet;
+        s.modRate = p.modRate;
+        s.modDepth = p.modDepth;
+        s.feedback = p.feedback;
+        s.chorusOffset = p.chorusOffset;
+        s.waveform = p.waveform;
+        s.effectType = p.effectType;
+    }
+    {
+        // the newest table, published or not; writers are held off while copying
+        std::lock_guard<std::mutex> lock(m_userTableMutex);
+        const int userState = m_userTableState.load(std::memory_order_acquire);
+        saved.userLfo = m_userTables[(userState & USER_TABLE_PENDING) ? (userState & USER_TABLE_FRONT) ^ 1
+                                                                       : userState & USER_TABLE_FRONT];
+    }
 
-	IBStreamer streamer (state, kLittleEndian);
-    streamer.writeDouble(mDryWet);
-    streamer.writeDouble(mModRate);
-    streamer.writeDouble(mModDepth);
-    streamer.writeInt8(mWaveform);
-    streamer.writeDouble(mFeedback);
-    streamer.writeDouble(mChorusOffset);
-    streamer.writeInt8(mEffectType);
-    streamer.writeInt32 (mBypass ? 1 : 0);
-
-    return kResultOk;
+    return plug_state::write(state, saved) ? kResultOk : kResultFalse;
 }
 
 void processAudio32(Vst::ProcessData &data, int32 numChannels, PlugProcessor* processor)
 {
+    processChannels32(data, 0, numChannels, processor);
+}
 
-    for (int32 channel = 0; channel < numChannels; channel++)
+void processAudio64(Vst::ProcessData &data, int32 numChannels, PlugProcessor* processor)
+{
+    processChannels64(data, 0, numChannels, processor);
+}
+
+// first is even, pairs share one LFO; a trailing odd channel runs alone
+void processChannels32(Vst::ProcessData &data, int32 first, int32 last, PlugProcessor* processor)
+{
+
+    for (int32 channel = first; channel < last; channel += 2)
     {
-        float* inputChannel = data.inputs[0].channelBuffers32[channel];
-        float* outputChannel = data.outputs[0].channelBuffers32[channel];
+        float** inputs = data.inputs[0].channelBuffers32;
+        float** outputs = data.outputs[0].channelBuffers32;
 
-        processor->processAudio(inputChannel, outputChannel, data.numSamples, channel);
+        if (channel + 1 < last)
+            processor->processAudioPair(inputs[channel], inputs[channel + 1],
+                                        outputs[channel], outputs[channel + 1], data.numSamples, channel);
+        else
+            processor->processAudio(inputs[channel], outputs[channel], data.numSamples, channel);
     }
 }
 
-void processAudio64(Vst::ProcessData &data, int32 numChannels, PlugProcessor* processor)
+// first is even, pairs share one LFO; a trailing odd channel runs alone
+void processChannels64(Vst::ProcessData &data, int32 first, int32 last, PlugProcessor* processor)
 {
 
-    for (int32 channel = 0; channel < numChannels; channel++)
+    for (int32 channel = first; channel < last; channel += 2)
     {
-        double* inputChannel = data.inputs[0].channelBuffers64[channel];
-        double* outputChannel = data.outputs[0].channelBuffers64[channel];
+        double** inputs = data.inputs[0].channelBuffers64;
+        double** outputs = data.outputs[0].channelBuffers64;
 
-        processor->processAudio(inputChannel, outputChannel, data.numSamples, channel);
+        if (channel + 1 < last)
+            processor->processAudioPair(inputs[channel], inputs[channel + 1],
+                                        outputs[channel], outputs[channel + 1], data.numSamples, channel);
+        else
+            processor->processAudio(inputs[channel], outputs[channel], data.numSamples, channel);
     }
 }
 
+// one channel pair per task, each pair has its own Modulation so the tasks share nothing
+void PlugProcessor::processPairTask(void* context, int pair)
+{
+    PlugProcessor* processor = static_cast<PlugProcessor*>(context);
+    const audio_tools::DenormalGuard denormalGuard;
+    const int32 first = pair * 2;
+    const int32 last = std::min(first + 2, processor->m_forkChannels);
+    if (processor->m_isSampleSize64)
+        processChannels64(*processor->m_forkData, first, last, processor);
+    else
+        processChannels32(*processor->m_forkData, first, last, processor);
+}
+
 template<typename FloatType>
 void PlugProcessor::processAudio(FloatType *in, FloatType *out, int numSamples, int ch)
 {
-    for (int32 sample = 0; sample < numSamples; ++sample)
-    {
-        float buffer = static_cast<float>(in[sample]);
-
-        m_pMod->update(&buffer, ch);
+    // looked up once, the stores to out could otherwise alias m_mods
+    Modulation& mod = *m_mods[ch >> 1];
+    mod.process(in, out, numSamples, ch & 1);
+}
 
-        out[sample] = static_cast<FloatType>(buffer);
-    }
+template<typename FloatType>
+void PlugProcessor::processAudioPair(FloatType* in0, FloatType* in1, FloatType* out0, FloatType* out1,
+                                     int numSamples, int firstCh)
+{
+    Modulation& mod = *m_mods[firstCh >> 1];
+    mod.processStereo(in0, in1, out0, out1, numSamples);
 }
 
 //------------------------------------------------------------------------
@@ -0,0 +1,300 @@
+#include "../include/plugstate.h"
+#include "../include/quality.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <new>
+#include <vector>
+
+namespace Steinberg {
+namespace MyModulation {
+
+namespace
+{
+
+// version 1 could carry a custom shape of up to 1 << 20 points, anything
+// past this is not a state of ours
+constexpr size_t MAX_V1_SIZE = (size_t(1) << 22) + 4096;
+
+template <typename T>
+inline void fromLittleEndian(T& value) noexcept
+{
+#if BYTEORDER == kBigEndian
+    uint8 bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T));
+    std::reverse(bytes, bytes + sizeof(T));
+    memcpy(&value, bytes, sizeof(T));
+#else
+    (void)value;
+#endif
+}
+
+// converts both ways, nothing to do on little endian hosts
+void swapFields(PlugStateHeader& header) noexcept
+{
+    fromLittleEndian(header.magic);
+    fromLittleEndian(header.version);
+    fromLittleEndian(header.size);
+}
+
+void swapFields(PlugState& state) noexcept
+{
+#if BYTEORDER == kBigEndian
+    for (double* v : {&state.dryWet, &state.modRate, &state.modDepth, &state.feedback, &state.chorusOffset,
+                      &state.morph, &state.stereoPhase})
+        fromLittleEndian(*v);
+    for (int32* v : {&state.waveform, &state.effectType, &state.bypass, &state.quality, &state.governor,
+                     &state.snapshotsStored})
+        fromLittleEndian(*v);
+    for (PlugStateSnapshot& s : state.snapshots) {
+        for (double* v : {&s.dryWet, &s.modRate, &s.modDepth, &s.feedback, &s.chorusOffset})
+            fromLittleEndian(*v);
+        fromLittleEndian(s.waveform);
+        fromLittleEndian(s.effectType);
+    }
+    for (float& v : state.userLfo)
+        fromLittleEndian(v);
+    fromLittleEndian(state.customLfo);
+    fromLittleEndian(state.reserved);
+#else
+    (void)state;
+#endif
+}
+
+// the version 1 fields, in the order and widths IBStreamer wrote them
+class Reader
+{
+    const uint8* m_pos;
+    const uint8* m_end;
+public:
+    Reader(const uint8* data, size_t size) noexcept : m_pos(data), m_end(data + size) {}
+    template <typename T>
+    bool read(T& value) noexcept
+    {
+        if (static_cast<size_t>(m_end - m_pos) < sizeof(T))
+            return false;
+        memcpy(&value, m_pos, sizeof(T));
+        fromLittleEndian(value);
+        m_pos += sizeof(T);
+        return true;
+    }
+};
+
+inline double clampOr(double value, double lo, double hi, double fallback) noexcept
+{
+    return std::isnan(value) ? fallback : std::min(std::max(value, lo), hi);
+}
+
+inline int32 clampIndex(int32 value, int32 count) noexcept
+{
+    return std::min(std::max(value, 0), count - 1);
+}
+
+void sanitizeCommon(double& dryWet, double& modRate, double& modDepth, double& feedback, double& chorusOffset,
+                    int32& waveform, int32 numWaveforms, int32& effectType) noexcept
+{
+    using namespace ModulationConst;
+    dryWet = clampOr(dryWet, DRY_WET_MIN, DRY_WET_MAX, DRY_WET_DEFAULT);
+    modRate = clampOr(modRate, RATE_MIN, RATE_MAX, RATE_DEFAULT);
+    modDepth = clampOr(modDepth, DEPTH_MIN, DEPTH_MAX, DEPTH_DEFAULT);
+    feedback = clampOr(feedback, FEEDBACK_MIN, FEEDBACK_MAX, FEEDBACK_DEFAULT);
+    chorusOffset = clampOr(chorusOffset, CHRS_OFST_MIN, CHRS_OFST_MAX, CHRS_OFST_DEFAULT);
+    waveform = clampIndex(waveform, numWaveforms);
+    effectType = clampIndex(effectType, NUM_FX_TYPES);
+}
+
+// before the mask was saved a slot that was never stored held the defaults
+int32 storedByContent(const PlugState& state) noexcept
+{
+    using namespace ModulationConst;
+    int32 stored = 0;
+    for (int i = 0; i < NUM_SNAPSHOTS; ++i) {
+        const PlugStateSnapshot& s = state.snapshots[i];
+        if (s.dryWet != DRY_WET_DEFAULT || s.modRate != RATE_DEFAULT || s.modDepth != DEPTH_DEFAULT
+            || s.feedback != FEEDBACK_DEFAULT || s.chorusOffset != CHRS_OFST_DEFAULT || s.waveform != 0
+            || s.effectType != 0)
+            stored |= 1 << i;
+    }
+    return stored;
+}
+
+} // namespace
+
+namespace plug_state
+{
+
+void setDefaults(PlugState& state) noexcept
+{
+    using namespace ModulationConst;
+    memset(&state, 0, sizeof(PlugState));
+    state.dryWet = DRY_WET_DEFAULT;
+    state.modRate = RATE_DEFAULT;
+    state.modDepth = DEPTH_DEFAULT;
+    state.feedback = FEEDBACK_DEFAULT;
+    state.chorusOffset = CHRS_OFST_DEFAULT;
+    state.stereoPhase = STEREO_PHASE_DEFAULT;
+    for (PlugStateSnapshot& s : state.snapshots) {
+        s.dryWet = DRY_WET_DEFAULT;
+        s.modRate = RATE_DEFAULT;
+        s.modDepth = DEPTH_DEFAULT;
+        s.feedback = FEEDBACK_DEFAULT;
+        s.chorusOffset = CHRS_OFST_DEFAULT;
+    }
+    state.userLfo = user_lfo::defaultTable();
+}
+
+// the fast path is a single read of header and state; a version 1 state
+// usually fits in the same read, a longer one is read to the end
+bool read(IBStream* stream, PlugState& state)
+{
+    setDefaults(state);
+    if (!stream)
+        return false;
+    alignas(8) uint8 buffer[sizeof(PlugStateHeader) + sizeof(PlugState)];
+    int32 numRead = 0;
+    stream->read(buffer, static_cast<int32>(sizeof(buffer)), &numRead);
+    const size_t got = numRead > 0 ? static_cast<size_t>(numRead) : 0;
+
+    PlugStateHeader header;
+    if (got >= sizeof(header)) {
+        memcpy(&header, buffer, sizeof(header));
+        swapFields(header);
+        if (header.magic == MAGIC) {
+            const size_t known = std::min<size_t>(header.size, sizeof(PlugState));
+            if (got - sizeof(header) < known)
+                return false;
+            // the defaults go under the part that's copied in stream byte order
+            swapFields(state);
+            memcpy(&state, buffer + sizeof(header), known);
+            swapFields(state);
+            if (header.version < 3)
+                state.snapshotsStored = storedByContent(state);
+            sanitize(state);
+            return true;
+        }
+    }
+
+    // a long version 1 state takes memory; not getting it fails the read
+    try {
+        if (got < sizeof(buffer))
+            return migrateV1(buffer, got, state);
+        std::vector<uint8> bytes(buffer, buffer + got);
+        for (;;) {
+            const size_t size = bytes.size();
+            if (size >= MAX_V1_SIZE)
+                return false;
+            bytes.resize(std::min(size * 2, MAX_V1_SIZE));
+            numRead = 0;
+            stream->read(bytes.data() + size, static_cast<int32>(bytes.size() - size), &numRead);
+            bytes.resize(size + (numRead > 0 ? static_cast<size_t>(numRead) : 0));
+            if (bytes.size() == size)
+                break;
+        }
+        return migrateV1(bytes.data(), bytes.size(), state);
+    }
+    catch (const std::bad_alloc&) {
+        return false;
+    }
+}
+
+bool write(IBStream* stream, const PlugState& state)
+{
+    if (!stream)
+        return false;
+    struct Image
+    {
+        PlugStateHeader header;
+        PlugState state;
+    } image;
+    static_assert(sizeof(Image) == sizeof(PlugStateHeader) + sizeof(PlugState), "written as one block");
+    image.header.magic = MAGIC;
+    image.header.version = VERSION;
+    image.header.size = static_cast<uint32>(sizeof(PlugState));
+    image.state = state;
+    image.state.reserved = 0;
+    swapFields(image.header);
+    swapFields(image.state);
+    int32 written = 0;
+    stream->write(&image, static_cast<int32>(sizeof(image)), &written);
+    return written == static_cast<int32>(sizeof(image));
+}
+
+// the fields up to bypass were always written, the sections after it were
+// added over time and are optional: a state ending before one is complete
+bool migrateV1(const uint8* data, size_t size, PlugState& state)
+{
+    Reader in(data, size);
+    int8 waveform = 0, effectType = 0;
+    int32 bypass = 0;
+    if (!in.read(state.dryWet) || !in.read(state.modRate) || !in.read(state.modDepth) || !in.read(waveform)
+        || !in.read(state.feedback) || !in.read(state.chorusOffset) || !in.read(effectType) || !in.read(bypass))
+        return false;
+    state.waveform = waveform;
+    state.effectType = effectType;
+    state.bypass = bypass != 0;
+
+    bool ok = true;
+    double morph = 0.0;
+    int32 numSnapshots = 0;
+    if (in.read(morph) && in.read(numSnapshots)) {
+        state.morph = morph;
+        for (int32 i = 0; i < numSnapshots && ok; ++i) {
+            PlugStateSnapshot s;
+            int8 w = 0, e = 0;
+            ok = in.read(s.dryWet) && in.read(s.modRate) && in.read(s.modDepth) && in.read(s.feedback)
+                 && in.read(s.chorusOffset) && in.read(w) && in.read(e);
+            s.waveform = w;
+            s.effectType = e;
+            if (ok && i < ModulationConst::NUM_SNAPSHOTS)
+                state.snapshots[i] = s;
+        }
+        int8 quality = 0, governor = 0;
+        int32 numPoints = 0;
+        if (ok && in.read(quality) && in.read(governor)) {
+            state.quality = quality;
+            state.governor = governor != 0;
+            if (in.read(numPoints) && numPoints >= 2 && numPoints <= (1 << 20)) {
+                std::vector<float> points(static_cast<size_t>(numPoints));
+                for (float& v : points)
+                    ok = ok && in.read(v);
+                if (ok)
+                    user_lfo::resample(points.data(), points.size(), state.userLfo);
+                double stereoPhase = 0.0;
+                if (ok && in.read(stereoPhase))
+                    state.stereoPhase = stereoPhase;
+            }
+        }
+    }
+    state.snapshotsStored = storedByContent(state);
+    sanitize(state);
+    return ok;
+}
+
+void sanitize(PlugState& state) noexcept
+{
+    using namespace ModulationConst;
+    // the custom shape used to be the fifth waveform
+    if (state.waveform == NUM_WAVEFORMS) {
+        state.waveform = 0;
+        state.customLfo = 1;
+    }
+    state.customLfo = state.customLfo != 0;
+    sanitizeCommon(state.dryWet, state.modRate, state.modDepth, state.feedback, state.chorusOffset,
+                   state.waveform, NUM_WAVEFORMS, state.effectType);
+    state.morph = clampOr(state.morph, 0.0, 1.0, 0.0);
+    state.stereoPhase = clampOr(state.stereoPhase, STEREO_PHASE_MIN, STEREO_PHASE_MAX, STEREO_PHASE_DEFAULT);
+    state.bypass = state.bypass != 0;
+    state.quality = clampIndex(state.quality, NUM_QUALITY_TIERS + 1);
+    state.governor = state.governor != 0;
+    state.snapshotsStored &= (1 << NUM_SNAPSHOTS) - 1;
+    for (PlugStateSnapshot& s : state.snapshots)
+        sanitizeCommon(s.dryWet, s.modRate, s.modDepth, s.feedback, s.chorusOffset, s.waveform, NUM_LFO_SHAPES,
+                       s.effectType);
+    for (float& v : state.userLfo)
+        v = std::isnan(v) ? 0.0f : std::min(std::max(v, -1.0f), 1.0f);
+}
+
+} // namespace plug_state
+
+} // namespace MyModulation
+} // namespace Steinberg
@@ -0,0 +1,89 @@
+#include "../include/threadpool.h"
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(unsigned numWorkers)
+{
+    if (numWorkers == 0)
+        numWorkers = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned w = 0; w < numWorkers; ++w)
+        m_queues.emplace_back(new Queue);
+    for (unsigned w = 0; w < numWorkers; ++w)
+        m_threads.emplace_back(&WorkStealingPool::run, this, w);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto& t : m_threads)
+        t.join();
+}
+
+void WorkStealingPool::submit(Task task)
+{
+    {
+        // counted before it's visible, a worker that takes it decrements after
+        // this; workers never hold m_mutex and a queue's mutex together
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_pending;
+        ++m_queued;
+        Queue& q = *m_queues[m_nextQueue];
+        m_nextQueue = (m_nextQueue + 1) % size();
+        std::lock_guard<std::mutex> queueLock(q.mutex);
+        q.tasks.push_back(std::move(task));
+    }
+    m_wake.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this] { return m_pending == 0; });
+}
+
+bool WorkStealingPool::popOwn(unsigned worker, Task& task)
+{
+    Queue& q = *m_queues[worker];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty())
+        return false;
+    task = std::move(q.tasks.back());
+    q.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(unsigned worker, Task& task)
+{
+    for (unsigned i = 1; i < size(); ++i) {
+        Queue& q = *m_queues[(worker + i) % size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (!q.tasks.empty()) {
+            task = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::run(unsigned worker)
+{
+    for (;;) {
+        Task task;
+        if (popOwn(worker, task) || steal(worker, task)) {
+            --m_queued;
+            task(worker);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_pending == 0)
+                m_done.notify_all();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wake.wait(lock, [this] { return m_stop || m_queued > 0; });
+        if (m_stop && m_queued == 0)
+            return;
+    }
+}
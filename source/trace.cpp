@@ -0,0 +1,104 @@
+#include "../include/trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+TraceRecorder::TraceRecorder() noexcept : m_head(0), m_tail(0), m_dropped(0)
+{
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    stop();
+}
+
+bool TraceRecorder::start(const std::string& path)
+{
+    stop();
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file)
+        return false;
+
+    TraceFileHeader header;
+    memcpy(header.magic, "MDTR", 4);
+    header.version = TRACE_FILE_VERSION;
+    header.ticksPerSecond = cycleCounterFrequency();
+    header.startTicks = readCycleCounter();
+    fwrite(&header, sizeof(header), 1, m_file);
+
+    m_tail.store(m_head.load());
+    m_dropped.store(0);
+    m_stop = false;
+    m_thread = std::thread(&TraceRecorder::drainLoop, this);
+    return true;
+}
+
+void TraceRecorder::stop()
+{
+    if (!m_file)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_stopSignal.notify_one();
+    m_thread.join();
+    drain();
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+void TraceRecorder::drainLoop()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stop) {
+        m_stopSignal.wait_for(lock, std::chrono::milliseconds(10));
+        drain();
+    }
+}
+
+void TraceRecorder::drain()
+{
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    const size_t head = m_head.load(std::memory_order_acquire);
+    while (tail != head) {
+        // up to the end of the ring in one write
+        const size_t begin = tail & (CAPACITY - 1);
+        const size_t count = std::min(head - tail, CAPACITY - begin);
+        fwrite(&m_ring[begin], sizeof(TraceEvent), count, m_file);
+        tail += count;
+        m_tail.store(tail, std::memory_order_release);
+    }
+    const uint32_t dropped = m_dropped.exchange(0, std::memory_order_relaxed);
+    if (dropped) {
+        const TraceEvent e = {readCycleCounter(), static_cast<float>(dropped), TraceType::DROPPED, 0};
+        fwrite(&e, sizeof(e), 1, m_file);
+    }
+    fflush(m_file);
+}
+
+std::string TraceRecorder::defaultPath()
+{
+    static std::atomic<unsigned> counter(0);
+    const char* dir = getenv("MYMODULATION_TRACE_DIR");
+#if defined(_WIN32)
+    if (!dir) dir = getenv("TEMP");
+    const char separator = '\\';
+#else
+    if (!dir) dir = getenv("TMPDIR");
+    if (!dir) dir = "/tmp";
+    const char separator = '/';
+#endif
+    std::string path = dir ? dir : ".";
+    path += separator;
+    path += "modtrace-" + std::to_string(getpid()) + "-" + std::to_string(counter.fetch_add(1)) + ".mdtr";
+    return path;
+}
@@ -0,0 +1,78 @@
+#include "../include/user_lfo.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+namespace user_lfo
+{
+
+bool resample(const float* points, size_t count, UserLfoTable& table) noexcept
+{
+    if (!points || count < 2)
+        return false;
+    float peak = 0.0f;
+    for (size_t i = 0; i < count; ++i) {
+        if (!std::isfinite(points[i]))
+            return false;
+        peak = std::max(peak, std::fabs(points[i]));
+    }
+    // only ever scaled down, so a table already in range goes through unchanged
+    const float gain = peak > 1.0f ? 1.0f / peak : 1.0f;
+    const double step = static_cast<double>(count) / USER_LFO_SIZE;
+    for (size_t j = 0; j < USER_LFO_SIZE; ++j) {
+        const double pos = j * step;
+        const size_t i0 = static_cast<size_t>(pos);
+        const size_t i1 = (i0 + 1) % count;     // wraps to the start of the cycle
+        const float frac = static_cast<float>(pos - static_cast<double>(i0));
+        table[j] = (points[i0] + (points[i1] - points[i0]) * frac) * gain;
+    }
+    return true;
+}
+
+bool loadFile(const char* path, std::vector<float>& points)
+{
+    std::ifstream file(path);
+    if (!file)
+        return false;
+    points.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        const size_t hash = line.find('#');
+        if (hash != std::string::npos)
+            line.erase(hash);
+        const char* p = line.c_str();
+        for (;;) {
+            while (*p == ' ' || *p == '\t' || *p == ',' || *p == '\r')
+                ++p;
+            if (!*p)
+                break;
+            char* end = nullptr;
+            const float v = std::strtof(p, &end);
+            if (end == p)
+                return false;
+            points.push_back(v);
+            p = end;
+        }
+    }
+    return points.size() >= 2;
+}
+
+void fillSine(UserLfoTable& table) noexcept
+{
+    for (size_t j = 0; j < USER_LFO_SIZE; ++j)
+        table[j] = static_cast<float>(std::sin(6.283185307179586477 * static_cast<double>(j) / USER_LFO_SIZE));
+}
+
+const UserLfoTable& defaultTable() noexcept
+{
+    struct Sine : UserLfoTable
+    {
+        Sine() { fillSine(*this); }
+    };
+    static const Sine table;
+    return table;
+}
+
+} // namespace user_lfo
@@ -0,0 +1,500 @@
+#include "../include/wavfile.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+constexpr uint16_t WAVE_FORMAT_PCM = 0x0001;
+constexpr uint16_t WAVE_FORMAT_IEEE_FLOAT = 0x0003;
+constexpr uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
+// RIFF + JUNK (room for ds64) + fmt + data headers, the JUNK chunk becomes
+// ds64 when the file outgrows 32-bit sizes
+constexpr size_t DS64_SIZE = 28;
+constexpr size_t FMT_SIZE = 16;
+constexpr size_t HEADER_SIZE = 12 + 8 + DS64_SIZE + 8 + FMT_SIZE + 8;
+constexpr uint64_t RIFF_LIMIT = 0xFFFFFFFFu;
+
+// all readers/writers assume a little-endian host, as does the plug-in state
+template <typename T>
+inline T readLE(const uint8_t* p) noexcept
+{
+    T v;
+    memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+template <typename T>
+inline void writeLE(uint8_t* p, T v) noexcept
+{
+    memcpy(p, &v, sizeof(T));
+}
+
+bool formatFromHeader(uint16_t tag, uint16_t bits, SampleFormat& format) noexcept
+{
+    if (tag == WAVE_FORMAT_PCM) {
+        switch (bits) {
+        case 16: format = SampleFormat::PCM16; return true;
+        case 24: format = SampleFormat::PCM24; return true;
+        case 32: format = SampleFormat::PCM32; return true;
+        default: return false;
+        }
+    }
+    if (tag == WAVE_FORMAT_IEEE_FLOAT) {
+        switch (bits) {
+        case 32: format = SampleFormat::FLOAT32; return true;
+        case 64: format = SampleFormat::FLOAT64; return true;
+        default: return false;
+        }
+    }
+    return false;
+}
+
+}   // namespace
+
+size_t bytesPerSample(SampleFormat format) noexcept
+{
+    switch (format) {
+    case SampleFormat::PCM16: return 2;
+    case SampleFormat::PCM24: return 3;
+    case SampleFormat::PCM32: return 4;
+    case SampleFormat::FLOAT32: return 4;
+    case SampleFormat::FLOAT64: return 8;
+    }
+    return 0;
+}
+
+void decodeSamples(const uint8_t* src, SampleFormat format, int numChannels, float* const* dst,
+                   size_t offset, size_t numFrames) noexcept
+{
+    const size_t bps = bytesPerSample(format);
+    const size_t stride = bps * static_cast<size_t>(numChannels);
+    for (int ch = 0; ch < numChannels; ++ch) {
+        const uint8_t* p = src + bps * static_cast<size_t>(ch);
+        float* out = dst[ch] + offset;
+        switch (format) {
+        case SampleFormat::PCM16:
+            for (size_t i = 0; i < numFrames; ++i, p += stride)
+                out[i] = static_cast<float>(readLE<int16_t>(p)) * (1.0f / 32768.0f);
+            break;
+        case SampleFormat::PCM24:
+            for (size_t i = 0; i < numFrames; ++i, p += stride) {
+                const int32_t v = static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 8)
+                                                     | (static_cast<uint32_t>(p[1]) << 16)
+                                                     | (static_cast<uint32_t>(p[2]) << 24)) >> 8;
+                out[i] = static_cast<float>(v) * (1.0f / 8388608.0f);
+            }
+            break;
+        case SampleFormat::PCM32:
+            for (size_t i = 0; i < numFrames; ++i, p += stride)
+                out[i] = static_cast<float>(readLE<int32_t>(p)) * (1.0f / 2147483648.0f);
+            break;
+        case SampleFormat::FLOAT32:
+            for (size_t i = 0; i < numFrames; ++i, p += stride)
+                out[i] = readLE<float>(p);
+            break;
+        case SampleFormat::FLOAT64:
+            for (size_t i = 0; i < numFrames; ++i, p += stride)
+                out[i] = static_cast<float>(readLE<double>(p));
+            break;
+        }
+    }
+}
+
+void encodeSamples(const float* const* src, SampleFormat format, int numChannels, uint8_t* dst,
+                   size_t offset, size_t numFrames) noexcept
+{
+    const size_t bps = bytesPerSample(format);
+    const size_t stride = bps * static_cast<size_t>(numChannels);
+    for (int ch = 0; ch < numChannels; ++ch) {
+        uint8_t* p = dst + bps * static_cast<size_t>(ch);
+        const float* in = src[ch] + offset;
+        switch (format) {
+        case SampleFormat::PCM16:
+            for (size_t i = 0; i < numFrames; ++i, p += stride)
+                writeLE<int16_t>(p, static_cast<int16_t>(std::lrint(std::min(std::max(in[i] * 32768.0f, -32768.0f), 32767.0f))));
+            break;
+        case SampleFormat::PCM24:
+            for (size_t i = 0; i < numFrames; ++i, p += stride) {
+                const int32_t v = static_cast<int32_t>(std::lrint(std::min(std::max(in[i] * 8388608.0f, -8388608.0f), 8388607.0f)));
+                p[0] = static_cast<uint8_t>(v);
+                p[1] = static_cast<uint8_t>(v >> 8);
+                p[2] = static_cast<uint8_t>(v >> 16);
+            }
+            break;
+        case SampleFormat::PCM32:
+            for (size_t i = 0; i < numFrames; ++i, p += stride)
+                writeLE<int32_t>(p, static_cast<int32_t>(std::lrint(std::min(std::max(static_cast<double>(in[i]) * 2147483648.0, -2147483648.0), 2147483647.0))));
+            break;
+        case SampleFormat::FLOAT32:
+            for (size_t i = 0; i < numFrames; ++i, p += stride)
+                writeLE<float>(p, in[i]);
+            break;
+        case SampleFormat::FLOAT64:
+            for (size_t i = 0; i < numFrames; ++i, p += stride)
+                writeLE<double>(p, static_cast<double>(in[i]));
+            break;
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+
+namespace
+{
+
+uint64_t mapGranularity() noexcept
+{
+#if defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    return static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+}   // namespace
+
+bool WavReader::open(const std::string& path)
+{
+    close();
+#if defined(_WIN32)
+    m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        m_file = nullptr;
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0) {
+        close();
+        return false;
+    }
+    m_fileSize = static_cast<uint64_t>(size.QuadPart);
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!m_mapping) {
+        close();
+        return false;
+    }
+#else
+    m_fd = ::open(path.c_str(), O_RDONLY);
+    if (m_fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(m_fd, &st) != 0 || st.st_size <= 0) {
+        close();
+        return false;
+    }
+    m_fileSize = static_cast<uint64_t>(st.st_size);
+#endif
+    if (!parseHeader()) {
+        close();
+        return false;
+    }
+    m_position = m_dataOffset;
+    return true;
+}
+
+void WavReader::close() noexcept
+{
+    unmapWindow();
+#if defined(_WIN32)
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+    m_mapping = m_file = nullptr;
+#else
+    if (m_fd >= 0)
+        ::close(m_fd);
+    m_fd = -1;
+#endif
+    m_numFrames = m_framesLeft = 0;
+}
+
+bool WavReader::mapWindow(uint64_t offset) noexcept
+{
+    unmapWindow();
+    const uint64_t aligned = offset & ~(mapGranularity() - 1);
+    if (aligned >= m_fileSize)
+        return false;
+    const uint64_t size = std::min<uint64_t>(WINDOW_SIZE, m_fileSize - aligned);
+#if defined(_WIN32)
+    void* p = MapViewOfFile(m_mapping, FILE_MAP_READ, static_cast<DWORD>(aligned >> 32),
+                            static_cast<DWORD>(aligned), static_cast<SIZE_T>(size));
+    if (!p)
+        return false;
+#else
+    void* p = mmap(nullptr, static_cast<size_t>(size), PROT_READ, MAP_SHARED, m_fd, static_cast<off_t>(aligned));
+    if (p == MAP_FAILED)
+        return false;
+    madvise(p, static_cast<size_t>(size), MADV_SEQUENTIAL);
+#endif
+    m_window = static_cast<const uint8_t*>(p);
+    m_windowOffset = aligned;
+    m_windowSize = size;
+    m_prefetched = false;
+    return true;
+}
+
+void WavReader::unmapWindow() noexcept
+{
+    if (!m_window)
+        return;
+#if defined(_WIN32)
+    UnmapViewOfFile(m_window);
+#else
+    munmap(const_cast<uint8_t*>(m_window), static_cast<size_t>(m_windowSize));
+#endif
+    m_window = nullptr;
+    m_windowSize = 0;
+}
+
+// asynchronous read-ahead, so the next window is in the page cache before we map it
+void WavReader::prefetch(uint64_t offset, uint64_t size) noexcept
+{
+    if (offset >= m_fileSize)
+        return;
+    size = std::min(size, m_fileSize - offset);
+#if defined(__linux__)
+    posix_fadvise(m_fd, static_cast<off_t>(offset), static_cast<off_t>(size), POSIX_FADV_WILLNEED);
+#elif defined(__APPLE__)
+    struct radvisory ra;
+    ra.ra_offset = static_cast<off_t>(offset);
+    ra.ra_count = static_cast<int>(std::min<uint64_t>(size, 0x7FFFFFFF));
+    fcntl(m_fd, F_RDADVISE, &ra);
+#else
+    (void)size;     // FILE_FLAG_SEQUENTIAL_SCAN already makes the cache manager read ahead
+#endif
+}
+
+bool WavReader::parseHeader() noexcept
+{
+    if (!mapWindow(0) || m_windowSize < 12)
+        return false;
+    const bool isRF64 = !memcmp(m_window, "RF64", 4) || !memcmp(m_window, "BW64", 4);
+    if ((memcmp(m_window, "RIFF", 4) && !isRF64) || memcmp(m_window + 8, "WAVE", 4))
+        return false;
+
+    uint64_t rf64DataSize = 0;
+    bool haveFmt = false;
+    uint64_t offset = 12;
+    while (offset + 8 <= m_fileSize) {
+        if (offset + 8 > m_windowOffset + m_windowSize && !mapWindow(offset))
+            return false;
+        const uint8_t* chunk = m_window + (offset - m_windowOffset);
+        const uint32_t chunkSize = readLE<uint32_t>(chunk + 4);
+        if (!memcmp(chunk, "ds64", 4) || !memcmp(chunk, "fmt ", 4)) {
+            if (offset + 8 + chunkSize > m_windowOffset + m_windowSize && !mapWindow(offset))
+                return false;
+            chunk = m_window + (offset - m_windowOffset);
+            if (offset + 8 + chunkSize > m_windowOffset + m_windowSize)
+                return false;
+        }
+        if (!memcmp(chunk, "ds64", 4) && chunkSize >= 24) {
+            rf64DataSize = readLE<uint64_t>(chunk + 16);
+        }
+        else if (!memcmp(chunk, "fmt ", 4)) {
+            if (chunkSize < 16)
+                return false;
+            const uint8_t* fmt = chunk + 8;
+            uint16_t tag = readLE<uint16_t>(fmt);
+            if (tag == WAVE_FORMAT_EXTENSIBLE && chunkSize >= 26)
+                tag = readLE<uint16_t>(fmt + 24);   // first two bytes of the subformat GUID
+            m_numChannels = readLE<uint16_t>(fmt + 2);
+            m_sampleRate = static_cast<double>(readLE<uint32_t>(fmt + 4));
+            haveFmt = m_numChannels > 0 && formatFromHeader(tag, readLE<uint16_t>(fmt + 14), m_format);
+        }
+        else if (!memcmp(chunk, "data", 4)) {
+            if (!haveFmt)
+                return false;
+            uint64_t dataSize = (isRF64 && chunkSize == 0xFFFFFFFFu) ? rf64DataSize : chunkSize;
+            m_dataOffset = offset + 8;
+            dataSize = std::min(dataSize, m_fileSize - m_dataOffset);   // tolerate truncated files
+            m_frameBytes = bytesPerSample(m_format) * static_cast<size_t>(m_numChannels);
+            m_numFrames = m_framesLeft = dataSize / m_frameBytes;
+            return true;
+        }
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+    return false;
+}
+
+size_t WavReader::read(float* const* dst, size_t maxFrames)
+{
+    size_t done = 0;
+    while (done < maxFrames && m_framesLeft > 0) {
+        const uint64_t windowEnd = m_windowOffset + m_windowSize;
+        if (!m_window || m_position < m_windowOffset || m_position + m_frameBytes > windowEnd) {
+            if (!mapWindow(m_position)) {
+                m_framesLeft = 0;
+                break;
+            }
+            continue;
+        }
+        const uint64_t available = (windowEnd - m_position) / m_frameBytes;
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(std::min<uint64_t>(maxFrames - done, available), m_framesLeft));
+        decodeSamples(m_window + (m_position - m_windowOffset), m_format, m_numChannels, dst, done, n);
+        done += n;
+        m_framesLeft -= n;
+        m_position += n * m_frameBytes;
+        if (!m_prefetched && m_position - m_windowOffset > m_windowSize / 2) {
+            prefetch(windowEnd, WINDOW_SIZE);
+            m_prefetched = true;
+        }
+    }
+    return done;
+}
+
+//------------------------------------------------------------------------
+
+bool WavWriter::open(const std::string& path, int numChannels, double sampleRate, SampleFormat format)
+{
+    close();
+    m_file = fopen(path.c_str(), "wb");
+    if (!m_file)
+        return false;
+    m_format = format;
+    m_numChannels = numChannels;
+    m_frameBytes = bytesPerSample(format) * static_cast<size_t>(numChannels);
+    m_numFrames = 0;
+    m_fill = m_pending = 0;
+    m_current = 0;
+    m_stop = m_ioError = false;
+    // whole frames per buffer, so a frame never straddles two writes
+    for (auto& b : m_buffers)
+        b.resize(BUFFER_SIZE - BUFFER_SIZE % m_frameBytes);
+
+    const bool isFloat = format == SampleFormat::FLOAT32 || format == SampleFormat::FLOAT64;
+    uint8_t h[HEADER_SIZE] = {};
+    uint8_t* p = h;
+    memcpy(p, "RIFF", 4);
+    memcpy(p + 8, "WAVE", 4);
+    p += 12;
+    memcpy(p, "JUNK", 4);
+    writeLE<uint32_t>(p + 4, DS64_SIZE);
+    p += 8 + DS64_SIZE;
+    memcpy(p, "fmt ", 4);
+    writeLE<uint32_t>(p + 4, FMT_SIZE);
+    writeLE<uint16_t>(p + 8, isFloat ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM);
+    writeLE<uint16_t>(p + 10, static_cast<uint16_t>(numChannels));
+    writeLE<uint32_t>(p + 12, static_cast<uint32_t>(sampleRate));
+    writeLE<uint32_t>(p + 16, static_cast<uint32_t>(sampleRate * m_frameBytes));
+    writeLE<uint16_t>(p + 20, static_cast<uint16_t>(m_frameBytes));
+    writeLE<uint16_t>(p + 22, static_cast<uint16_t>(bytesPerSample(format) * 8));
+    p += 8 + FMT_SIZE;
+    memcpy(p, "data", 4);
+    if (fwrite(h, 1, HEADER_SIZE, m_file) != HEADER_SIZE) {
+        fclose(m_file);
+        m_file = nullptr;
+        return false;
+    }
+    m_thread = std::thread(&WavWriter::writerThread, this);
+    return true;
+}
+
+void WavWriter::writerThread()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        m_cv.wait(lock, [this] { return m_pending > 0 || m_stop; });
+        if (m_pending > 0) {
+            const uint8_t* data = m_buffers[m_current ^ 1].data();
+            const size_t size = m_pending;
+            lock.unlock();
+            const bool ok = fwrite(data, 1, size, m_file) == size;
+            lock.lock();
+            m_ioError |= !ok;
+            m_pending = 0;
+            m_cv.notify_all();
+        }
+        else if (m_stop) {
+            return;
+        }
+    }
+}
+
+// hands the current buffer to the writer thread, waiting for the previous one first
+void WavWriter::flushBuffer()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_cv.wait(lock, [this] { return m_pending == 0; });
+    if (m_fill == 0)
+        return;
+    m_pending = m_fill;
+    m_current ^= 1;
+    m_fill = 0;
+    m_cv.notify_all();
+}
+
+bool WavWriter::write(const float* const* src, size_t numFrames)
+{
+    if (!m_file)
+        return false;
+    const size_t capacity = m_buffers[0].size();
+    size_t done = 0;
+    while (done < numFrames) {
+        const size_t n = std::min(numFrames - done, (capacity - m_fill) / m_frameBytes);
+        encodeSamples(src, m_format, m_numChannels, m_buffers[m_current].data() + m_fill, done, n);
+        m_fill += n * m_frameBytes;
+        done += n;
+        if (m_fill == capacity)
+            flushBuffer();
+    }
+    m_numFrames += numFrames;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_ioError;
+}
+
+bool WavWriter::close() noexcept
+{
+    if (!m_file)
+        return true;
+    flushBuffer();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_all();
+    m_thread.join();
+
+    const uint64_t dataBytes = m_numFrames * m_frameBytes;
+    bool ok = !m_ioError;
+    if (dataBytes & 1)
+        ok &= fputc(0, m_file) != EOF;   // chunks are word aligned
+    const uint64_t riffSize = HEADER_SIZE - 8 + dataBytes + (dataBytes & 1);
+    const bool isRF64 = riffSize > RIFF_LIMIT;
+
+    uint8_t h[HEADER_SIZE];
+    memcpy(h, isRF64 ? "RF64" : "RIFF", 4);
+    writeLE<uint32_t>(h + 4, isRF64 ? 0xFFFFFFFFu : static_cast<uint32_t>(riffSize));
+    if (isRF64) {
+        memcpy(h + 12, "ds64", 4);
+        writeLE<uint32_t>(h + 16, DS64_SIZE);
+        writeLE<uint64_t>(h + 20, riffSize);
+        writeLE<uint64_t>(h + 28, dataBytes);
+        writeLE<uint64_t>(h + 36, m_numFrames);
+        writeLE<uint32_t>(h + 44, 0);   // no table entries
+    }
+    writeLE<uint32_t>(h + HEADER_SIZE - 4, isRF64 ? 0xFFFFFFFFu : static_cast<uint32_t>(dataBytes));
+    // patch only the fields that changed: the size words and, for RF64, the ds64 chunk
+    ok &= fseek(m_file, 0, SEEK_SET) == 0 && fwrite(h, 1, 8, m_file) == 8;
+    if (isRF64)
+        ok &= fseek(m_file, 12, SEEK_SET) == 0 && fwrite(h + 12, 1, 8 + DS64_SIZE, m_file) == 8 + DS64_SIZE;
+    ok &= fseek(m_file, HEADER_SIZE - 4, SEEK_SET) == 0 && fwrite(h + HEADER_SIZE - 4, 1, 4, m_file) == 4;
+    ok &= fclose(m_file) == 0;
+    m_file = nullptr;
+    return ok;
+}
@@ -0,0 +1,356 @@
+// modrender - headless batch renderer built on the Modulation core, no VST SDK.
+//
+//   modrender [-p preset] [-o outdir] [-j jobs] [-b block] [-f format] [-q quality] file...
+//
+// The preset is a text file of "key = value" lines with the fields the plug-in
+// keeps in its state: dryWet, modRate, modDepth, waveform, feedback,
+// chorusOffset, effectType, stereoPhase, bypass. Values are plain (Hz, ms, ...), not normalized.
+
+#include "../include/modulation.h"
+#include "../include/wavfile.h"
+#include "../include/threadpool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace Steinberg::MyModulation;
+namespace fs = std::filesystem;
+
+namespace
+{
+
+struct Preset
+{
+    ModulationParams params;
+    bool bypass = false;
+};
+
+struct Options
+{
+    Preset preset;
+    std::string outDir;
+    unsigned jobs = 0;
+    size_t blockSize = 512;
+    bool keepFormat = false;
+    SampleFormat format = SampleFormat::FLOAT32;
+    QualityTier quality = QualityTier::STANDARD;
+    std::vector<std::string> files;
+};
+
+// per worker, reused between files
+struct WorkerState
+{
+    double sampleRate = 0.0;
+    std::vector<std::unique_ptr<Modulation>> mods;   // one per channel pair
+    std::vector<std::vector<float>> buffers;
+    std::vector<float*> channels;
+};
+
+struct Totals
+{
+    std::atomic<uint64_t> frames {0};
+    std::atomic<uint64_t> samples {0};
+    std::atomic<double> audioSeconds {0.0};
+    std::atomic<unsigned> failed {0};
+    std::mutex printMutex;
+};
+
+template <typename T>
+T clampParam(T v, T lo, T hi)
+{
+    return std::min(std::max(v, lo), hi);
+}
+
+bool loadPreset(const std::string& path, Preset& preset)
+{
+    std::ifstream in(path);
+    if (!in)
+        return false;
+    ModulationParams& p = preset.params;
+    std::string line;
+    while (std::getline(in, line)) {
+        const size_t hash = line.find('#');
+        if (hash != std::string::npos)
+            line.erase(hash);
+        const size_t eq = line.find('=');
+        if (eq == std::string::npos)
+            continue;
+        std::string key;
+        std::istringstream(line.substr(0, eq)) >> key;
+        double value = 0.0;
+        if (!(std::istringstream(line.substr(eq + 1)) >> value)) {
+            fprintf(stderr, "%s: bad value for '%s'\n", path.c_str(), key.c_str());
+            return false;
+        }
+        if (key == "dryWet")
+            p.dryWet = clampParam(value, ModulationConst::DRY_WET_MIN, ModulationConst::DRY_WET_MAX);
+        else if (key == "modRate")
+            p.modRate = clampParam(value, ModulationConst::RATE_MIN, ModulationConst::RATE_MAX);
+        else if (key == "modDepth")
+            p.modDepth = clampParam(value, ModulationConst::DEPTH_MIN, ModulationConst::DEPTH_MAX);
+        else if (key == "waveform")
+            p.waveform = clampParam(static_cast<int>(value), 0, ModulationConst::NUM_WAVEFORMS - 1);
+        else if (key == "feedback")
+            p.feedback = clampParam(value, ModulationConst::FEEDBACK_MIN, ModulationConst::FEEDBACK_MAX);
+        else if (key == "chorusOffset")
+            p.chorusOffset = clampParam(value, ModulationConst::CHRS_OFST_MIN, ModulationConst::CHRS_OFST_MAX);
+        else if (key == "effectType")
+            p.effectType = clampParam(static_cast<int>(value), 0, ModulationConst::NUM_FX_TYPES - 1);
+        else if (key == "stereoPhase")
+            p.stereoPhase = clampParam(value, ModulationConst::STEREO_PHASE_MIN, ModulationConst::STEREO_PHASE_MAX);
+        else if (key == "bypass")
+            preset.bypass = value != 0.0;
+        else
+            fprintf(stderr, "%s: unknown key '%s' ignored\n", path.c_str(), key.c_str());
+    }
+    return true;
+}
+
+std::string outputPath(const std::string& in, const std::string& outDir)
+{
+    const size_t slash = in.find_last_of("/\\");
+    const std::string name = slash == std::string::npos ? in : in.substr(slash + 1);
+    if (!outDir.empty())
+        return outDir + "/" + name;
+    const size_t dot = in.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return in + "_mod.wav";
+    return in.substr(0, dot) + "_mod" + in.substr(dot);
+}
+
+// the same file however it's spelled: "./", "//", ".." and symlinks all
+// resolve, also in the part of the path that doesn't exist yet
+fs::path canonicalPath(const std::string& path)
+{
+    std::error_code ec;
+    const fs::path canonical = fs::weakly_canonical(path, ec);
+    return ec ? fs::path(path).lexically_normal() : canonical;
+}
+
+// with -o, inputs from different directories can share a name, and an output
+// may turn out to be an input (written over while it's still mapped for
+// reading); rather than let one render overwrite another, nothing is rendered
+bool checkOutputs(const Options& opt)
+{
+    std::map<fs::path, std::string> inputAt;
+    std::multimap<uintmax_t, std::string> inputsBySize;
+    for (const std::string& path : opt.files) {
+        inputAt.emplace(canonicalPath(path), path);
+        std::error_code ec;
+        const uintmax_t size = fs::file_size(path, ec);
+        if (!ec)
+            inputsBySize.emplace(size, path);
+    }
+    std::map<fs::path, std::string> outputOf;
+    bool ok = true;
+    for (const std::string& path : opt.files) {
+        const std::string out = outputPath(path, opt.outDir);
+        const fs::path key = canonicalPath(out);
+        std::string clash;
+        const auto input = inputAt.find(key);
+        if (input != inputAt.end()) {
+            clash = input->second;
+        } else {
+            // hard links, and names only a case-insensitive file system takes
+            // for the same; an input can only be one with the same size
+            std::error_code ec;
+            const uintmax_t size = fs::file_size(out, ec);
+            if (!ec) {
+                const auto range = inputsBySize.equal_range(size);
+                for (auto it = range.first; it != range.second && clash.empty(); ++it)
+                    if (fs::equivalent(out, it->second, ec))
+                        clash = it->second;
+            }
+        }
+        const auto first = outputOf.find(key);
+        if (clash.empty() && first != outputOf.end())
+            clash = "the output of " + first->second;
+        if (!clash.empty()) {
+            fprintf(stderr, "%s: output %s would overwrite %s\n", path.c_str(), out.c_str(), clash.c_str());
+            ok = false;
+        }
+        outputOf.emplace(key, path);
+    }
+    return ok;
+}
+
+bool renderFile(const std::string& path, const Options& opt, WorkerState& state, uint64_t& frames)
+{
+    WavReader reader;
+    if (!reader.open(path)) {
+        fprintf(stderr, "%s: can't open or unsupported format\n", path.c_str());
+        return false;
+    }
+    const int numChannels = reader.numChannels();
+    const double sr = reader.sampleRate();
+    WavWriter writer;
+    const std::string outPath = outputPath(path, opt.outDir);
+    if (!writer.open(outPath, numChannels, sr, opt.keepFormat ? reader.format() : opt.format)) {
+        fprintf(stderr, "%s: can't create output\n", outPath.c_str());
+        return false;
+    }
+
+    // reallocate only when the sample rate changes, otherwise just clear
+    if (sr != state.sampleRate) {
+        state.mods.clear();
+        state.sampleRate = sr;
+    }
+    const size_t numGroups = static_cast<size_t>(numChannels + 1) / 2;
+    for (auto& mod : state.mods)
+        mod->reset();
+    while (state.mods.size() < numGroups) {
+        state.mods.emplace_back(new Modulation(sr, opt.preset.params.modRate,
+                                               qualitySettings(opt.quality).oversampling));
+        state.mods.back()->setParams(opt.preset.params);
+        state.mods.back()->setQuality(opt.quality);
+    }
+    state.buffers.resize(static_cast<size_t>(numChannels));
+    state.channels.resize(static_cast<size_t>(numChannels));
+    for (int ch = 0; ch < numChannels; ++ch) {
+        state.buffers[ch].resize(opt.blockSize);
+        state.channels[ch] = state.buffers[ch].data();
+    }
+
+    frames = 0;
+    for (size_t n; (n = reader.read(state.channels.data(), opt.blockSize)) > 0; frames += n) {
+        if (!opt.preset.bypass) {
+            // pairs like the plug-in, one linked LFO each
+            for (int ch = 0; ch < numChannels; ch += 2) {
+                Modulation& mod = *state.mods[static_cast<size_t>(ch) / 2];
+                float* left = state.channels[ch];
+                if (ch + 1 < numChannels) {
+                    float* right = state.channels[ch + 1];
+                    mod.processStereo(left, right, left, right, static_cast<int>(n));
+                }
+                else {
+                    mod.process(left, left, static_cast<int>(n), 0);
+                }
+            }
+        }
+        if (!writer.write(state.channels.data(), n)) {
+            fprintf(stderr, "%s: write failed\n", outPath.c_str());
+            return false;
+        }
+    }
+    if (!writer.close()) {
+        fprintf(stderr, "%s: can't finalize output\n", outPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+void usage()
+{
+    fprintf(stderr,
+        "usage: modrender [options] file...\n"
+        "  -p FILE   preset, \"key = value\" lines (dryWet, modRate, modDepth, waveform,\n"
+        "            feedback, chorusOffset, effectType, stereoPhase, bypass)\n"
+        "  -o DIR    output directory (default: next to the input with a _mod suffix),\n"
+        "            inputs must not share a name then\n"
+        "  -j N      worker threads (default: one per hardware thread)\n"
+        "  -b N      block size in frames (default: 512)\n"
+        "  -f FMT    output format: float32 (default), float64, pcm16, pcm24, pcm32, same\n"
+        "  -q TIER   quality: eco, standard (default), high, ultra\n");
+}
+
+bool parseArgs(int argc, char* argv[], Options& opt)
+{
+    for (int i = 1; i < argc; ++i) {
+        const char* a = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (!strcmp(a, "-p") && hasValue) {
+            if (!loadPreset(argv[++i], opt.preset)) {
+                fprintf(stderr, "can't read preset %s\n", argv[i]);
+                return false;
+            }
+        }
+        else if (!strcmp(a, "-o") && hasValue)
+            opt.outDir = argv[++i];
+        else if (!strcmp(a, "-j") && hasValue)
+            opt.jobs = static_cast<unsigned>(atoi(argv[++i]));
+        else if (!strcmp(a, "-b") && hasValue)
+            opt.blockSize = static_cast<size_t>(std::max(1, atoi(argv[++i])));
+        else if (!strcmp(a, "-f") && hasValue) {
+            const std::string f = argv[++i];
+            if (f == "same") opt.keepFormat = true;
+            else if (f == "float32") opt.format = SampleFormat::FLOAT32;
+            else if (f == "float64") opt.format = SampleFormat::FLOAT64;
+            else if (f == "pcm16") opt.format = SampleFormat::PCM16;
+            else if (f == "pcm24") opt.format = SampleFormat::PCM24;
+            else if (f == "pcm32") opt.format = SampleFormat::PCM32;
+            else return false;
+        }
+        else if (!strcmp(a, "-q") && hasValue) {
+            const std::string q = argv[++i];
+            if (q == "eco") opt.quality = QualityTier::ECO;
+            else if (q == "standard") opt.quality = QualityTier::STANDARD;
+            else if (q == "high") opt.quality = QualityTier::HIGH;
+            else if (q == "ultra") opt.quality = QualityTier::ULTRA;
+            else return false;
+        }
+        else if (a[0] == '-')
+            return false;
+        else
+            opt.files.push_back(a);
+    }
+    return !opt.files.empty();
+}
+
+}   // namespace
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) {
+        usage();
+        return 2;
+    }
+    if (!checkOutputs(opt))
+        return 2;
+
+    WorkStealingPool pool(opt.jobs);
+    std::vector<WorkerState> states(pool.size());
+    Totals totals;
+
+    const auto start = std::chrono::steady_clock::now();
+    for (const std::string& path : opt.files) {
+        pool.submit([&, path](unsigned worker) {
+            WorkerState& state = states[worker];
+            uint64_t frames = 0;
+            const auto t0 = std::chrono::steady_clock::now();
+            const bool ok = renderFile(path, opt, state, frames);
+            const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            if (!ok) {
+                ++totals.failed;
+                return;
+            }
+            const double audioSecs = state.sampleRate > 0.0 ? static_cast<double>(frames) / state.sampleRate : 0.0;
+            totals.frames += frames;
+            totals.samples += frames * state.buffers.size();
+            double cur = totals.audioSeconds.load();
+            while (!totals.audioSeconds.compare_exchange_weak(cur, cur + audioSecs)) {}
+            std::lock_guard<std::mutex> lock(totals.printMutex);
+            printf("%s: %.1f s of audio in %.3f s (%.0fx realtime)\n", path.c_str(),
+                   audioSecs, secs, secs > 0.0 ? audioSecs / secs : 0.0);
+        });
+    }
+    pool.wait();
+    const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const unsigned done = static_cast<unsigned>(opt.files.size()) - totals.failed;
+    printf("\n%u file(s) rendered, %u failed, %u worker(s)\n", done, totals.failed.load(), pool.size());
+    printf("%.1f s of audio in %.3f s wall: %.0fx realtime, %.1f Msamples/s\n",
+           totals.audioSeconds.load(), wall, wall > 0.0 ? totals.audioSeconds.load() / wall : 0.0,
+           wall > 0.0 ? static_cast<double>(totals.samples.load()) * 1.0e-6 / wall : 0.0);
+    return totals.failed ? 1 : 0;
+}
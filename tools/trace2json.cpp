@@ -0,0 +1,131 @@
+// trace2json - converts a trace recorded with MYMODULATION_TRACE into Chrome
+// trace JSON (chrome://tracing, Perfetto).
+//
+//   trace2json trace.mdtr [out.json]
+//
+// Blocks become complete events with their size, parameter changes become
+// counters, bypass / effect type changes and dropped events become instants.
+
+#include "../include/trace.h"
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+
+// ids from plugids.h, kept here so the tool doesn't need the SDK
+const char* paramName(uint16_t id)
+{
+    switch (id) {
+    case 101: return "dryWet";
+    case 102: return "modRate";
+    case 103: return "modDepth";
+    case 104: return "waveform";
+    case 105: return "feedback";
+    case 106: return "chorusOffset";
+    case 107: return "effectType";
+    case 108: return "bypass";
+    default: return nullptr;
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: trace2json trace.mdtr [out.json]\n");
+        return 1;
+    }
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) {
+        fprintf(stderr, "trace2json: can't open %s\n", argv[1]);
+        return 1;
+    }
+    TraceFileHeader header;
+    if (fread(&header, sizeof(header), 1, in) != 1 || memcmp(header.magic, "MDTR", 4) != 0
+        || header.version != TRACE_FILE_VERSION) {
+        fprintf(stderr, "trace2json: %s is not a version %u trace\n", argv[1], TRACE_FILE_VERSION);
+        fclose(in);
+        return 1;
+    }
+    FILE* out = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (!out) {
+        fprintf(stderr, "trace2json: can't create %s\n", argv[2]);
+        fclose(in);
+        return 1;
+    }
+
+    const double usPerTick = 1e6 / header.ticksPerSecond;
+    auto micros = [&](uint64_t ticks) {
+        return static_cast<double>(static_cast<int64_t>(ticks - header.startTicks)) * usPerTick;
+    };
+
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    const char* sep = "";
+    auto next = [&]() {
+        fputs(sep, out);
+        sep = ",\n";
+    };
+    TraceEvent e;
+    TraceEvent begin = {0, 0.0f, TraceType::BLOCK_END, 0};
+    bool inBlock = false;
+    unsigned long long blocks = 0, dropped = 0;
+    while (fread(&e, sizeof(e), 1, in) == 1) {
+        switch (e.type) {
+        case TraceType::BLOCK_BEGIN:
+            begin = e;
+            inBlock = true;
+            break;
+        case TraceType::BLOCK_END:
+            if (!inBlock)
+                break;      // its begin was dropped
+            next();
+            fprintf(out, "{\"name\":\"process\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,"
+                         "\"args\":{\"samples\":%d,\"channels\":%u}}",
+                    micros(begin.ticks), micros(e.ticks) - micros(begin.ticks),
+                    static_cast<int>(begin.value), begin.id);
+            inBlock = false;
+            ++blocks;
+            break;
+        case TraceType::PARAM: {
+            char unnamed[16];
+            const char* name = paramName(e.id);
+            if (!name) {
+                snprintf(unnamed, sizeof(unnamed), "param %u", e.id);
+                name = unnamed;
+            }
+            next();
+            fprintf(out, "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"value\":%g}}",
+                    name, micros(e.ticks), e.value);
+            break;
+        }
+        case TraceType::BYPASS:
+            next();
+            fprintf(out, "{\"name\":\"bypass %s\",\"ph\":\"i\",\"s\":\"p\",\"pid\":1,\"tid\":1,\"ts\":%.3f}",
+                    e.value > 0.5f ? "on" : "off", micros(e.ticks));
+            break;
+        case TraceType::EFFECT_TYPE:
+            next();
+            fprintf(out, "{\"name\":\"effect type\",\"ph\":\"i\",\"s\":\"p\",\"pid\":1,\"tid\":1,\"ts\":%.3f,"
+                         "\"args\":{\"type\":%d}}",
+                    micros(e.ticks), static_cast<int>(e.value));
+            break;
+        case TraceType::DROPPED:
+            next();
+            fprintf(out, "{\"name\":\"dropped\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":1,\"ts\":%.3f,"
+                         "\"args\":{\"events\":%d}}",
+                    micros(e.ticks), static_cast<int>(e.value));
+            dropped += static_cast<unsigned long long>(e.value);
+            break;
+        default:
+            break;
+        }
+    }
+    fprintf(out, "\n]}\n");
+    fclose(in);
+    if (out != stdout)
+        fclose(out);
+    fprintf(stderr, "%llu blocks, %llu events dropped\n", blocks, dropped);
+    return 0;
+}